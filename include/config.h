@@ -15,10 +15,80 @@
  * during the execution.
  */
 
-/* PARI init */
-#define PARISIZE 1000000000
+/* PARI init: initial stack and ceiling of its growth (--stack-size, --stack-max) */
+#define PARISIZE 32000000
+#define PARISIZEMAX 4000000000UL
 #define MAXPRIME 2
 
+/* Streaming mode: initial PARI stack of each worker thread, jobs in flight per worker */
+#define WORKER_PARISIZE 32000000
+#define WORKER_QUEUE_FACTOR 16
+
+/*
+ * Initial PARI stack of the other worker threads, they grow up to the same ceiling:
+ * product trees of the faulty signatures, lattice reductions of the scans,
+ * search tree of the known bits
+ */
+#define WORKER_PARISIZE_FAULT 64000000
+#define WORKER_PARISIZE_LATTICE 8000000
+#define WORKER_PARISIZE_BITS 4000000
+
+/* Result cache: number of slots of a new cache file, maximal size of a factor */
+#define RESULT_CACHE_SLOTS (1L << 16)
+#define RESULT_CACHE_FACTOR_BYTES 1024
+
+/* Time budget per attack in seconds (0 for no budget) */
+#define ATTACK_BUDGET 0
+
+/* Checkpoints of rsa_partial_d: seconds between two saves */
+#define CHECKPOINT_INTERVAL 10
+
+/* Coordinator of sharded scans: maximal length of a line of the protocol */
+#define COORD_LINE_SIZE 8192
+
+/* Daemon mode of rsa_single: maximal number of jobs in flight and length of a line */
+#define DAEMON_QUEUE_MAX 65536
+#define DAEMON_LINE_SIZE 16384
+
+/* Linear Coppersmith method: maximal dimension of the lattice (zncoppersmith beyond) */
+#define COPPERSMITH_MAX_DIM 40
+
+/* Parallel searches: indices claimed at once by a worker, seconds between two progress reports */
+#define PARALLEL_CHUNK 64
+#define PARALLEL_PROGRESS_INTERVAL 10
+
+/* Prime factor known on a mask: maximal number of unknown bits to guess */
+#define MASK_MAX_MISSING 40
+
+/* Random known bits of p and q: dimension of the lattice ending the search */
+#define BITS_KNOWN_LATTICE_DIM 8
+
+/* Partial dp: lattices built by each worker for 2^t | k_p, t <= DP_LSB_MAX_VAL */
+#define DP_LSB_MAX_VAL 8
+
+/* Highest bits of d: maximal number of candidates for k */
+#define D_MSB_MAX_K (1L << 24)
+
+/* Faulty CRT signatures: maximal number of signatures of a key screened at once */
+#define FAULT_GROUP_MAX 65536
+
+/* Trace of the phases: buffer of the events of a thread, maximal size of an event */
+#define TRACE_BUFFER 65536
+#define TRACE_EVENT_MAX 256
+
+/* Weak keys of rsa_gen and rsa_bench (a small e for the partial d class keeps the scan of k short) */
+#define WEAK_EXPONENT 65537
+#define WEAK_PARTIAL_D_EXPONENT 3
+
+/* Benchmark: modulus size, keys per class, time budget per key in seconds */
+#define BENCH_NBITS 512
+#define BENCH_COUNT 8
+#define BENCH_BUDGET 60
+
+/* Microbenchmark: minimal time of a batch of runs in seconds, number of timed batches */
+#define MICROBENCH_MIN_TIME 0.1
+#define MICROBENCH_REPEAT 5
+
 /* small modulus factorization */
 #define SMALL_MODULUS_NBITS_BOUND 200
 
@@ -35,9 +105,33 @@
 #define P_PM_1_MAX_ATTEMPTS 5
 #define P_PM_1_PRIME_BOUND (1L << 16)
 #define P_PM_1_NBITS_BOUND 64
+#define P_PM_1_STAGE2_GCD 256
 
 /* 4p-1 factorization configuration */
 #define CM_ANOMALOUS_MAX_ATTEMPTS 5
 #define CM_ANOMALOUS_DISC_BOUND 64
 
+/* Quadratic sieve (SIQS) configuration */
+#define SIQS_NBITS_BOUND 350
+#define SIQS_BLOCK_SIZE 32768
+#define SIQS_SMALL_PRIME 32
+#define SIQS_LARGE_PRIME_MULT 64
+#define SIQS_EXTRA_RELATIONS 64
+#define SIQS_THRESHOLD_SLACK 4
+#define SIQS_MULTIPLIER_PRIME_BOUND 1000
+#define SIQS_A_PRIME_MIN 400
+#define SIQS_A_PRIME_MAX 4000
+#define SIQS_A_TRIES 30
+#define SIQS_A_MAX (1L << 24)
+#define SIQS_MAX_A_FACTORS 20
+#define SIQS_MAX_FACTORS 512
+#define SIQS_PARTIAL_BUCKETS (1L << 16)
+
+/* Triage pass: primes of the residues (less than 2^16), n = 1 mod 2^k flagged from k, tiny attack bounds */
+#define TRIAGE_PRIME_BOUND 4096
+#define TRIAGE_LSB_BITS 16
+#define TRIAGE_FERMAT_BOUND 64
+#define TRIAGE_P1_PRIME_BOUND 256
+#define TRIAGE_P1_NBITS_BOUND 16
+
 #endif
@@ -6,35 +6,409 @@
 #ifndef _RSA_H
 #define _RSA_H
 
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <pari/pari.h>
 #include "config.h"
 
 #define TRUE 1
 #define FALSE 0
 
-extern int verb;
+/* Code of the options --stack-size and --stack-max for getopt, they are read by stack_init */
+#define OPT_STACK 0x100
+
+/* Verbosity of the context of the current thread (see rsa_ctx_t), an lvalue */
+#define verb (rsa_ctx_current->verbose)
+
+/* Entry of the result cache (stored as is in the cache file) */
+#define CACHE_SMALL 1
+#define CACHE_SQUARE 2
+#define CACHE_SMALL_D 4
+#define CACHE_WIENER 8
+#define CACHE_SHARED_LSB 16
+#define CACHE_SIQS 32
+
+typedef struct {
+  uint64_t key[2];            /* fingerprint of the modulus, 0 for an empty slot */
+  uint64_t e_key;             /* fingerprint of the public exponent */
+  uint32_t flags;             /* attacks already run without success (CACHE_*) */
+  uint32_t p_len;             /* length of the factor in bytes, 0 if not factored */
+  int64_t fermat_bound;       /* highest bounds used without success */
+  int64_t p1_prime_bound;
+  int64_t p1_nbits_bound;
+  int64_t cm_disc_bound;
+  char attack[24];            /* attack which found the factor */
+  unsigned char p[RESULT_CACHE_FACTOR_BYTES];
+} cache_slot_t;
+
+/* Result cache, a hash table in a memory-mapped file */
+typedef struct {
+  int fd;
+  unsigned char *map;
+  size_t size;
+  uint64_t nslots;
+  cache_slot_t *slots;
+  pthread_mutex_t lock;
+} result_cache_t;
+
+/* Attacks of rsa_single, in the fixed order */
+#define ATTACK_SMALL 0
+#define ATTACK_SQUARE 1
+#define ATTACK_SMALL_D 2
+#define ATTACK_WIENER 3
+#define ATTACK_FERMAT 4
+#define ATTACK_SHARED_LSB 5
+#define ATTACK_P_PM_1 6
+#define ATTACK_CM 7
+#define ATTACK_SIQS 8
+#define ATTACK_COUNT 9
+
+extern const char *ATTACK_NAMES[ATTACK_COUNT];
+
+/* Configuration of the attacks run by rsa_single */
+typedef struct {
+  const char *attack;         /* a single attack, or NULL for all of them */
+  int select;                 /* set of attacks (bits 1 << ATTACK_*) if not 0, see `attack_set` */
+  result_cache_t *cache;      /* result cache, or NULL */
+  long close_primes_bound;
+  long p1_prime_bound;
+  long p1_nbits_bound;
+  long p1_stage2_bound;       /* sharded p-1 and p+1 attack only */
+  long cm_disc_bound;
+  long disc;                  /* CM-discriminant in absolute value, or -1 */
+  long siqs_fb_size;          /* size of the factor base of the quadratic sieve, 0 for the default */
+  long siqs_block_size;       /* size of its sieve blocks in bytes, 0 for the default */
+  int threads;                /* threads of the multi-threaded attacks (factor_siqs) */
+  double budget;              /* time budget per attack in seconds, 0 for none */
+  double timeout;             /* time budget of all the attacks, 0 for none */
+  int plan;                   /* order and prune the attacks with the planner */
+  int quiet;                  /* no progress messages unless verbose */
+  int triage;                 /* streaming mode: triage pass instead of the attacks (see triage.c) */
+} single_cfg_t;
+
+/*
+ * Context of the attacks, for the library librsatools (see context.c).
+ * A thread runs the attacks of the context it is attached to, the programs use
+ * the default context shared by all their threads.
+ */
+typedef struct {
+  int verbose;
+  single_cfg_t cfg;           /* attacks and bounds, defaults from config.h */
+  ulong seed;                 /* seed of the random streams of the attacks (see getseed.c), 0 for none */
+  volatile int cancelled;     /* set by rsa_ctx_cancel (cleared by rsa_ctx_reset), stops the attacks at their next check */
+} rsa_ctx_t;
+
+extern __thread rsa_ctx_t *rsa_ctx_current;
+
+/* Plan of the attacks on a modulus, computed from cheap features of (n, e) */
+typedef struct {
+  long nbits, ebits, n_mod16;
+  int square;
+  int n;                      /* number of attacks to run */
+  int order[ATTACK_COUNT];    /* attacks to run, in order */
+  double cost[ATTACK_COUNT];  /* estimated time in seconds */
+  double prob[ATTACK_COUNT];  /* prior probability of success */
+  const char *pruned[ATTACK_COUNT]; /* reason, or NULL if the attack is run */
+} attack_plan_t;
+
+/* Reasons to skip a candidate, counted by the runtime statistics */
+#define SKIP_NO_ROOT_MOD_E 0        /* no candidate for p mod e */
+#define SKIP_PARITY 1               /* wrong power of 2 dividing a candidate */
+#define SKIP_SHARED_LSB 2           /* p and q share too many lsb */
+#define SKIP_NOT_SQUARE 3           /* (p - q)^2 is not a square mod 2^v */
+#define SKIP_SMALL_MODULUS 4        /* roots mod 2 or 4 only */
+#define SKIP_NOT_INVERTIBLE 5
+#define SKIP_BOUND 6                /* candidate out of the range of the primes */
+#define SKIP_CHECKPOINT 7           /* already done according to the checkpoint */
+#define SKIP_COUNT 8
+
+extern const char *SKIP_NAMES[SKIP_COUNT];
+
+/* Runtime statistics of an attack (--stats) */
+typedef struct {
+  const char *attack;
+  long n_bits;
+  uint64_t n_hash;
+  double start;
+  long iterations;            /* Fermat offsets, primes, convergents, values of k... */
+  long gcds;
+  long coppersmith;           /* lattice reductions */
+  long skipped[SKIP_COUNT];
+  long peak_stack;            /* bytes, maximum over the threads of the attack */
+} stats_t;
+
+/* Classes of weak keys generated by rsa_gen */
+#define WEAK_CLOSE 0
+#define WEAK_SHARED_LSB 1
+#define WEAK_P_PM_1 2
+#define WEAK_CM 3
+#define WEAK_SMALL_D 4
+#define WEAK_PARTIAL_P 5
+#define WEAK_PARTIAL_D 6
+#define WEAK_COUNT 7
+
+extern const char *WEAK_NAMES[WEAK_COUNT];
+
+/* Weak key, and its leak: p1 of p = p1*2^ell + p0 (partial_p) or d mod 2^ell (partial_d) */
+typedef struct {
+  GEN n, e, p, q, d;
+  GEN leak;
+  long ell;
+} weak_key_t;
+
+/* Result of the attacks run by rsa_single */
+typedef struct {
+  int found;
+  int timeout;                /* an attack was stopped by its time budget */
+  const char *attack;         /* name of the successful attack */
+  GEN p, q, d;
+} single_res_t;
+
+/* Flags of the triage pass, the suspected weakness of a key */
+#define TRIAGE_SQUARE 1
+#define TRIAGE_TINY_FACTOR 2
+#define TRIAGE_SHARED_LSB 4
+#define TRIAGE_LARGE_E 8
+#define TRIAGE_CLOSE_PRIMES 16
+#define TRIAGE_SMOOTH 32
+#define TRIAGE_SMALL_MODULUS 64
+#define TRIAGE_SIQS 128
+#define TRIAGE_COUNT 8
+
+/* Result of the triage pass on a key */
+typedef struct {
+  int flags;                  /* TRIAGE_* */
+  long nbits, ebits;
+  long lsb;                   /* n = 1 mod 2^lsb */
+  const char *attack;         /* check which factored the modulus, or NULL */
+  GEN p, q;
+} triage_t;
+
+/*
+ * A (n, e) record of the streaming mode, or a (n, e, m, s) signature record.
+ * Values are decimal strings, or big-endian bytes for keys read from key files.
+ */
+#define KEY_REC_ERROR -1
+#define KEY_REC_SKIP 0
+#define KEY_REC_OK 1
+
+typedef struct {
+  long line;
+  char *id;
+  char *n;
+  char *e;
+  char *m, *s;                /* message and signature */
+  char *attacks;              /* attacks to run on the key (see `attack_set`), NULL for all */
+  const unsigned char *n_bytes;
+  const unsigned char *e_bytes;
+  size_t n_len, e_len;
+  unsigned char *buf;         /* decoded data owned by the record */
+  const char *error;
+} key_rec_t;
+
+/* Memory-mapped file of public keys (PEM, DER or OpenSSH) */
+#define PUBKEY_DER 0
+#define PUBKEY_PEM 1
+#define PUBKEY_SSH 2
+
+typedef struct {
+  unsigned char *data;
+  size_t size, pos;
+  long count, line;
+  int format;
+} pubkey_file_t;
+
+/* Checkpoint of a scan over k, shared by the workers of the scan */
+typedef struct {
+  const char *filename;
+  uint64_t key;               /* fingerprint of the parameters of the scan */
+  ulong seed;                 /* seed of the random generator */
+  long gamma_best, k_best;    /* best candidate of k_detect */
+  long *ranges;               /* completed ranges [ranges[2i], ranges[2i+1]) */
+  long nranges, cap;
+  long run_start, run_end;    /* completed range not recorded yet, or -1 */
+  double saved;               /* time of the last save */
+} checkpoint_t;
+
+/* Client of the coordinator of sharded scans */
+typedef struct {
+  int fd, watch_fd;
+  pthread_t watcher;
+  volatile int closing;
+} coord_t;
+
+/*
+ * Howgrave-Graham lattice of the linear Coppersmith method,
+ * shared by the calls with the same modulus and bound (on the PARI stack)
+ */
+typedef struct {
+  GEN modulus;
+  GEN X;                      /* bound on the root */
+  GEN Xpow;                   /* X^k for 0 <= k < n */
+  GEN scale;                  /* coefficients of the basis without the powers of the constant */
+  long h, t, n;               /* multiplicity, shifts and dimension n = h + t */
+} coppersmith_t;
+
+/* Pool of PARI worker threads */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty, not_full;
+  struct job_s *head, *tail, **ring;
+  long submitted, inflight, next_out, capacity;
+  int ordered, closed, nthreads;
+  struct worker_s *workers;
+  FILE *out;
+  char *(*run)(void *data, void *arg);
+  void (*release)(void *data);
+  void *arg;
+  rsa_ctx_t *ctx;             /* context of the thread which started the pool */
+} workers_t;
 
 /* Factorization of a single RSA modulus */
 int factor_cm_anomalous_core(GEN modulus, long d, GEN *p, GEN *q);
 int factor_cm_anomalous(GEN modulus, GEN *p, GEN *q, int max_disc);
+int factor_cm_anomalous_range(GEN modulus, GEN *p, GEN *q, int min_disc, int max_disc);
 int factor_shared_lsb(GEN modulus, GEN *p, GEN *q);
 int factor_close_primes(GEN modulus, GEN *p, GEN *q, const int max);
+int factor_close_primes_range(GEN modulus, GEN *p, GEN *q, long start, long max);
 int factor_p_plus_minus_one(GEN modulus, GEN *p, GEN *q, GEN maxprime, long logbound);
+int factor_p_pm_1_stage1(GEN modulus, GEN maxprime, long logbound, GEN *xs, GEN *p, GEN *q);
+int factor_p_pm_1_stage2(GEN modulus, GEN xs, GEN start, GEN end, GEN *p, GEN *q);
+GEN lucas_ladder(GEN m, GEN x);
+void tables_init(long disc_bound, long prime_bound, long nbits_bound);
+void tables_close();
+GEN table_polclass(long disc);
+GEN table_prime_powers(GEN prime_bound, long nbits_bound);
+void daemon_run(const char *path, const single_cfg_t *cfg, int nthreads);
+int factor_siqs(GEN modulus, GEN *p, GEN *q, long fb_size, long block_size, int nthreads);
+void triage_init();
+void triage_close();
+int triage_key(GEN modulus, GEN e, triage_t *t);
+char *triage_result(key_rec_t *rec, GEN modulus, GEN e, const triage_t *t);
 int factor_small_d(GEN n, GEN e, GEN *d, GEN *p, GEN *q);
+void gauss_reduction(GEN a, GEN b, GEN c, GEN d, GEN *u1, GEN *u2, GEN *v1, GEN *v2);
 int factor_small_modulus(GEN modulus, GEN *p, GEN *q);
 int factor_square_modulus(GEN modulus, GEN *p, GEN *q);
 int factor_wiener(GEN modulus, GEN e, GEN *d, GEN *p, GEN *q);
+long factor_fault_crt(GEN modulus, GEN e, GEN sigs, long *nvalid, GEN *p, GEN *q);
+void single_cfg_init(single_cfg_t *cfg);
+int attack_index(const char *name);
+int attack_set(const char *list);
+void plan_attacks(const single_cfg_t *cfg, GEN modulus, GEN e, attack_plan_t *plan);
+void plan_print(const single_cfg_t *cfg, const attack_plan_t *plan);
+int run_single(const single_cfg_t *cfg, GEN modulus, GEN e, GEN d, single_res_t *res);
 
 /* Factorization of a single RSA modulus with Coppersmith method */
 int factor_p_hi(GEN modulus, GEN p1, GEN m, GEN *p, GEN *q);
 int factor_p_low(GEN modulus, GEN p0, GEN m, GEN *p, GEN *q);
+long coppersmith_linear_dim(GEN modulus, GEN X, long *h);
+int coppersmith_linear_init(coppersmith_t *ctx, GEN modulus, GEN X);
+int coppersmith_p_low_init(coppersmith_t *ctx, GEN modulus, GEN m);
+GEN coppersmith_linear_roots(const coppersmith_t *ctx, GEN a);
+int factor_p_linear(const coppersmith_t *ctx, GEN p0, GEN m, GEN *p, GEN *q);
+int factor_p_mask(GEN modulus, GEN bits, GEN mask, int nthreads, GEN *p, GEN *q);
+int factor_bits_known(GEN modulus, GEN p_bits, GEN p_mask, GEN q_bits, GEN q_mask, int nthreads,
+                      GEN *p, GEN *q);
 int factor_d_lsb(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end, GEN *p, GEN *q);
+int factor_d_lsb_checkpoint(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end,
+                            checkpoint_t *ck, GEN *p, GEN *q);
+int factor_d_lsb_k(GEN modulus, GEN e, GEN inv2, GEN n1, GEN ed1, GEN pow2u, long u, long k, long k_max,
+                   GEN *p, GEN *q);
+int factor_d_lsb_pipeline(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end, int nthreads,
+                          GEN *p, GEN *q);
+long k_detect_gamma(GEN modulus, GEN e, GEN inv2, GEN n1, GEN ed1, GEN pow2u, long u, long k);
+int factor_dp_lsb(GEN modulus, GEN e, GEN dp0, long u, long k_start, long k_end, int nthreads,
+                  GEN *p, GEN *q);
+int factor_dp_msb(GEN modulus, GEN e, GEN dp1, long u, long k_start, long k_end, int nthreads,
+                  GEN *p, GEN *q);
+int factor_d_msb(GEN modulus, GEN e, GEN d1, long u, int nthreads, GEN *p, GEN *q);
 void k_detect(GEN modulus, GEN e, GEN d0, long u, long treshold);
+void k_detect_checkpoint(GEN modulus, GEN e, GEN d0, long u, long treshold, checkpoint_t *ck);
 
 /* Utils */
 GEN getseed();
+uint64_t splitmix64(uint64_t *state);
+ulong seed_derive(ulong seed, uint64_t stream);
+void seed_attack(GEN modulus, long attack);
+void seed_thread(long index);
+double wall_clock();
+double cpu_clock();
+void rsa_ctx_init(rsa_ctx_t *ctx);
+void rsa_ctx_attach(rsa_ctx_t *ctx);
+rsa_ctx_t *rsa_ctx_get();
+void rsa_ctx_cancel(rsa_ctx_t *ctx);
+void rsa_ctx_reset(rsa_ctx_t *ctx);
+int rsa_ctx_factor(rsa_ctx_t *ctx, GEN modulus, GEN e, single_res_t *res);
+void deadline_start(double at);
+double deadline_get();
+double deadline_min(double a, double b);
+int deadline_check();
+void deadline_interrupt();
+int deadline_expired();
+void deadline_progress(const char *what, long value);
+long deadline_reached(const char **what);
+int key_rec_parse(char *line, long lineno, key_rec_t *rec);
+int sig_rec_parse(char *line, long lineno, key_rec_t *rec);
+char *stream_result(key_rec_t *rec, GEN modulus, single_res_t *res);
+void key_rec_free(key_rec_t *rec);
+GEN int_from_bytes(const unsigned char *buf, size_t len);
+int pubkey_open(const char *filename, pubkey_file_t *f);
+int pubkey_next(pubkey_file_t *f, key_rec_t *rec);
+void pubkey_close(pubkey_file_t *f);
+int cache_open(const char *filename, result_cache_t *c);
+void cache_close(result_cache_t *c);
+int cache_lookup(result_cache_t *c, GEN modulus, cache_slot_t *entry);
+void cache_store(result_cache_t *c, const cache_slot_t *entry);
+uint64_t cache_exponent_key(GEN e);
+uint64_t int_hash(GEN x, uint64_t h);
+void cache_set_factor(cache_slot_t *entry, GEN p, const char *attack);
 int prime_factor_recovery(GEN modulus, GEN e, GEN d, const int n_iter, GEN *p, GEN *q);
+void dbl_xz(GEN xx1, GEN zz1, GEN A, GEN B, GEN *xx3, GEN *zz3);
+void add_xz(GEN xx2, GEN zz2, GEN xx3, GEN zz3, GEN xx1, GEN A, GEN B, GEN *xx5, GEN *zz5);
 void ladder(GEN scalar, GEN x0, GEN A, GEN B, GEN *res_x, GEN *res_z);
 GEN sqrt_mod2(GEN a, long u);
+GEN sqrt_mod2_incr(GEN a, long u, GEN *y, long *v);
+int workers_start(workers_t *w, int nthreads, size_t stacksize, int ordered, long capacity,
+                  FILE *out, char *(*run)(void *, void *), void (*release)(void *), void *arg);
+void workers_submit(workers_t *w, void *data);
+int workers_submit_priority(workers_t *w, void *data, long priority);
+void workers_finish(workers_t *w);
+int weak_class_index(const char *name);
+long weak_default_param(int cls, long nbits);
+int weak_key_gen(int cls, long nbits, long param, weak_key_t *k);
+int stats_open(const char *filename);
+void stats_close();
+stats_t *stats_get();
+void stats_attach(stats_t *st);
+void stats_begin(stats_t *st, const char *attack, GEN modulus);
+void stats_end(stats_t *st, int found);
+void stats_iter();
+void stats_gcd();
+void stats_coppersmith();
+void stats_skip(int reason, long count);
+void stack_init(int argc, char *argv[], const char *options, const struct option *long_options);
+void stack_thread_alloc(struct pari_thread *t, size_t size);
+int trace_open(const char *filename);
+void trace_close();
+void trace_thread(const char *name);
+void trace_thread_end();
+void trace_begin(const char *name);
+void trace_end();
+GEN parallel_range(long start, long end, int nthreads, void *(*init)(void *), GEN (*run)(long, void *),
+                   void *arg, const char *what);
+int checkpoint_open(checkpoint_t *ck, const char *filename, uint64_t key, ulong seed, int resume);
+int checkpoint_save(checkpoint_t *ck);
+long checkpoint_skip(checkpoint_t *ck, long k);
+void checkpoint_done(checkpoint_t *ck, long k);
+void checkpoint_gamma(checkpoint_t *ck, long gamma, long k);
+void checkpoint_close(checkpoint_t *ck);
+int shard_parse(const char *s, long *i, long *n);
+void shard_range(long i, long n, long *start, long *end);
+int coord_connect(coord_t *c, const char *path);
+int coord_next(coord_t *c, long *start, long *end);
+void coord_done(coord_t *c, long start, long end);
+void coord_found(coord_t *c, const char *result);
+void coord_close(coord_t *c);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include "rsa.h"
+
+/* Attacks run on each class of weak keys */
+typedef struct {
+  int cls;
+  const char *attack;
+} bench_entry_t;
+
+static const bench_entry_t BENCH[] = {
+  {WEAK_CLOSE, "factor_fermat"},
+  {WEAK_SHARED_LSB, "factor_shared_lsb"},
+  {WEAK_P_PM_1, "factor_p_pm_1"},
+  {WEAK_CM, "factor_cm"},
+  {WEAK_SMALL_D, "factor_small_d"},
+  {WEAK_SMALL_D, "factor_wiener"},
+  {WEAK_PARTIAL_P, "factor_p_hi"},
+  {WEAK_PARTIAL_D, "factor_d_lsb"}
+};
+
+#define BENCH_ENTRIES (long)(sizeof(BENCH)/sizeof(BENCH[0]))
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_bench [OPTIONS]\n"
+                  "Run every attack on the weak keys of rsa_gen, and write the timings as JSON\n"
+                  "  --class <name>     Only the attacks on this class (see rsa_gen)\n"
+                  "  --bits <val>       Size of the modulus (default is %d)\n"
+                  "  --count <val>      Number of keys per class (default is %d)\n"
+                  "  --seed <val>       Seed of the random generator (default is 1), the keys are the same as\n"
+                  "                     rsa_gen --class <name> --bits <val> --count <val> --seed <val>\n"
+                  "  --budget <sec>     Time budget of an attack on a key (default is %d)\n"
+                  "  --stack-size <val> Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max <val>  Ceiling of the PARI stacks, main and threads (default is 4G)\n"
+                  "  -v, --verbose      More verbosity\n",
+          BENCH_NBITS, BENCH_COUNT, BENCH_BUDGET
+  );
+}
+
+/* Attack on a weak key, TRUE if one of its factors is found */
+int bench_attack(const char *attack, const weak_key_t *k, single_cfg_t *cfg, double budget) {
+  GEN p = NULL, q;
+  single_res_t res;
+  int found;
+  pari_sp av = avma;
+
+  if (!strcmp(attack, "factor_p_hi")) {
+    deadline_start(wall_clock() + budget);
+    found = factor_p_hi(k->n, k->leak, int2n(k->ell), &p, &q);
+    deadline_start(0);
+  }
+  else if (!strcmp(attack, "factor_d_lsb")) {
+    deadline_start(wall_clock() + budget);
+    found = factor_d_lsb(k->n, k->e, k->leak, k->ell, 1, itos(k->e), &p, &q);
+    deadline_start(0);
+  }
+  else {
+    cfg->attack = attack;
+    cfg->budget = budget;
+    found = run_single(cfg, k->n, k->e, NULL, &res);
+    p = res.p;
+  }
+
+  found = found && p != NULL && (equalii(p, k->p) || equalii(p, k->q));
+  avma = av;
+  return found;
+}
+
+/*
+ * Timings of an attack on count keys of its class, as a JSON object.
+ * Returns FALSE if the keys cannot be generated with these bits.
+ */
+int bench_run(const bench_entry_t *b, long nbits, long count, GEN seed, double budget, int first) {
+  single_cfg_t cfg;
+  weak_key_t *keys;
+  long i, param, found = 0;
+  double wall, cpu;
+  pari_sp av = avma;
+
+  param = weak_default_param(b->cls, nbits);
+  single_cfg_init(&cfg);
+  cfg.quiet = TRUE;
+  cfg.plan = FALSE;
+  if (b->cls == WEAK_CM) {
+    cfg.disc = param;
+  }
+
+  /* Same keys as rsa_gen with the same seed */
+  setrand(seed);
+  keys = (weak_key_t *)stack_malloc(count*sizeof(weak_key_t));
+  for (i = 0; i < count; i++) {
+    if (!weak_key_gen(b->cls, nbits, param, &keys[i])) {
+      fprintf(stderr, "[!] Parameter %ld out of range for the class %s, %s skipped\n",
+              param, WEAK_NAMES[b->cls], b->attack);
+      avma = av;
+      return FALSE;
+    }
+  }
+
+  wall = wall_clock();
+  cpu = cpu_clock();
+  for (i = 0; i < count; i++) {
+    found += bench_attack(b->attack, &keys[i], &cfg, budget);
+  }
+  wall = wall_clock() - wall;
+  cpu = cpu_clock() - cpu;
+
+  if (verb) {
+    fprintf(stderr, "[x] %s on %s: %ld/%ld in %.3f s\n", b->attack, WEAK_NAMES[b->cls], found, count, wall);
+  }
+  printf("%s\n    {\"class\": \"%s\", \"attack\": \"%s\", \"param\": %ld, \"keys\": %ld, \"found\": %ld, "
+         "\"success_rate\": %.3f, \"wall_time\": %.6f, \"cpu_time\": %.6f}",
+         first ? "" : ",", WEAK_NAMES[b->cls], b->attack, param, count, found,
+         count > 0 ? (double)found/count : 0., wall, cpu);
+  fflush(stdout);
+  avma = av;
+  return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+  GEN seed = gen_1;
+  long i, nbits = BENCH_NBITS, count = BENCH_COUNT;
+  double budget = BENCH_BUDGET;
+  int opt, cls = -1, first = TRUE;
+  char options[] = ":vh";
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"class", required_argument, NULL, 'c'},
+    {"bits", required_argument, NULL, 'b'},
+    {"count", required_argument, NULL, 'C'},
+    {"seed", required_argument, NULL, 's'},
+    {"budget", required_argument, NULL, 'U'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+  /* Initialization */
+  stack_init(argc, argv, options, long_options);
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'h':
+        usage();
+        goto end;
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'c':
+        cls = weak_class_index(optarg);
+        if (cls < 0) {
+          fprintf(stderr, "[!] Unknown class: %s\n", optarg);
+          usage();
+          goto end;
+        }
+        break;
+      case 'b':
+        nbits = atol(optarg);
+        break;
+      case 'C':
+        count = atol(optarg);
+        break;
+      case 's':
+        seed = gp_read_str(optarg);
+        break;
+      case 'U':
+        budget = atof(optarg);
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        goto end;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c", optopt);
+        usage();
+        goto end;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  pari_printf("{\"seed\": \"%Ps\", \"bits\": %ld, \"count\": %ld, \"budget\": %.1f, \"results\": [", seed, nbits, count, budget);
+  for (i = 0; i < BENCH_ENTRIES; i++) {
+    if (cls < 0 || BENCH[i].cls == cls) {
+      if (bench_run(&BENCH[i], nbits, count, seed, budget, first)) {
+        first = FALSE;
+      }
+    }
+  }
+  printf("\n]}\n");
+
+end:
+  pari_close();
+
+  return 0;
+}
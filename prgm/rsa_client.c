@@ -0,0 +1,312 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * Client of the daemon mode of rsa_single (rsa_single --daemon PATH).
+ * The jobs are submitted one by one, then the results are printed on stdout
+ * as JSON lines (the format of the streaming mode) as they arrive.
+ */
+
+typedef struct {
+  int fd;
+  char buf[DAEMON_LINE_SIZE];
+  size_t len;
+} conn_t;
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_client --socket <path> (-n <modulus> | --batch <file> | --status | --shutdown) [OPTIONS]\n"
+                  "  --socket PATH          UNIX socket of the daemon\n"
+                  "  -n, --modulus VAL      Modulus\n"
+                  "  -e, --exponent VAL     Public exponent\n"
+                  "  --batch FILE           Submit the (n, e) records of file (- for stdin), as JSON or decimal values\n"
+                  "  --priority VAL         Priority of the jobs, higher first (default is 0)\n"
+                  "  --attacks LIST         Comma-separated names of the attacks to run (default is all)\n"
+                  "  --budget SEC           Time budget per attack\n"
+                  "  --timeout SEC          Time budget of all the attacks\n"
+                  "  --fermat-bound VAL     Bounds of the attacks, as for rsa_single\n"
+                  "  --p1-prime-bound VAL\n"
+                  "  --p1-nbits-bound VAL\n"
+                  "  --cm-disc-bound VAL\n"
+                  "  --cm-disc VAL\n"
+                  "  --status               Print the number of queued, running and completed jobs\n"
+                  "  --shutdown             Stop the daemon once the queued jobs are completed\n"
+                  "  -h --help              Print help\n"
+                  "  -v, --verbose          More verbosity\n"
+  );
+}
+
+static int connect_daemon(conn_t *c, const char *path) {
+  struct sockaddr_un addr;
+
+  memset(c, 0, sizeof(*c));
+  c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (c->fd < 0) {
+    return FALSE;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    close(c->fd);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static int send_line(conn_t *c, const char *line) {
+  size_t len = strlen(line);
+  ssize_t w;
+
+  while (len > 0) {
+    w = send(c->fd, line, len, MSG_NOSIGNAL);
+    if (w <= 0) {
+      return FALSE;
+    }
+    line += w;
+    len -= w;
+  }
+  return TRUE;
+}
+
+/* Next line from the daemon without the newline, NULL if disconnected */
+static char *read_line(conn_t *c) {
+  static char line[DAEMON_LINE_SIZE];
+  char *nl;
+  ssize_t r;
+
+  while ((nl = memchr(c->buf, '\n', c->len)) == NULL) {
+    if (c->len == sizeof(c->buf)) {
+      return NULL;
+    }
+    r = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+    if (r <= 0) {
+      return NULL;
+    }
+    c->len += r;
+  }
+  *nl = '\0';
+  strcpy(line, c->buf);
+  c->len -= nl + 1 - c->buf;
+  memmove(c->buf, nl + 1, c->len);
+  return line;
+}
+
+/* Print a result, FALSE if the line is not a result */
+static int print_result(const char *line) {
+  const char *json;
+
+  if (strncmp(line, "RESULT ", 7)) {
+    return FALSE;
+  }
+  json = strchr(line + 7, ' ');
+  printf("%s\n", json != NULL ? json + 1 : "");
+  fflush(stdout);
+  return TRUE;
+}
+
+/* Submit a job and wait for its reply, printing the results received meanwhile */
+static int submit(conn_t *c, const char *opts, const char *record, long *nresults, long *nqueued) {
+  char *line;
+  size_t len = strlen(opts) + strlen(record) + 8;
+
+  if (len > DAEMON_LINE_SIZE) {
+    fprintf(stderr, "[!] Record too long\n");
+    return TRUE;
+  }
+  line = malloc(len);
+  snprintf(line, len, "JOB %s%s\n", opts, record);
+  if (!send_line(c, line)) {
+    free(line);
+    return FALSE;
+  }
+  free(line);
+
+  while ((line = read_line(c)) != NULL) {
+    if (print_result(line)) {
+      (*nresults)++;
+    }
+    else if (!strncmp(line, "QUEUED ", 7)) {
+      (*nqueued)++;
+      if (verb) {
+        fprintf(stderr, "[x] Job %s queued\n", line + 7);
+      }
+      return TRUE;
+    }
+    else {
+      fprintf(stderr, "[!] %s: %s\n", line, record);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* Name of the long option of code val */
+static const char *option_name(const struct option *long_options, int val) {
+  for (; long_options->name != NULL; long_options++) {
+    if (long_options->val == val) {
+      return long_options->name;
+    }
+  }
+  return "";
+}
+
+int main(int argc, char *argv[]) {
+  conn_t c;
+  FILE *fp;
+  char *path = NULL, *modulus = NULL, *exponent = NULL, *batch = NULL;
+  char opts[1024], record[DAEMON_LINE_SIZE], *line = NULL, *s;
+  int opt, status = FALSE, shutdown_daemon = FALSE, connected = TRUE;
+  size_t cap = 0, olen = 0;
+  long nresults = 0, nqueued = 0;
+  char options[] = ":n:e:vh";
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"socket", required_argument, NULL, 's'},
+    {"modulus", required_argument, NULL, 'n'},
+    {"exponent", required_argument, NULL, 'e'},
+    {"batch", required_argument, NULL, 'B'},
+    {"priority", required_argument, NULL, 'P'},
+    {"attacks", required_argument, NULL, 'a'},
+    {"budget", required_argument, NULL, 'U'},
+    {"timeout", required_argument, NULL, 't'},
+    {"fermat-bound", required_argument, NULL, 'Z'},
+    {"p1-prime-bound", required_argument, NULL, 'Y'},
+    {"p1-nbits-bound", required_argument, NULL, 'X'},
+    {"cm-disc-bound", required_argument, NULL, 'W'},
+    {"cm-disc", required_argument, NULL, 'D'},
+    {"status", no_argument, NULL, 'S'},
+    {"shutdown", no_argument, NULL, 'Q'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+
+  /* Options of the jobs, passed to the daemon as name=value */
+  opts[0] = '\0';
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'h':
+        usage();
+        return 0;
+      case 's':
+        path = optarg;
+        break;
+      case 'n':
+        modulus = optarg;
+        break;
+      case 'e':
+        exponent = optarg;
+        break;
+      case 'B':
+        batch = optarg;
+        break;
+      case 'S':
+        status = TRUE;
+        break;
+      case 'Q':
+        shutdown_daemon = TRUE;
+        break;
+      case 'P': case 'a': case 'U': case 't': case 'Z': case 'Y': case 'X': case 'W': case 'D':
+        if (strchr(optarg, ' ') != NULL || olen + strlen(optarg) + 32 > sizeof(opts)) {
+          fprintf(stderr, "[!] Invalid value %s\n", optarg);
+          return 1;
+        }
+        /* Same name in the protocol as the long option */
+        olen += snprintf(opts + olen, sizeof(opts) - olen, "%s=%s ", option_name(long_options, opt), optarg);
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        return 1;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c\n", optopt);
+        usage();
+        return 1;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  if (path == NULL || (modulus == NULL && batch == NULL && !status && !shutdown_daemon)) {
+    fprintf(stderr, "[!] A socket and a modulus, a batch file, --status or --shutdown must be provided\n");
+    usage();
+    return 1;
+  }
+  if (!connect_daemon(&c, path)) {
+    fprintf(stderr, "[!] Cannot connect to the daemon on %s\n", path);
+    return 1;
+  }
+
+  if (modulus != NULL) {
+    if (exponent != NULL) {
+      snprintf(record, sizeof(record), "%s %s", modulus, exponent);
+    }
+    else {
+      snprintf(record, sizeof(record), "%s", modulus);
+    }
+    connected = submit(&c, opts, record, &nresults, &nqueued);
+  }
+
+  if (batch != NULL && connected) {
+    fp = strcmp(batch, "-") ? fopen(batch, "r") : stdin;
+    if (fp == NULL) {
+      fprintf(stderr, "[!] Cannot open %s\n", batch);
+    }
+    else {
+      while (connected && getline(&line, &cap, fp) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        for (s = line; *s == ' ' || *s == '\t'; s++);
+        if (*s == '\0' || *s == '#') {
+          continue;
+        }
+        connected = submit(&c, opts, s, &nresults, &nqueued);
+      }
+      free(line);
+      if (fp != stdin) {
+        fclose(fp);
+      }
+    }
+  }
+
+  /* Results of the queued jobs */
+  while (connected && nresults < nqueued) {
+    s = read_line(&c);
+    if (s == NULL) {
+      connected = FALSE;
+    }
+    else if (print_result(s)) {
+      nresults++;
+    }
+  }
+
+  if (status && connected) {
+    connected = send_line(&c, "STATUS\n") && (s = read_line(&c)) != NULL;
+    if (connected) {
+      printf("%s\n", s);
+    }
+  }
+  if (shutdown_daemon && connected) {
+    connected = send_line(&c, "SHUTDOWN\n");
+  }
+
+  if (!connected) {
+    fprintf(stderr, "[!] Connection to the daemon lost, %ld results out of %ld jobs\n", nresults, nqueued);
+  }
+  close(c.fd);
+
+  return connected ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * Local coordinator of a sharded scan.
+ * The range [start, end) is cut in blocks handed out to the workers
+ * (rsa_partial_d, or rsa_single for the Fermat and p-1/p+1 attacks) which
+ * connect to the UNIX socket. The block of a worker which disconnects
+ * before completing it is handed out again.
+ * The first result found is printed on stdout and all the workers are stopped.
+ */
+
+typedef struct {
+  int fd;
+  char buf[COORD_LINE_SIZE];
+  size_t len;
+  long start, end;            /* block in progress, start = -1 if none */
+  int pending;                /* NEXT without reply */
+  int waiting;                /* WAIT without reply */
+} client_t;
+
+typedef struct {
+  long next, end, block;
+  long *queue;                /* blocks to hand out again */
+  long nqueue, done, total;
+  client_t *clients;
+  int nclients;
+  int over, found;
+} coord_state_t;
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_coord --socket <path> --end <val> [OPTIONS]\n"
+                  "  --socket PATH          UNIX socket of the coordinator\n"
+                  "  --start VAL            Start of the range (default is 0)\n"
+                  "  --end VAL              End of the range (excluded)\n"
+                  "  --block VAL            Size of the blocks handed out to the workers (default is 1000)\n"
+                  "  -h --help              Print help\n"
+                  "  -v, --verbose          More verbosity\n"
+                  "Workers: rsa_partial_d --coord PATH (range of k),\n"
+                  "         rsa_single --attack factor_fermat --coord PATH (range of Fermat offsets),\n"
+                  "         rsa_single --attack factor_p_pm_1 --coord PATH (range of stage 2 primes)\n"
+  );
+}
+
+static void reply(client_t *cl, const char *line) {
+  send(cl->fd, line, strlen(line), MSG_NOSIGNAL);
+}
+
+/* Hand out a block to a client waiting for one, FALSE if there is none left */
+static int hand_out(coord_state_t *st, client_t *cl) {
+  char line[64];
+
+  if (st->nqueue > 0) {
+    st->nqueue--;
+    cl->start = st->queue[2*st->nqueue];
+    cl->end = st->queue[2*st->nqueue+1];
+  }
+  else if (st->next < st->end) {
+    cl->start = st->next;
+    cl->end = st->next + st->block < st->end ? st->next + st->block : st->end;
+    st->next = cl->end;
+  }
+  else {
+    return FALSE;
+  }
+  snprintf(line, sizeof(line), "RANGE %ld %ld\n", cl->start, cl->end);
+  reply(cl, line);
+  cl->pending = FALSE;
+  return TRUE;
+}
+
+/* Block of a client back in the queue */
+static void requeue(coord_state_t *st, client_t *cl) {
+  if (cl->start < 0) {
+    return;
+  }
+  st->queue = realloc(st->queue, 2*(st->nqueue + 1)*sizeof(long));
+  st->queue[2*st->nqueue] = cl->start;
+  st->queue[2*st->nqueue+1] = cl->end;
+  st->nqueue++;
+  cl->start = -1;
+}
+
+static void handle_line(coord_state_t *st, client_t *cl, char *line) {
+  long a, b;
+
+  if (!strcmp(line, "NEXT")) {
+    /* A worker asking for a new block has given up the previous one */
+    requeue(st, cl);
+    cl->pending = TRUE;
+    hand_out(st, cl);
+  }
+  else if (!strcmp(line, "WAIT")) {
+    cl->waiting = TRUE;
+  }
+  else if (sscanf(line, "DONE %ld %ld", &a, &b) == 2) {
+    if (a == cl->start && b == cl->end) {
+      cl->start = -1;
+      st->done += b - a;
+      if (verb) {
+        fprintf(stderr, "[x] [%ld, %ld) done (%ld/%ld)\n", a, b, st->done, st->total);
+      }
+    }
+  }
+  else if (!strncmp(line, "FOUND ", 6)) {
+    if (!st->found) {
+      printf("%s\n", line + 6);
+      fflush(stdout);
+    }
+    st->over = st->found = TRUE;
+  }
+}
+
+/* Read the available data of a client, FALSE if it disconnected */
+static int handle_client(coord_state_t *st, client_t *cl) {
+  ssize_t r;
+  char *nl;
+
+  r = read(cl->fd, cl->buf + cl->len, sizeof(cl->buf) - 1 - cl->len);
+  if (r <= 0) {
+    return FALSE;
+  }
+  cl->len += r;
+  cl->buf[cl->len] = '\0';
+  while ((nl = strchr(cl->buf, '\n')) != NULL) {
+    *nl = '\0';
+    handle_line(st, cl, cl->buf);
+    cl->len -= nl + 1 - cl->buf;
+    memmove(cl->buf, nl + 1, cl->len + 1);
+  }
+  if (cl->len == sizeof(cl->buf) - 1) {
+    /* Line too long */
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void drop_client(coord_state_t *st, int i) {
+  requeue(st, &st->clients[i]);
+  close(st->clients[i].fd);
+  st->clients[i] = st->clients[--st->nclients];
+}
+
+int main(int argc, char *argv[]) {
+  struct sockaddr_un addr;
+  struct pollfd *fds = NULL;
+  coord_state_t st;
+  client_t *cl;
+  char *path = NULL;
+  int opt, lfd = -1, i, busy;
+  long start = 0;
+  char options[] = ":vh";
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"socket", required_argument, NULL, 's'},
+    {"start", required_argument, NULL, 'a'},
+    {"end", required_argument, NULL, 'b'},
+    {"block", required_argument, NULL, 'B'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+
+  memset(&st, 0, sizeof(st));
+  st.end = -1;
+  st.block = 1000;
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'h':
+        usage();
+        return 0;
+      case 's':
+        path = optarg;
+        break;
+      case 'a':
+        start = atol(optarg);
+        break;
+      case 'b':
+        st.end = atol(optarg);
+        break;
+      case 'B':
+        st.block = atol(optarg);
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        return 1;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c\n", optopt);
+        usage();
+        return 1;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  if (path == NULL || st.end <= start || st.block < 1) {
+    fprintf(stderr, "[!] A socket and a non-empty range must be provided\n");
+    usage();
+    return 1;
+  }
+  st.next = start;
+  st.total = st.end - start;
+
+  signal(SIGPIPE, SIG_IGN);
+  lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  unlink(path);
+  if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, 64)) {
+    fprintf(stderr, "[!] Cannot listen on %s\n", path);
+    return 1;
+  }
+  if (verb) {
+    fprintf(stderr, "[!] Coordinator of [%ld, %ld) listening on %s\n", start, st.end, path);
+  }
+
+  while (!st.over) {
+    fds = realloc(fds, (st.nclients + 1)*sizeof(struct pollfd));
+    fds[0].fd = lfd;
+    fds[0].events = POLLIN;
+    for (i = 0; i < st.nclients; i++) {
+      fds[i+1].fd = st.clients[i].fd;
+      fds[i+1].events = POLLIN;
+    }
+    if (poll(fds, st.nclients + 1, -1) < 0) {
+      continue;
+    }
+
+    /* Clients in reverse order: a dropped client is replaced by the last one */
+    for (i = st.nclients - 1; i >= 0; i--) {
+      if (fds[i+1].revents && !handle_client(&st, &st.clients[i])) {
+        drop_client(&st, i);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      st.clients = realloc(st.clients, (st.nclients + 1)*sizeof(client_t));
+      cl = &st.clients[st.nclients];
+      memset(cl, 0, sizeof(*cl));
+      cl->fd = accept(lfd, NULL, NULL);
+      cl->start = -1;
+      if (cl->fd >= 0) {
+        st.nclients++;
+      }
+    }
+
+    /* Blocks handed out again to the pending clients */
+    busy = FALSE;
+    for (i = 0; i < st.nclients; i++) {
+      cl = &st.clients[i];
+      if (cl->pending) {
+        hand_out(&st, cl);
+      }
+      busy |= cl->start >= 0;
+    }
+    if (!busy && st.nqueue == 0 && st.next >= st.end) {
+      fprintf(stderr, "[!] Range [%ld, %ld) completed without success\n", start, st.end);
+      st.over = TRUE;
+    }
+  }
+
+  /* Stop all the workers */
+  for (i = 0; i < st.nclients; i++) {
+    cl = &st.clients[i];
+    if (cl->pending || cl->waiting) {
+      reply(cl, "STOP\n");
+    }
+    close(cl->fd);
+  }
+  close(lfd);
+  unlink(path);
+  free(fds);
+  free(st.clients);
+  free(st.queue);
+
+  return st.found ? 0 : 2;
+}
@@ -0,0 +1,219 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/* Consecutive signature records under the same key */
+typedef struct {
+  key_rec_t *recs;
+  long n, cap;
+} fault_group_t;
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_fault [OPTIONS]\n"
+                  "List of options (values are expected in decimal):\n"
+                  "  --batch <file>  Read (n, e, m, s) records from file (- for stdin, the default), one per line,\n"
+                  "                  as JSON or decimal values; the signatures of a key are expected on consecutive lines\n"
+                  "  --threads <val> Number of worker threads (default is the number of CPUs)\n"
+                  "  --ordered       Write the results in the order of the input\n"
+                  "  --stack-size <val> Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max <val>  Ceiling of the PARI stacks, main and threads (default is 4G)\n"
+                  "  -v, --verbose   More verbosity\n"
+  );
+}
+
+/* Job of a worker thread: screen the signatures of one key */
+char *fault_job(void *data, void *arg) {
+  fault_group_t *g = data;
+  key_rec_t *rec = &g->recs[0];
+  single_res_t res;
+  GEN e, sigs;
+  GEN volatile modulus = NULL;
+  long i, nvalid;
+  (void)arg;
+
+  res.found = FALSE;
+  res.timeout = FALSE;
+  res.attack = "factor_fault_crt";
+  res.d = NULL;
+  if (rec->error == NULL) {
+    pari_CATCH(CATCH_ALL) {
+      modulus = NULL;
+      res.found = FALSE;
+    }
+    pari_TRY {
+      modulus = strtoi(rec->n);
+      e = strtoi(rec->e);
+      sigs = cgetg(g->n + 1, t_VEC);
+      for (i = 0; i < g->n; i++) {
+        gel(sigs, i + 1) = mkvec2(strtoi(g->recs[i].m), strtoi(g->recs[i].s));
+      }
+      i = factor_fault_crt(modulus, e, sigs, &nvalid, &res.p, &res.q);
+      /* The line of the faulty signature is reported */
+      if (i > 0) {
+        res.found = TRUE;
+        rec = &g->recs[i - 1];
+      }
+    }
+    pari_ENDCATCH;
+  }
+
+  return stream_result(rec, modulus, &res);
+}
+
+void fault_release(void *data) {
+  fault_group_t *g = data;
+  long i;
+
+  for (i = 0; i < g->n; i++) {
+    key_rec_free(&g->recs[i]);
+  }
+  free(g->recs);
+  free(g);
+}
+
+/* The record is moved into the group */
+void group_add(fault_group_t **g, key_rec_t *rec) {
+  if (*g == NULL) {
+    *g = calloc(1, sizeof(fault_group_t));
+  }
+  if ((*g)->n == (*g)->cap) {
+    (*g)->cap = (*g)->cap ? 2*(*g)->cap : 16;
+    (*g)->recs = realloc((*g)->recs, (*g)->cap*sizeof(key_rec_t));
+  }
+  (*g)->recs[(*g)->n++] = *rec;
+}
+
+/* Same key as the group */
+int group_match(fault_group_t *g, key_rec_t *rec) {
+  return g->n < FAULT_GROUP_MAX && !strcmp(g->recs[0].n, rec->n) && !strcmp(g->recs[0].e, rec->e);
+}
+
+/* Dispatch the keys of a text file to a pool of workers, with their consecutive signatures */
+void run_fault(const char *filename, int nthreads, int ordered) {
+  FILE *fp;
+  workers_t pool;
+  fault_group_t *g = NULL, *bad;
+  key_rec_t rec;
+  char *line = NULL;
+  size_t cap = 0;
+  long lineno = 0;
+  int status;
+
+  fp = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+  if (fp == NULL) {
+    fprintf(stderr, "[!] Cannot open %s\n", filename);
+    return;
+  }
+
+  nthreads = workers_start(&pool, nthreads, WORKER_PARISIZE_FAULT, ordered, WORKER_QUEUE_FACTOR*nthreads,
+                           stdout, fault_job, fault_release, NULL);
+  if (nthreads == 0) {
+    fprintf(stderr, "[!] Cannot start the worker threads\n");
+  }
+  else {
+    if (verb) {
+      fprintf(stderr, "[!] Screening with %d workers\n", nthreads);
+    }
+    while (getline(&line, &cap, fp) != -1) {
+      lineno++;
+      status = sig_rec_parse(line, lineno, &rec);
+      if (status == KEY_REC_SKIP) {
+        continue;
+      }
+      /* A malformed record is reported on its own */
+      if (status == KEY_REC_ERROR) {
+        bad = NULL;
+        group_add(&bad, &rec);
+        workers_submit(&pool, bad);
+        continue;
+      }
+      if (g != NULL && !group_match(g, &rec)) {
+        workers_submit(&pool, g);
+        g = NULL;
+      }
+      group_add(&g, &rec);
+    }
+    if (g != NULL) {
+      workers_submit(&pool, g);
+    }
+    workers_finish(&pool);
+  }
+
+  free(line);
+  if (fp != stdin) {
+    fclose(fp);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int opt, nthreads = -1, ordered = FALSE;
+  char options[] = ":vh";
+  char *batch = "-";
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"batch", required_argument, NULL, 'B'},
+    {"threads", required_argument, NULL, 'T'},
+    {"ordered", no_argument, NULL, 'O'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+  /* Initialization */
+  stack_init(argc, argv, options, long_options);
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'h':
+        usage();
+        goto end;
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'B':
+        batch = optarg;
+        break;
+      case 'T':
+        nthreads = atoi(optarg);
+        break;
+      case 'O':
+        ordered = TRUE;
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        goto end;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c", optopt);
+        usage();
+        goto end;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  if (nthreads < 1) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) {
+      nthreads = 1;
+    }
+  }
+  run_fault(batch, nthreads, ordered);
+
+end:
+  pari_close();
+
+  return 0;
+}
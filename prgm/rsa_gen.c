@@ -0,0 +1,153 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include "rsa.h"
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_gen --class <name> [OPTIONS]\n"
+                  "Generate weak keys, one JSON record per line (usable with rsa_single --batch)\n"
+                  "  --class <name>     Class of weak keys:\n"
+                  "                       close: close primes (factor_fermat)\n"
+                  "                       shared_lsb: primes sharing their lowest bits (factor_shared_lsb)\n"
+                  "                       p_pm_1: p-1 smooth (factor_p_pm_1)\n"
+                  "                       cm: 4p-1 = D*s^2 (factor_cm)\n"
+                  "                       small_d: small private exponent (factor_small_d, factor_wiener)\n"
+                  "                       partial_p: highest bits of p leaked (rsa_partial_p)\n"
+                  "                       partial_d: lowest bits of d leaked, with e = 3 (rsa_partial_d)\n"
+                  "  --bits <val>       Size of the modulus (default is 1024)\n"
+                  "  --count <val>      Number of keys (default is 1)\n"
+                  "  --seed <val>       Seed of the random generator, the same seed gives the same keys\n"
+                  "Parameter of the class (the default is within reach of the attacks with their default bounds):\n"
+                  "  --distance <val>   close: |p - q| < 2^val\n"
+                  "  --lsb <val>        shared_lsb: number of lowest bits shared by p and q\n"
+                  "  --b1 <val>         p_pm_1: bound on the prime factors of p-1\n"
+                  "  --disc <val>       cm: 4p-1 = D*s^2 with D = val (D = 3 mod 4)\n"
+                  "  --d-bits <val>     small_d: size of d\n"
+                  "  --leak <val>       partial_p, partial_d: number of leaked bits of p or d\n"
+                  "  --stack-size <val> Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max <val>  Ceiling of the PARI stacks, main and threads (default is 4G)\n"
+                  "  -v, --verbose      More verbosity\n"
+  );
+}
+
+void print_key(int cls, long i, weak_key_t *k) {
+  pari_printf("{\"id\": \"%s-%ld\", \"class\": \"%s\", \"n\": \"%Ps\", \"e\": \"%Ps\", "
+              "\"p\": \"%Ps\", \"q\": \"%Ps\", \"d\": \"%Ps\"",
+              WEAK_NAMES[cls], i, WEAK_NAMES[cls], k->n, k->e, k->p, k->q, k->d);
+  if (cls == WEAK_PARTIAL_P) {
+    pari_printf(", \"p1\": \"%Ps\", \"ell\": %ld", k->leak, k->ell);
+  }
+  else if (cls == WEAK_PARTIAL_D) {
+    pari_printf(", \"d0\": \"%Ps\", \"ell\": %ld", k->leak, k->ell);
+  }
+  pari_printf("}\n");
+}
+
+int main(int argc, char *argv[]) {
+  GEN seed;
+  weak_key_t k;
+  long i, nbits = 1024, count = 1, param = -1;
+  int opt, cls = -1;
+  char options[] = ":vh";
+  pari_sp av;
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"class", required_argument, NULL, 'c'},
+    {"bits", required_argument, NULL, 'b'},
+    {"count", required_argument, NULL, 'C'},
+    {"seed", required_argument, NULL, 's'},
+    {"distance", required_argument, NULL, 'P'},
+    {"lsb", required_argument, NULL, 'P'},
+    {"b1", required_argument, NULL, 'P'},
+    {"disc", required_argument, NULL, 'P'},
+    {"d-bits", required_argument, NULL, 'P'},
+    {"leak", required_argument, NULL, 'P'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+  /* Initialization */
+  stack_init(argc, argv, options, long_options);
+  seed = getseed();
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'h':
+        usage();
+        goto end;
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'c':
+        cls = weak_class_index(optarg);
+        if (cls < 0) {
+          fprintf(stderr, "[!] Unknown class: %s\n", optarg);
+          usage();
+          goto end;
+        }
+        break;
+      case 'b':
+        nbits = atol(optarg);
+        break;
+      case 'C':
+        count = atol(optarg);
+        break;
+      case 's':
+        seed = gp_read_str(optarg);
+        break;
+      case 'P':
+        param = atol(optarg);
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        goto end;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c", optopt);
+        usage();
+        goto end;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  if (cls < 0) {
+    fprintf(stderr, "[!] The class must be provided\n");
+    usage();
+    goto end;
+  }
+  if (param < 0) {
+    param = weak_default_param(cls, nbits);
+  }
+  if (verb) {
+    pari_fprintf(stderr, "[!] Random seed: %Ps\n", seed);
+    fprintf(stderr, "[!] %ld keys of class %s, %ld bits, parameter %ld\n", count, WEAK_NAMES[cls], nbits, param);
+  }
+
+  setrand(seed);
+  for (i = 0; i < count; i++) {
+    av = avma;
+    if (!weak_key_gen(cls, nbits, param, &k)) {
+      fprintf(stderr, "[!] Parameter %ld out of range for the class %s\n", param, WEAK_NAMES[cls]);
+      goto end;
+    }
+    print_key(cls, i, &k);
+    avma = av;
+  }
+
+end:
+  pari_close();
+
+  return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include "rsa.h"
+
+/*
+ * Microbenchmark of the arithmetic kernels.
+ * For each size, the inputs are derived from a single small d key of rsa_gen.
+ * A kernel is run in batches of iterations: the number of iterations is doubled
+ * until a batch lasts MICROBENCH_MIN_TIME (these runs are the warm-up),
+ * then MICROBENCH_REPEAT batches are timed and the median is reported.
+ * The stack peak is the high-water mark of the PARI stack during one run:
+ * the free part of the stack is filled with a pattern before the run, and the
+ * lowest word which no longer holds it is the deepest one used.
+ */
+
+#define MICROBENCH_STACK_FILL ((ulong)0xa5a5a5a5a5a5a5a5ULL)
+
+typedef struct {
+  weak_key_t k;
+  GEN x, z, A, B;             /* points and curve modulo n */
+  GEN m;                      /* exponent of the Lucas ladder */
+  GEN a;                      /* odd square, for the roots mod 2^(nbits/2) */
+  GEN s;                      /* sqrt(n) */
+  GEN p0, pow2;               /* lowest bits of p */
+  long nbits;
+} micro_input_t;
+
+typedef struct {
+  const char *name;
+  void (*run)(const micro_input_t *in);
+} micro_kernel_t;
+
+static const long SIZES[] = {1024, 2048, 3072, 4096, 8192};
+
+#define MICRO_SIZES (long)(sizeof(SIZES)/sizeof(SIZES[0]))
+
+static void k_dbl_xz(const micro_input_t *in) {
+  GEN x, z;
+  dbl_xz(in->x, in->z, in->A, in->B, &x, &z);
+}
+
+static void k_add_xz(const micro_input_t *in) {
+  GEN x, z;
+  add_xz(in->x, in->z, in->z, in->x, in->x, in->A, in->B, &x, &z);
+}
+
+static void k_ladder(const micro_input_t *in) {
+  GEN x, z;
+  ladder(in->k.n, in->x, in->A, in->B, &x, &z);
+}
+
+static void k_lucas_ladder(const micro_input_t *in) {
+  lucas_ladder(in->m, in->x);
+}
+
+static void k_sqrt_mod2(const micro_input_t *in) {
+  sqrt_mod2(in->a, in->nbits/2);
+}
+
+static void k_gauss_reduction(const micro_input_t *in) {
+  GEN u1, u2, v1, v2;
+  gauss_reduction(in->k.e, in->s, in->k.n, gen_0, &u1, &u2, &v1, &v2);
+}
+
+static void k_prime_factor_recovery(const micro_input_t *in) {
+  GEN p, q;
+  prime_factor_recovery(in->k.n, in->k.e, in->k.d, PRIME_RECOVERY_MAX_ITER, &p, &q);
+}
+
+static void k_factor_p_low(const micro_input_t *in) {
+  GEN p, q;
+  factor_p_low(in->k.n, in->p0, in->pow2, &p, &q);
+}
+
+static const micro_kernel_t KERNELS[] = {
+  {"dbl_xz", k_dbl_xz},
+  {"add_xz", k_add_xz},
+  {"ladder", k_ladder},
+  {"lucas_ladder", k_lucas_ladder},
+  {"sqrt_mod2", k_sqrt_mod2},
+  {"gauss_reduction", k_gauss_reduction},
+  {"prime_factor_recovery", k_prime_factor_recovery},
+  {"factor_p_low", k_factor_p_low}
+};
+
+#define MICRO_KERNELS (long)(sizeof(KERNELS)/sizeof(KERNELS[0]))
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_microbench [OPTIONS]\n"
+                  "Time the arithmetic kernels at 1024, 2048, 3072, 4096 and 8192 bits\n"
+                  "  --kernel <name>    Only this kernel: dbl_xz, add_xz, ladder (scalar n), lucas_ladder (64-bit exponent),\n"
+                  "                     sqrt_mod2, gauss_reduction, prime_factor_recovery, factor_p_low\n"
+                  "  --bits <val>       Only this size of modulus\n"
+                  "  --seed <val>       Seed of the random generator (default is 1)\n"
+                  "  --json             One JSON object per line instead of a table\n"
+                  "  --stack-size <val> Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max <val>  Ceiling of the PARI stacks, main and threads (default is 4G)\n"
+                  "  -v, --verbose      More verbosity\n"
+  );
+}
+
+/* Inputs of the kernels for a modulus of nbits bits, left on the stack */
+void micro_inputs(long nbits, micro_input_t *in) {
+  GEN n;
+  long h;
+
+  in->nbits = nbits;
+  weak_key_gen(WEAK_SMALL_D, nbits, weak_default_param(WEAK_SMALL_D, nbits), &in->k);
+  n = in->k.n;
+  in->x = gmodulo(randomi(n), n);
+  in->z = gmodulo(randomi(n), n);
+  in->A = gmodulo(randomi(n), n);
+  in->B = gmodulo(randomi(n), n);
+  in->m = addii(int2n(P_PM_1_NBITS_BOUND - 1), randomi(int2n(P_PM_1_NBITS_BOUND - 1)));
+  in->a = sqri(addiu(shifti(randomi(n), 1), 1));
+  in->s = sqrti(n);
+  /* Unknown part of p at a fixed distance of the bound n^(1/4) */
+  h = expi(in->k.p) + 1;
+  in->pow2 = int2n(h/2 + h/16);
+  in->p0 = remi2n(in->k.p, h/2 + h/16);
+}
+
+/* Time of iters runs of a kernel */
+double micro_batch(const micro_kernel_t *kn, const micro_input_t *in, long iters) {
+  double t = wall_clock();
+  long i;
+  pari_sp av = avma;
+
+  for (i = 0; i < iters; i++) {
+    kn->run(in);
+    avma = av;
+  }
+  return wall_clock() - t;
+}
+
+/* High-water mark of the PARI stack during one run of a kernel, in bytes */
+long micro_stack_peak(const micro_kernel_t *kn, const micro_input_t *in) {
+  pari_sp av = avma;
+  ulong *w, *bot = (ulong *)pari_mainstack->bot, *top = (ulong *)av;
+
+  for (w = bot; w < top; w++) {
+    *w = MICROBENCH_STACK_FILL;
+  }
+  kn->run(in);
+  avma = av;
+  for (w = bot; w < top && *w == MICROBENCH_STACK_FILL; w++);
+  return (long)((top - w)*sizeof(ulong));
+}
+
+int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+void micro_run(const micro_kernel_t *kn, const micro_input_t *in, int json) {
+  double ns[MICROBENCH_REPEAT];
+  long iters = 1, bytes, i;
+
+  /* Warm-up and calibration */
+  while (micro_batch(kn, in, iters) < MICROBENCH_MIN_TIME) {
+    iters *= 2;
+  }
+
+  for (i = 0; i < MICROBENCH_REPEAT; i++) {
+    ns[i] = 1e9*micro_batch(kn, in, iters)/iters;
+  }
+  qsort(ns, MICROBENCH_REPEAT, sizeof(double), cmp_double);
+
+  bytes = micro_stack_peak(kn, in);
+
+  if (json) {
+    printf("{\"kernel\": \"%s\", \"bits\": %ld, \"iterations\": %ld, \"ns_per_op\": %.0f, "
+           "\"ns_per_op_min\": %.0f, \"stack_peak_bytes\": %ld}\n",
+           kn->name, in->nbits, iters, ns[MICROBENCH_REPEAT/2], ns[0], bytes);
+  }
+  else {
+    printf("%-22s %6ld %14.0f %14.0f %12ld\n", kn->name, in->nbits, ns[MICROBENCH_REPEAT/2], ns[0], bytes);
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  GEN seed = gen_1;
+  micro_input_t in;
+  long i, j, nbits = 0;
+  int opt, json = FALSE;
+  char options[] = ":vh";
+  char *kernel = NULL;
+  pari_sp av;
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"kernel", required_argument, NULL, 'k'},
+    {"bits", required_argument, NULL, 'b'},
+    {"seed", required_argument, NULL, 's'},
+    {"json", no_argument, NULL, 'J'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+  /* Initialization */
+  stack_init(argc, argv, options, long_options);
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'h':
+        usage();
+        goto end;
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'k':
+        kernel = optarg;
+        break;
+      case 'b':
+        nbits = atol(optarg);
+        break;
+      case 's':
+        seed = gp_read_str(optarg);
+        break;
+      case 'J':
+        json = TRUE;
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        goto end;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c", optopt);
+        usage();
+        goto end;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  setrand(seed);
+  if (!json) {
+    printf("%-22s %6s %14s %14s %12s\n", "kernel", "bits", "ns/op", "min ns/op", "stack peak B");
+  }
+  for (i = 0; i < MICRO_SIZES; i++) {
+    if (nbits > 0 && SIZES[i] != nbits) {
+      continue;
+    }
+    av = avma;
+    if (verb) {
+      fprintf(stderr, "[x] Inputs for %ld bits...\n", SIZES[i]);
+    }
+    micro_inputs(SIZES[i], &in);
+    for (j = 0; j < MICRO_KERNELS; j++) {
+      if (kernel == NULL || !strcmp(kernel, KERNELS[j].name)) {
+        micro_run(&KERNELS[j], &in, json);
+      }
+    }
+    avma = av;
+  }
+
+end:
+  pari_close();
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include "rsa.h"
+
+void print_success(GEN p, GEN q) {
+  pari_printf("p = %Ps\nq = %Ps\n", p, q);
+}
+
+void usage() {
+  fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
+                  "Usage: ./rsa_partial_bits -n <modulus> --p <bits> --p-mask <mask> [--q <bits> --q-mask <mask>] [OPTIONS]\n"
+                  "  -n, --modulus VAL      Modulus (mandatory)\n"
+                  "  --p VAL                Known bits of p at their position (the other bits are ignored)\n"
+                  "  --p-mask VAL           Mask of the known bits of p (bits set to 1)\n"
+                  "  --q VAL                Known bits of q at their position\n"
+                  "  --q-mask VAL           Mask of the known bits of q\n"
+                  "  --threads VAL          Number of worker threads (default is the number of CPUs)\n"
+                  "  --timeout VAL          Stop the search after VAL seconds\n"
+                  "  --stack-size VAL       Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max VAL        Ceiling of the PARI stacks, main and threads (default is 4G)\n"
+                  "  -h --help              Print help\n"
+                  "  -v, --verbose          More verbosity\n"
+  );
+}
+
+int main(int argc, char *argv[]) {
+  GEN modulus = NULL, p, q, p_bits = gen_0, p_mask = gen_0, q_bits = gen_0, q_mask = gen_0;
+  char options[] = ":n:vh";
+  int opt, nthreads = -1;
+  double timeout = 0;
+
+  static struct option long_options[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"modulus", required_argument, NULL, 'n'},
+    {"p", required_argument, NULL, 'p'},
+    {"p-mask", required_argument, NULL, 'P'},
+    {"q", required_argument, NULL, 'q'},
+    {"q-mask", required_argument, NULL, 'Q'},
+    {"threads", required_argument, NULL, 'T'},
+    {"timeout", required_argument, NULL, 't'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+
+  /* Initialization */
+  stack_init(argc, argv, options, long_options);
+
+  /* Process arguments */
+  opt = getopt_long(argc, argv, options, long_options, NULL);
+  while (opt != -1) {
+    switch (opt) {
+      case 'v':
+        verb = TRUE;
+        break;
+      case 'h':
+        usage();
+        goto end;
+      case 'n':
+        modulus = gp_read_str(optarg);
+        break;
+      case 'p':
+        p_bits = gp_read_str(optarg);
+        break;
+      case 'P':
+        p_mask = gp_read_str(optarg);
+        break;
+      case 'q':
+        q_bits = gp_read_str(optarg);
+        break;
+      case 'Q':
+        q_mask = gp_read_str(optarg);
+        break;
+      case 'T':
+        nthreads = atoi(optarg);
+        break;
+      case 't':
+        timeout = atof(optarg);
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
+      case '?':
+        fprintf(stderr, "Unknown option: %c\n", optopt);
+        usage();
+        goto end;
+      case ':':
+        fprintf(stderr, "Missing argument for option %c\n", optopt);
+        usage();
+        goto end;
+    }
+    opt = getopt_long(argc, argv, options, long_options, NULL);
+  }
+
+  if (modulus == NULL) {
+    fprintf(stderr, "[!] Modulus must be provided\n");
+    usage();
+    goto end;
+  }
+
+  if (typ(p_bits) != t_INT || typ(p_mask) != t_INT || typ(q_bits) != t_INT || typ(q_mask) != t_INT
+      || signe(p_mask) < 0 || signe(q_mask) < 0) {
+    fprintf(stderr, "[!] Known bits and masks must be non-negative integers\n");
+    goto end;
+  }
+
+  if (verb) {
+    fprintf(stderr, "[!] Modulus bit length: %ld\n", logint(modulus, gen_2) + 1);
+  }
+
+  if (nthreads < 1) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) {
+      nthreads = 1;
+    }
+  }
+
+  if (timeout > 0) {
+    deadline_start(wall_clock() + timeout);
+  }
+
+  if (factor_bits_known(modulus, p_bits, p_mask, q_bits, q_mask, nthreads, &p, &q)) {
+    print_success(p, q);
+  }
+  else if (deadline_expired()) {
+    fprintf(stderr, "[!] Search stopped by the timeout\n");
+  }
+
+end:
+  pari_close();
+  return 0;
+}
@@ -4,14 +4,20 @@
  */
 
 #include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
 #include "rsa.h"
 
-int verb = FALSE;
-
 void print_success(GEN p, GEN q) {
   pari_printf("p = %Ps\nq = %Ps\n", p, q);
 }
 
+/* On SIGINT or SIGTERM, the scan stops at the next k and the checkpoint is saved */
+static void interrupt(int sig) {
+  (void)sig;
+  deadline_interrupt();
+}
+
 void usage() {
   fprintf(stderr, "rsatools version 0.1 of 2022-08-21\n"
                   "Usage: ./rsa_partial_p -n <modulus> -e <public exponent> -d <lowest bits of d> -l <number of bits known>\n"
@@ -22,15 +28,37 @@ void usage() {
                   "  --kstart VAL           1 < kstart < e (optional)\n"
                   "  --kend VAL             1 < kend < e (optional)\n"
                   "  --kdetect VAL          Detect k value (VAL is the mimimal number of shared lsb by the prime factors\n"
+                  "  --timeout VAL          Stop the scan after VAL seconds, it can be resumed with --kstart\n"
+                  "  --checkpoint FILE      Save the progress of the scan in FILE every few seconds\n"
+                  "  --resume               Continue the scan saved in the checkpoint file\n"
+                  "  --shard i/N            Scan the part i out of N of the range of k\n"
+                  "  --coord PATH           Scan the blocks of k handed out by the coordinator rsa_coord\n"
+                  "  --pipeline N           Filter k with k_detect and test the best candidates first with N threads\n"
+                  "  --stats FILE           Append the statistics of the attack as a JSON line (- for stderr)\n"
+                  "  --trace FILE           Write the timeline of the scan as trace events (chrome://tracing, Perfetto)\n"
+                  "Highest bits of d instead of the lowest ones (-l is still needed):\n"
+                  "  --d1 VAL               Known highest bits of d, the l lowest bits are unknown\n"
+                  "Leak of the CRT exponent dp = d mod (p - 1) instead of d (-l is still needed):\n"
+                  "  --dp0 VAL              Known lowest l bits of dp\n"
+                  "  --dp1 VAL              Known highest bits of dp, the l lowest bits are unknown\n"
+                  "  --threads VAL          Number of threads scanning k_p (default is the number of CPUs)\n"
+                  "  --stack-size VAL       Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max VAL        Ceiling of the PARI stacks, main and threads (default is 4G)\n"
                   "  -h --help              Print help\n"
                   "  -v, --verbose          More verbosity\n"
   );
 }
 
 int main(int argc, char *argv[]) {
-  GEN modulus = NULL, p, q, e = NULL, d0 = NULL;
-  long modulus_nbits, ell = -1, treshold = -1;
-  int opt, k_start = -1, k_end = -1, found = FALSE;
+  GEN seed, modulus = NULL, p, q, e = NULL, d0 = NULL, d1 = NULL, dp = NULL;
+  long modulus_nbits, ell = -1, treshold = -1, k_start = -1, k_end = -1, shard_i = 0, shard_n = 1;
+  double timeout = 0;
+  int opt, found = FALSE, resume = FALSE, pipeline = 0, dp_msb = FALSE, nthreads = -1;
+  char *ckfile = NULL, *coord_path = NULL, *line;
+  coord_t c;
+  uint64_t key;
+  checkpoint_t ck, *ckp = NULL;
+  stats_t st;
   char options[] = ":n:e:d:l:vh";
 
   static struct option long_options[] = {
@@ -41,12 +69,28 @@ int main(int argc, char *argv[]) {
     {"kstart", required_argument, NULL, 'k'},
     {"kend", required_argument, NULL, 'K'},
     {"kdetect", required_argument, NULL, 'D'},
+    {"timeout", required_argument, NULL, 't'},
+    {"checkpoint", required_argument, NULL, 'C'},
+    {"resume", no_argument, NULL, 'R'},
+    {"shard", required_argument, NULL, 'S'},
+    {"coord", required_argument, NULL, 'c'},
+    {"pipeline", required_argument, NULL, 'P'},
+    {"d1", required_argument, NULL, 'M'},
+    {"dp0", required_argument, NULL, 'L'},
+    {"dp1", required_argument, NULL, 'H'},
+    {"threads", required_argument, NULL, 'T'},
+    {"stats", required_argument, NULL, 'X'},
+    {"trace", required_argument, NULL, 'G'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
     {"help", no_argument, NULL, 'h'},
     {NULL, 0, NULL, 0}
 };
 
   /* Initialization */
-  pari_init(PARISIZE, MAXPRIME);
+  stack_init(argc, argv, options, long_options);
+
+  seed = getseed();
 
   /* Process arguments */
   opt = getopt_long(argc, argv, options, long_options, NULL);
@@ -79,6 +123,55 @@ int main(int argc, char *argv[]) {
       case 'D':
         treshold = atol(optarg);
         break;
+      case 't':
+        timeout = atof(optarg);
+        break;
+      case 'C':
+        ckfile = optarg;
+        break;
+      case 'R':
+        resume = TRUE;
+        break;
+      case 'S':
+        if (!shard_parse(optarg, &shard_i, &shard_n)) {
+          fprintf(stderr, "[!] Shard must be given as i/N with 0 <= i < N\n");
+          goto end;
+        }
+        break;
+      case 'c':
+        coord_path = optarg;
+        break;
+      case 'P':
+        pipeline = atoi(optarg);
+        break;
+      case 'M':
+        d1 = gp_read_str(optarg);
+        break;
+      case 'L':
+        dp = gp_read_str(optarg);
+        break;
+      case 'H':
+        dp = gp_read_str(optarg);
+        dp_msb = TRUE;
+        break;
+      case 'T':
+        nthreads = atoi(optarg);
+        break;
+      case 'X':
+        if (!stats_open(optarg)) {
+          fprintf(stderr, "[!] Cannot open the statistics file %s\n", optarg);
+          goto end;
+        }
+        break;
+      case 'G':
+        if (!trace_open(optarg)) {
+          fprintf(stderr, "[!] Cannot open the trace file %s\n", optarg);
+          goto end;
+        }
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
       case '?':
         fprintf(stderr, "Unknown option: %c\n", optopt);
         usage();
@@ -97,7 +190,7 @@ int main(int argc, char *argv[]) {
     goto end;
   }
 
-  if (d0 == NULL) {
+  if (d0 == NULL && d1 == NULL && dp == NULL) {
     fprintf(stderr, "[!] Lowest bits of d must be provided\n");
     usage();
     goto end;
@@ -120,23 +213,168 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "[!] Modulus bit length: %ld\n", modulus_nbits);
   }
 
+  /* Highest bits of d or leak of dp: scan of k or k_p with worker threads */
+  if (d1 != NULL || dp != NULL) {
+    if (d0 != NULL || (d1 != NULL && dp != NULL) || treshold != -1 || ckfile != NULL || coord_path != NULL
+        || pipeline > 0 || resume || shard_n > 1) {
+      fprintf(stderr, "[!] Options `--d1`, `--dp0` and `--dp1` can only be used with `--kstart`, `--kend`, `--timeout` and `--threads`\n");
+      goto end;
+    }
+    if (d1 != NULL && (k_start != -1 || k_end != -1)) {
+      fprintf(stderr, "[!] Option `--d1` cannot be used with `--kstart` and `--kend`: the range of k is given by d1\n");
+      goto end;
+    }
+    if (nthreads < 1) {
+      nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+      if (nthreads < 1) {
+        nthreads = 1;
+      }
+    }
+    if (timeout > 0) {
+      deadline_start(wall_clock() + timeout);
+    }
+    stats_begin(&st, d1 != NULL ? "factor_d_msb" : dp_msb ? "factor_dp_msb" : "factor_dp_lsb", modulus);
+    trace_begin(d1 != NULL ? "factor_d_msb" : dp_msb ? "factor_dp_msb" : "factor_dp_lsb");
+    if (d1 != NULL) {
+      found = factor_d_msb(modulus, e, d1, ell, nthreads, &p, &q);
+    }
+    else if (dp_msb) {
+      found = factor_dp_msb(modulus, e, dp, ell, k_start, k_end, nthreads, &p, &q);
+    }
+    else {
+      found = factor_dp_lsb(modulus, e, dp, ell, k_start, k_end, nthreads, &p, &q);
+    }
+    trace_end();
+    stats_end(&st, found);
+    if (found) {
+      print_success(p, q);
+    }
+    else if (deadline_expired()) {
+      fprintf(stderr, "[!] Scan stopped by the timeout\n");
+    }
+    goto end;
+  }
+
+  if (resume && ckfile == NULL) {
+    fprintf(stderr, "[!] Option `--resume` needs a checkpoint file (`--checkpoint`)\n");
+    goto end;
+  }
+
+  if (pipeline > 0 && (treshold != -1 || ckfile != NULL || coord_path != NULL)) {
+    fprintf(stderr, "[!] Option `--pipeline` cannot be used with `--kdetect`, `--checkpoint` or `--coord`\n");
+    goto end;
+  }
+
+  /*
+   * The checkpoint is identified by the parameters of the scan,
+   * but not by the range of k: workers scanning several ranges can share it.
+   */
+  if (ckfile != NULL) {
+    key = int_hash(modulus, int_hash(e, int_hash(d0, (uint64_t)ell << 8 | (treshold + 1))));
+    if (!checkpoint_open(&ck, ckfile, key, itou(seed), resume)) {
+      goto end;
+    }
+    ckp = &ck;
+    seed = utoi(ck.seed);
+    signal(SIGINT, interrupt);
+    signal(SIGTERM, interrupt);
+  }
+  setrand(seed);
+  if (verb) {
+    pari_fprintf(stderr, "[!] Random seed: %Ps\n", seed);
+  }
+
+  if (timeout > 0) {
+    deadline_start(wall_clock() + timeout);
+  }
+
   /* For option `--kdetect`, we do not run the attack */
   if (treshold != -1) {
     if (mod4(modulus) == 1) {
-      k_detect(modulus, e, d0, ell, treshold);
+      stats_begin(&st, "k_detect", modulus);
+      trace_begin("k_detect");
+      k_detect_checkpoint(modulus, e, d0, ell, treshold, ckp);
+      trace_end();
+      stats_end(&st, FALSE);
     }
     else {
       fprintf(stderr, "[!] Option `--kdetect` cannot be used if n mod 4 = 3\n");
     }
   }
+  else if (coord_path != NULL) {
+    /* Blocks of k from the coordinator, which stops all the workers at the first success */
+    if (!coord_connect(&c, coord_path)) {
+      fprintf(stderr, "[!] Cannot connect to the coordinator %s\n", coord_path);
+    }
+    else {
+      stats_begin(&st, "factor_d_lsb", modulus);
+      while (!found && coord_next(&c, &k_start, &k_end)) {
+        if (verb) {
+          fprintf(stderr, "[x] Block of k: [%ld, %ld)\n", k_start, k_end);
+        }
+        trace_begin("block");
+        found = factor_d_lsb_checkpoint(modulus, e, d0, ell, k_start, k_end, ckp, &p, &q);
+        trace_end();
+        if (found) {
+          line = pari_sprintf("p = %Ps q = %Ps", p, q);
+          coord_found(&c, line);
+          pari_free(line);
+          print_success(p, q);
+        }
+        else if (!deadline_expired()) {
+          coord_done(&c, k_start, k_end);
+        }
+      }
+      stats_end(&st, found);
+      coord_close(&c);
+    }
+  }
   else {
-    found = factor_d_lsb(modulus, e, d0, ell, k_start, k_end, &p, &q);
+    /* Part of the range [kstart, kend) of this shard */
+    if (shard_n > 1) {
+      k_start = k_start < 1 ? 1 : k_start;
+      k_end = (k_end < 2 || k_end > itos(e)) ? itos(e) : k_end;
+      shard_range(shard_i, shard_n, &k_start, &k_end);
+      if (verb) {
+        fprintf(stderr, "[!] Shard %ld/%ld: %ld <= k < %ld\n", shard_i, shard_n, k_start, k_end);
+      }
+    }
+    stats_begin(&st, pipeline > 0 ? "factor_d_lsb_pipeline" : "factor_d_lsb", modulus);
+    trace_begin(pipeline > 0 ? "factor_d_lsb_pipeline" : "factor_d_lsb");
+    if (pipeline > 0) {
+      found = factor_d_lsb_pipeline(modulus, e, d0, ell, k_start, k_end, pipeline, &p, &q);
+    }
+    else {
+      found = factor_d_lsb_checkpoint(modulus, e, d0, ell, k_start, k_end, ckp, &p, &q);
+    }
+    trace_end();
+    stats_end(&st, found);
     if (found) {
       print_success(p, q);
     }
   }
 
+  if (deadline_expired() && coord_path == NULL) {
+    fprintf(stderr, "[!] Scan stopped at k = %ld\n", deadline_reached(NULL));
+    if (ckp != NULL) {
+      fprintf(stderr, "    Resume the scan with `--checkpoint %s --resume`\n", ckfile);
+    }
+    else if (pipeline > 0) {
+      fprintf(stderr, "    Candidates are tested out of order: resume stage 1 with `--kstart %ld`\n"
+                      "    after the candidates already printed with `-v`\n", deadline_reached(NULL));
+    }
+    else if (treshold == -1) {
+      fprintf(stderr, "    Resume the scan with `--kstart %ld`\n", deadline_reached(NULL));
+    }
+  }
+
+  if (ckp != NULL) {
+    checkpoint_close(ckp);
+  }
+
 end:
+  stats_close();
+  trace_close();
   pari_close();
   return 0;
 }
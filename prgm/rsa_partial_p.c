@@ -4,10 +4,9 @@
  */
 
 #include <getopt.h>
+#include <unistd.h>
 #include "rsa.h"
 
-int verb = FALSE;
-
 void print_success(GEN p, GEN q) {
   pari_printf("p = %Ps\nq = %Ps\n", p, q);
 }
@@ -22,29 +21,41 @@ void usage() {
                   "  --p1 VAL               Known highest part of p\n"
                   "The value m can be provided in two ways:\n"
                   "  -m VAL                 Value of m\n"
-                  "  -l VAL                 Shortcut for m=2^l\n\n"
+                  "  -l VAL                 Shortcut for m=2^l\n"
+                  "Or give the known bits of p at their position with --p0 and:\n"
+                  "  --mask VAL             Mask of the known bits of p (bits set to 1), the unknown bits are guessed\n"
+                  "  --threads VAL          Number of threads guessing the unknown bits (default is the number of CPUs)\n\n"
+                  "  --stats FILE           Append the statistics of the attack as a JSON line (- for stderr)\n"
+                  "  --stack-size VAL       Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max VAL        Ceiling of the PARI stacks, main and threads (default is 4G)\n"
                   "  -h --help              Print help\n"
                   "  -v, --verbose          More verbosity\n"
   );
 }
 
 int main(int argc, char *argv[]) {
-  GEN modulus = NULL, p, q, m = NULL, p_part = NULL;
+  GEN modulus = NULL, p, q, m = NULL, p_part = NULL, mask = NULL;
   char options[] = ":n:m:l:vh";
-  int opt, hi = FALSE, found = FALSE;
+  int opt, hi = FALSE, found = FALSE, nthreads = -1;
   long modulus_nbits, ell = -1;
+  stats_t st;
 
   static struct option long_options[] = {
     {"verbose", no_argument, NULL, 'v'},
     {"modulus", required_argument, NULL, 'n'},
     {"p0", required_argument, NULL, 'L'},
     {"p1", required_argument, NULL, 'H'},
+    {"mask", required_argument, NULL, 'M'},
+    {"threads", required_argument, NULL, 'T'},
+    {"stats", required_argument, NULL, 'X'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
     {"help", no_argument, NULL, 'h'},
     {NULL, 0, NULL, 0}
 };
 
   /* Initialization */
-  pari_init(PARISIZE, MAXPRIME);
+  stack_init(argc, argv, options, long_options);
 
   /* Process arguments */
   opt = getopt_long(argc, argv, options, long_options, NULL);
@@ -96,6 +107,21 @@ int main(int argc, char *argv[]) {
           goto end;
         }
         break;
+      case 'M':
+        mask = gp_read_str(optarg);
+        break;
+      case 'T':
+        nthreads = atoi(optarg);
+        break;
+      case 'X':
+        if (!stats_open(optarg)) {
+          fprintf(stderr, "[!] Cannot open the statistics file %s\n", optarg);
+          goto end;
+        }
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
+        break;
       case '?':
         fprintf(stderr, "Unknown option: %c\n", optopt);
         usage();
@@ -120,6 +146,27 @@ int main(int argc, char *argv[]) {
     goto end;
   }
 
+  if (mask != NULL) {
+    if (hi || m != NULL || ell != -1) {
+      fprintf(stderr, "[!] Option `--mask` is used with `--p0` only\n");
+      usage();
+      goto end;
+    }
+    if (nthreads < 1) {
+      nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+      if (nthreads < 1) {
+        nthreads = 1;
+      }
+    }
+    stats_begin(&st, "factor_p_mask", modulus);
+    found = factor_p_mask(modulus, p_part, mask, nthreads, &p, &q);
+    stats_end(&st, found);
+    if (found) {
+      print_success(p, q);
+    }
+    goto end;
+  }
+
   if (m == NULL && ell == -1) {
     fprintf(stderr, "The value for m must be provided\n");
     usage();
@@ -135,18 +182,21 @@ int main(int argc, char *argv[]) {
     m = shifti(gen_1, ell);
   }
 
+  stats_begin(&st, hi ? "factor_p_hi" : "factor_p_low", modulus);
   if (hi) {
     found = factor_p_hi(modulus, p_part, m, &p, &q);
   }
   else {
     found = factor_p_low(modulus, p_part, m, &p, &q);
   }
+  stats_end(&st, found);
   
   if (found) {
     print_success(p, q);
   }
 
 end:
+  stats_close();
   pari_close();
   return 0;
 }
\ No newline at end of file
@@ -4,10 +4,9 @@
  */
 
 #include <getopt.h>
+#include <unistd.h>
 #include "rsa.h"
 
-int verb = FALSE;
-
 void print_success(GEN p, GEN q) {
   pari_printf("p = %Ps\nq = %Ps\n", p, q);
 }
@@ -25,7 +24,10 @@ void usage() {
                   "  -n, --modulus          Modulus\n"
                   "  -e, --exponent         Public exponent\n"
                   "  -d,                    Private exponent (only for prime factor recovery)\n"
+                  "  --stack-size <val>     Initial PARI stack in bytes, with suffix k, M or G (default is 32M)\n"
+                  "  --stack-max <val>      Ceiling of the PARI stacks, main and threads (default is 4G)\n"
                   "  -v, --verbose          More verbosity\n"
+                  "  --seed <val>           Seed of the random streams of the attacks, to replay a run (default is random)\n"
                   "  --attack <attack name> Run a specific attack:\n"
                   "                           factor_small: for modulus less than 200 bits\n"
                   "                           factor_square: for modulus such that n = p^2\n"
@@ -35,24 +37,288 @@ void usage() {
                   "                           factor_shared_lsb: if prime factors have half of their least significant bits identical\n"
                   "                           factor_p_pm_1: the p-1 and p+1 methods\n"
                   "                           factor_cm: the 4p-1 factorization methods using elliptic curves\n"
+                  "                           factor_siqs: the quadratic sieve, for modulus of 200 to 350 bits\n"
                   "  --fermat-bound <val>   Default is 50000, increase the value if needed\n"
                   "  --p1-prime-bound <val> Bound on the prime factors of p-1 or p+1 (default is 2^16)\n"
                   "  --p1-nbits-bound <val> Bound on prime power factors of p-1 or p+1, value in bits (default is 64)\n"
                   "  --cm-disc <val>        For 4p-1 attack: to specify a CM-discriminant in absolute value (example: 11)\n"
                   "  --cm-disc-bound <val>  For 4p-1 attack: run the attack with discriminants between -3 and -val\n"
+                  "  --siqs-fb <val>        For quadratic sieve: size of the factor base (default depends on the modulus)\n"
+                  "  --siqs-block <val>     For quadratic sieve: size of the sieve blocks in bytes (default is 32768)\n"
+                  "  --budget <sec>         Time budget per attack, a stopped attack reports how far it got\n"
+                  "  --timeout <sec>        Time budget of all the attacks\n"
+                  "  --fixed-order          Run all the attacks in the fixed order above, without the planner\n"
+                  "  --cache <file>         Result cache: skip the work already done on the same modulus\n"
+                  "  --stats <file>         Append the statistics of each attack as JSON lines (- for stderr)\n"
+                  "  --trace <file>         Write the timeline of the attacks as trace events (chrome://tracing, Perfetto)\n"
+                  "  --key <file>           Read the modulus and public exponent from a PEM, DER or OpenSSH public key file\n"
+                  "Sharded attacks (factor_fermat or factor_p_pm_1 with --attack):\n"
+                  "  --shard <i/N>          Run the shard i out of N of the Fermat offsets or of the stage 2 primes\n"
+                  "  --coord <path>         Run the blocks handed out by the coordinator rsa_coord\n"
+                  "  --p1-stage2-bound <val> Bound on the largest prime factor of p-1 or p+1 for the stage 2\n"
+                  "Streaming mode (one JSON result per line on stdout):\n"
+                  "  --batch <file>         Read (n, e) records from file (- for stdin), one per line, as JSON or decimal values\n"
+                  "  --keys <file>          Read all the keys of a PEM, DER or OpenSSH public key file\n"
+                  "  --threads <val>        Number of worker threads, or of threads of the quadratic sieve (default is the number of CPUs)\n"
+                  "  --ordered              Write the results in the order of the input\n"
+                  "  --triage               Only run cheap checks, and write the flags of each key and the attacks to run\n"
+                  "Daemon mode (jobs submitted with rsa_client):\n"
+                  "  --daemon <path>        Run the jobs received on the UNIX socket path, with --threads workers\n"
   );
 }
 
+/* Public key of a record, from decimal strings or from big-endian bytes */
+GEN record_key(key_rec_t *rec, GEN *e) {
+  if (rec->n_bytes != NULL) {
+    *e = rec->e_bytes != NULL ? int_from_bytes(rec->e_bytes, rec->e_len) : NULL;
+    return int_from_bytes(rec->n_bytes, rec->n_len);
+  }
+  *e = rec->e != NULL ? strtoi(rec->e) : NULL;
+  return strtoi(rec->n);
+}
+
+/* Job of a worker thread: run the attacks on one record */
+char *stream_job(void *data, void *arg) {
+  key_rec_t *rec = data;
+  single_cfg_t cfg = *(const single_cfg_t *)arg;
+  single_res_t res;
+  GEN e;
+  GEN volatile modulus = NULL;
+
+  /* Attacks selected for this record, for instance by the triage pass */
+  if (rec->attacks != NULL) {
+    cfg.select = attack_set(rec->attacks);
+  }
+
+  res.found = FALSE;
+  res.timeout = FALSE;
+  if (rec->error == NULL) {
+    pari_CATCH(CATCH_ALL) {
+      modulus = NULL;
+      res.found = FALSE;
+    }
+    pari_TRY {
+      modulus = record_key(rec, &e);
+      run_single(&cfg, modulus, e, NULL, &res);
+    }
+    pari_ENDCATCH;
+  }
+
+  return stream_result(rec, modulus, &res);
+}
+
+/* Job of a worker thread in triage mode: the cheap checks on one record */
+char *triage_job(void *data, void *arg) {
+  key_rec_t *rec = data;
+  triage_t t;
+  GEN volatile modulus = NULL, e = NULL;
+  (void)arg;
+
+  memset(&t, 0, sizeof(t));
+  if (rec->error == NULL) {
+    pari_CATCH(CATCH_ALL) {
+      modulus = NULL;
+    }
+    pari_TRY {
+      modulus = record_key(rec, (GEN *)&e);
+      triage_key(modulus, e, &t);
+    }
+    pari_ENDCATCH;
+  }
+
+  return triage_result(rec, modulus, e, &t);
+}
+
+void stream_release(void *data) {
+  key_rec_t *rec = data;
+  key_rec_free(rec);
+  free(rec);
+}
+
+/* Start the pool of workers for the streaming mode, running the attacks or the triage pass */
+int stream_start(workers_t *pool, const single_cfg_t *cfg, int nthreads, int ordered) {
+  if (cfg->triage) {
+    triage_init();
+  }
+  else {
+    tables_init(cfg->cm_disc_bound, cfg->p1_prime_bound, cfg->p1_nbits_bound);
+  }
+  nthreads = workers_start(pool, nthreads, WORKER_PARISIZE, ordered, WORKER_QUEUE_FACTOR*nthreads,
+                           stdout, cfg->triage ? triage_job : stream_job, stream_release, (void *)cfg);
+  if (nthreads == 0) {
+    fprintf(stderr, "[!] Cannot start the worker threads\n");
+  }
+  else if (verb) {
+    fprintf(stderr, "[!] %s mode with %d workers\n", cfg->triage ? "Triage" : "Streaming", nthreads);
+  }
+  return nthreads;
+}
+
+/* Tables of the streaming mode, once the workers are done */
+void stream_close() {
+  tables_close();
+  triage_close();
+}
+
+/* Streaming mode: dispatch the records of a text file to a pool of workers */
+void run_stream(const char *filename, const single_cfg_t *cfg, int nthreads, int ordered) {
+  FILE *fp;
+  workers_t pool;
+  key_rec_t *rec;
+  char *line = NULL;
+  size_t cap = 0;
+  long lineno = 0;
+
+  fp = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+  if (fp == NULL) {
+    fprintf(stderr, "[!] Cannot open %s\n", filename);
+    return;
+  }
+
+  if (stream_start(&pool, cfg, nthreads, ordered)) {
+    while (getline(&line, &cap, fp) != -1) {
+      lineno++;
+      rec = malloc(sizeof(key_rec_t));
+      if (key_rec_parse(line, lineno, rec) == KEY_REC_SKIP) {
+        free(rec);
+        continue;
+      }
+      workers_submit(&pool, rec);
+    }
+    workers_finish(&pool);
+  }
+  stream_close();
+
+  free(line);
+  if (fp != stdin) {
+    fclose(fp);
+  }
+}
+
+/* Streaming mode: dispatch the keys of a PEM, DER or OpenSSH file to a pool of workers */
+void run_stream_keys(const char *filename, const single_cfg_t *cfg, int nthreads, int ordered) {
+  pubkey_file_t f;
+  workers_t pool;
+  key_rec_t *rec;
+
+  if (!pubkey_open(filename, &f)) {
+    fprintf(stderr, "[!] Cannot read %s\n", filename);
+    return;
+  }
+
+  if (stream_start(&pool, cfg, nthreads, ordered)) {
+    rec = malloc(sizeof(key_rec_t));
+    while (pubkey_next(&f, rec)) {
+      workers_submit(&pool, rec);
+      rec = malloc(sizeof(key_rec_t));
+    }
+    free(rec);
+    /* The keys point into the mapping: wait for the workers before closing */
+    workers_finish(&pool);
+  }
+  stream_close();
+
+  pubkey_close(&f);
+}
+
+/* Range of a sharded attack: Fermat offsets, or primes of the stage 2 of p-1 and p+1 */
+int shard_attack(int id, GEN modulus, GEN xs, long start, long end, GEN *p, GEN *q) {
+  if (id == ATTACK_FERMAT) {
+    return factor_close_primes_range(modulus, p, q, start, end);
+  }
+  return factor_p_pm_1_stage2(modulus, xs, stoi(start), stoi(end), p, q);
+}
+
+/*
+ * Sharded Fermat or p-1/p+1 attack: either the shard i out of n of the range,
+ * or the blocks handed out by the coordinator listening on coord_path.
+ * Returns TRUE if the modulus is factored.
+ */
+int run_sharded(const single_cfg_t *cfg, GEN modulus, long i, long n, const char *coord_path) {
+  GEN p, q, xs = NULL;
+  long start, end;
+  int id = cfg->attack != NULL ? attack_index(cfg->attack) : -1;
+  int found = FALSE;
+  char *line;
+  coord_t c;
+
+  if (id == ATTACK_FERMAT) {
+    start = 0;
+    end = cfg->close_primes_bound;
+  }
+  else if (id == ATTACK_P_PM_1) {
+    start = cfg->p1_prime_bound + 1;
+    end = cfg->p1_stage2_bound;
+    if (end <= start) {
+      fprintf(stderr, "[!] The stage 2 bound (--p1-stage2-bound) must be above the prime bound\n");
+      return FALSE;
+    }
+    /* The stage 1 is run by each worker, the stage 2 is sharded */
+    if (verb) {
+      fprintf(stderr, "[x] Running p-1 and p+1 attack, stage 1...\n");
+    }
+    if (factor_p_pm_1_stage1(modulus, stoi(cfg->p1_prime_bound), cfg->p1_nbits_bound, &xs, &p, &q)) {
+      print_success(p, q);
+      return TRUE;
+    }
+  }
+  else {
+    fprintf(stderr, "[!] Only factor_fermat and factor_p_pm_1 can be sharded (use --attack)\n");
+    return FALSE;
+  }
+
+  if (coord_path == NULL) {
+    shard_range(i, n, &start, &end);
+    if (verb) {
+      fprintf(stderr, "[x] Shard %ld/%ld: [%ld, %ld)\n", i, n, start, end);
+    }
+    found = shard_attack(id, modulus, xs, start, end, &p, &q);
+  }
+  else {
+    if (!coord_connect(&c, coord_path)) {
+      fprintf(stderr, "[!] Cannot connect to the coordinator %s\n", coord_path);
+      return FALSE;
+    }
+    while (!found && coord_next(&c, &start, &end)) {
+      if (verb) {
+        fprintf(stderr, "[x] Block [%ld, %ld)\n", start, end);
+      }
+      found = shard_attack(id, modulus, xs, start, end, &p, &q);
+      if (found) {
+        line = pari_sprintf("p = %Ps q = %Ps", p, q);
+        coord_found(&c, line);
+        pari_free(line);
+      }
+      else if (!deadline_expired()) {
+        coord_done(&c, start, end);
+      }
+    }
+    coord_close(&c);
+  }
+
+  if (found) {
+    print_success(p, q);
+  }
+  else if (deadline_expired() && coord_path == NULL) {
+    fprintf(stderr, "[!] Stopped at %ld\n", deadline_reached(NULL));
+  }
+  return found;
+}
+
 int main(int argc, char *argv[]) {
-  GEN seed, modulus = NULL, p, q, e = NULL, d = NULL;
-  long close_primes_bound = FERMAT_BOUND;
-  long p1_prime_bound = P_PM_1_PRIME_BOUND;
-  long p1_nbits_bound = P_PM_1_NBITS_BOUND;
-  long cm_disc_bound = CM_ANOMALOUS_DISC_BOUND;
-  long disc = -1, modulus_nbits;
-  int opt, found = FALSE;
+  GEN modulus = NULL, e = NULL, d = NULL;
+  long modulus_nbits;
+  int opt, nthreads = -1, ordered = FALSE;
   char options[] = ":n:e:d:vh";
-  char *attack = NULL;
+  char *batch = NULL, *keys = NULL, *keyfile = NULL, *coord_path = NULL, *shard = NULL, *daemon_path = NULL;
+  long shard_i = 0, shard_n = 1;
+  ulong seed = 0;
+  pubkey_file_t f;
+  key_rec_t rec;
+  result_cache_t cache;
+  single_cfg_t cfg;
+  single_res_t res;
+  stats_t st;
 
   static struct option long_options[] = {
     {"verbose", no_argument, NULL, 'v'},
@@ -64,15 +330,34 @@ int main(int argc, char *argv[]) {
     {"cm-disc-bound", required_argument, NULL, 'W'},
     {"cm-disc", required_argument, NULL, 'D'},
     {"attack", required_argument, NULL, 'a'},
+    {"batch", required_argument, NULL, 'B'},
+    {"key", required_argument, NULL, 'k'},
+    {"cache", required_argument, NULL, 'C'},
+    {"keys", required_argument, NULL, 'K'},
+    {"threads", required_argument, NULL, 'T'},
+    {"ordered", no_argument, NULL, 'O'},
+    {"budget", required_argument, NULL, 'U'},
+    {"timeout", required_argument, NULL, 't'},
+    {"fixed-order", no_argument, NULL, 'F'},
+    {"p1-stage2-bound", required_argument, NULL, 'S'},
+    {"shard", required_argument, NULL, 'H'},
+    {"coord", required_argument, NULL, 'c'},
+    {"stats", required_argument, NULL, 'M'},
+    {"trace", required_argument, NULL, 'G'},
+    {"daemon", required_argument, NULL, 'J'},
+    {"seed", required_argument, NULL, 'R'},
+    {"siqs-fb", required_argument, NULL, 'Q'},
+    {"siqs-block", required_argument, NULL, 'L'},
+    {"triage", no_argument, NULL, 'I'},
+    {"stack-size", required_argument, NULL, OPT_STACK},
+    {"stack-max", required_argument, NULL, OPT_STACK},
     {"help", no_argument, NULL, 'h'},
     {NULL, 0, NULL, 0}
 };
 
   /* Initialization */
-  pari_init(PARISIZE, MAXPRIME);
-
-  seed = getseed();
-  setrand(seed);
+  stack_init(argc, argv, options, long_options);
+  single_cfg_init(&cfg);
 
   /* Process arguments */
   opt = getopt_long(argc, argv, options, long_options, NULL);
@@ -94,22 +379,103 @@ int main(int argc, char *argv[]) {
         d = gp_read_str(optarg);
         break;
       case 'D':
-        disc = atol(optarg);
+        cfg.disc = atol(optarg);
         break;
       case 'a':
-        attack = optarg;
+        cfg.attack = optarg;
         break;
       case 'Z':
-        close_primes_bound = atol(optarg);
+        cfg.close_primes_bound = atol(optarg);
         break;
       case 'Y':
-        p1_prime_bound = atol(optarg);
+        cfg.p1_prime_bound = atol(optarg);
         break;
       case 'X':
-        p1_nbits_bound = atol(optarg);
+        cfg.p1_nbits_bound = atol(optarg);
         break;
       case 'W':
-        cm_disc_bound = atol(optarg);
+        cfg.cm_disc_bound = atol(optarg);
+        break;
+      case 'B':
+        batch = optarg;
+        break;
+      case 'k':
+        keyfile = optarg;
+        break;
+      case 'C':
+        if (cfg.cache != NULL) {
+          cache_close(cfg.cache);
+        }
+        if (!cache_open(optarg, &cache)) {
+          fprintf(stderr, "[!] Cannot open the result cache %s\n", optarg);
+          goto end;
+        }
+        cfg.cache = &cache;
+        break;
+      case 'K':
+        keys = optarg;
+        break;
+      case 'T':
+        nthreads = atoi(optarg);
+        break;
+      case 'O':
+        ordered = TRUE;
+        break;
+      case 'U':
+        cfg.budget = atof(optarg);
+        break;
+      case 'F':
+        cfg.plan = FALSE;
+        break;
+      case 'S':
+        cfg.p1_stage2_bound = atol(optarg);
+        break;
+      case 'H':
+        shard = optarg;
+        if (!shard_parse(shard, &shard_i, &shard_n)) {
+          fprintf(stderr, "[!] Shard must be given as i/N with 0 <= i < N\n");
+          goto end;
+        }
+        break;
+      case 'c':
+        coord_path = optarg;
+        break;
+      case 't':
+        cfg.timeout = atof(optarg);
+        break;
+      case 'M':
+        if (!stats_open(optarg)) {
+          fprintf(stderr, "[!] Cannot open the statistics file %s\n", optarg);
+          goto end;
+        }
+        break;
+      case 'G':
+        if (!trace_open(optarg)) {
+          fprintf(stderr, "[!] Cannot open the trace file %s\n", optarg);
+          goto end;
+        }
+        break;
+      case 'J':
+        daemon_path = optarg;
+        break;
+      case 'R':
+        seed = strtoul(optarg, NULL, 10);
+        if (seed == 0) {
+          fprintf(stderr, "[!] The seed must be a positive integer\n");
+          goto end;
+        }
+        break;
+      case 'I':
+        cfg.triage = TRUE;
+        break;
+      case 'Q':
+        cfg.siqs_fb_size = atol(optarg);
+        break;
+      case 'L':
+        cfg.siqs_block_size = atol(optarg);
+        break;
+      case OPT_STACK:
+        /* Read by stack_init */
         break;
       case '?':
         fprintf(stderr, "Unknown option: %c\n", optopt);
@@ -123,135 +489,106 @@ int main(int argc, char *argv[]) {
     opt = getopt_long(argc, argv, options, long_options, NULL);
   }
 
-  if (modulus == NULL) {
-    fprintf(stderr, "[!] Modulus must be provided\n");
+  if (cfg.attack != NULL && attack_index(cfg.attack) < 0) {
+    fprintf(stderr, "[!] Unknown attack: %s\n", cfg.attack);
     usage();
     goto end;
   }
 
-  if (verb) {
-    pari_fprintf(stderr, "[!] Random seed: %Ps\n", seed);
+  /* Each attack on a key draws from its own stream, derived from the seed */
+  if (seed == 0) {
+    seed = itou(getseed());
   }
-
-  modulus_nbits = logint(modulus, gen_2) + 1;
+  rsa_ctx_get()->seed = seed;
+  setrand(utoi(seed));
   if (verb) {
-    fprintf(stderr, "[!] Modulus bit length: %ld\n", modulus_nbits);
+    fprintf(stderr, "[!] Random seed: %lu\n", seed);
   }
 
-  /* We run the prime factor recovery */
-  if (e != NULL && d != NULL) {
-    fprintf(stderr, "[x] Prime factor recovery...\n");
-    found = prime_factor_recovery(modulus, e, d, PRIME_RECOVERY_MAX_ITER, &p, &q);
-    if (found) {
-      print_success(p, q);
-      goto end;
+  if (nthreads < 1) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) {
+      nthreads = 1;
     }
   }
 
-  /* Run small modulus attack (n < 2^200 by default in config.h) */
-  if (attack == NULL || !strcmp(attack, "factor_small")) {
-    fprintf(stderr, "[x] Small modulus factorization...\n");
-    if (modulus_nbits <= SMALL_MODULUS_NBITS_BOUND) {
-      found = factor_small_modulus(modulus, &p, &q);
-      if (found) {
-        print_success(p, q);
-        goto end;
-      }
-    }
-    else {
-      fprintf(stderr, "    Skipped: modulus is too big (%ld bits)\n", modulus_nbits);
-    }
+  if (cfg.triage && batch == NULL && keys == NULL) {
+    fprintf(stderr, "[!] The triage pass reads the keys with --batch or --keys\n");
+    goto end;
   }
 
-  /* Run square modulus attack */
-  if (attack == NULL || !strcmp(attack, "factor_square")) {
-    fprintf(stderr, "[x] Square modulus factorization...\n");
-    found = factor_square_modulus(modulus, &p, &q);
-    if (found) {
-      print_success(p, q);
-      goto end;
+  /* Streaming and daemon modes: the records are read from a file, stdin or a socket */
+  if (batch != NULL || keys != NULL || daemon_path != NULL) {
+    cfg.quiet = TRUE;
+    if (daemon_path != NULL) {
+      daemon_run(daemon_path, &cfg, nthreads);
     }
-  }
-
-  /* Run small d attack (in case Wiener did not work) */
-  if (attack == NULL || !strcmp(attack, "factor_small_d")) {
-    fprintf(stderr, "[x] Running small d attack...\n");
-    if (e != NULL) {
-      found = factor_small_d(modulus, e, &d, &p, &q);
-      if (found) {
-        print_success_full(p, q, d);
-        goto end;
-      }
+    else if (batch != NULL) {
+      run_stream(batch, &cfg, nthreads, ordered);
     }
     else {
-      fprintf(stderr, "    Skipped: public exponent not provided (use -e option)\n");
+      run_stream_keys(keys, &cfg, nthreads, ordered);
     }
+    goto end;
   }
 
-  /* Run Wiener attack */
-  if (attack == NULL || !strcmp(attack, "factor_wiener")) {
-    fprintf(stderr, "[x] Running Wiener attack...\n");
-    if (e != NULL) {
-      found = factor_wiener(modulus, e, &d, &p, &q);
-      if (found) {
-        print_success_full(p, q, d);
-        goto end;
-      }
-      else if (d != NULL) {
-        pari_printf("d = %Ps\nFAILURE to recover prime factors\n", d);
-      }
+  /* The first key of a key file */
+  if (keyfile != NULL) {
+    if (!pubkey_open(keyfile, &f)) {
+      fprintf(stderr, "[!] Cannot read %s\n", keyfile);
+      goto end;
+    }
+    if (!pubkey_next(&f, &rec) || rec.error != NULL) {
+      fprintf(stderr, "[!] No RSA public key found in %s\n", keyfile);
     }
     else {
-      fprintf(stderr, "    Skipped: public exponent not provided (use -e option)\n");
+      modulus = int_from_bytes(rec.n_bytes, rec.n_len);
+      e = int_from_bytes(rec.e_bytes, rec.e_len);
     }
+    key_rec_free(&rec);
+    pubkey_close(&f);
   }
 
-  /* Run close primes attack (Fermat) */
-  if (attack == NULL || !strcmp(attack, "factor_fermat")) {
-    fprintf(stderr, "[x] Running close primes attack...\n");
-    found = factor_close_primes(modulus, &p, &q, close_primes_bound);
-    if (found) {
-      print_success(p, q);
-      goto end;
-    }
+  if (modulus == NULL) {
+    fprintf(stderr, "[!] Modulus must be provided\n");
+    usage();
+    goto end;
   }
 
-  /* Run shared lsb attack */
-  if (attack == NULL || !strcmp(attack, "factor_shared_lsb")) {  
-    fprintf(stderr, "[x] Running shared LSB attack...\n");
-    found = factor_shared_lsb(modulus, &p, &q);
-    if (found) {
-      print_success(p, q);
-      goto end;
-    }
+  modulus_nbits = logint(modulus, gen_2) + 1;
+  if (verb) {
+    fprintf(stderr, "[!] Modulus bit length: %ld\n", modulus_nbits);
   }
 
-  /* Run p-1 and p+1 attack */
-  if (attack == NULL || !strcmp(attack, "factor_p_pm_1")) {
-    fprintf(stderr, "[x] Running p-1 and p+1 attack...\n");
-    found = factor_p_plus_minus_one(modulus, &p, &q, stoi(p1_prime_bound), p1_nbits_bound);
-    if (found) {
-      print_success(p, q);
-      goto end;
-    }
+  /* Sharded attack */
+  if (shard != NULL || coord_path != NULL) {
+    deadline_start(cfg.timeout > 0 ? wall_clock() + cfg.timeout : 0);
+    stats_begin(&st, cfg.attack != NULL ? cfg.attack : "sharded", modulus);
+    stats_end(&st, run_sharded(&cfg, modulus, shard_i, shard_n, coord_path));
+    goto end;
   }
 
-  /* Run 4p-1 attack */
-  if (attack == NULL || !strcmp(attack, "factor_cm")) {
-    fprintf(stderr, "[x] Running 4p-1 attack...\n");
-    if (disc != -1) {
-      found = factor_cm_anomalous_core(modulus, -disc, &p, &q);
+  /* A single key: the quadratic sieve uses all the threads */
+  cfg.threads = nthreads;
+  if (run_single(&cfg, modulus, e, d, &res)) {
+    if (res.d != NULL) {
+      print_success_full(res.p, res.q, res.d);
     }
     else {
-      found = factor_cm_anomalous(modulus, &p, &q, cm_disc_bound);
-    }
-    if (found) {
-      print_success(p, q);
+      print_success(res.p, res.q);
     }
   }
+  else if (res.d != NULL) {
+    pari_printf("d = %Ps\nFAILURE to recover prime factors\n", res.d);
+  }
 
 end:
+  if (cfg.cache != NULL) {
+    cache_close(cfg.cache);
+  }
+  stats_close();
+  trace_close();
   pari_close();
 
   return 0;
-}
\ No newline at end of file
+}
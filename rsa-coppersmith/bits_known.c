@@ -0,0 +1,363 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <time.h>
+#include "rsa.h"
+
+/*
+ * Factorization from random known bits of p and q (Heninger-Shacham).
+ * The partial solutions (p', q') mod 2^i with p'*q' = n mod 2^i are extended
+ * one bit at a time from the least significant bit: bit i of p and q must satisfy
+ *   p_i + q_i = bit i of (n - p'*q') mod 2,
+ * so each level has at most two children, and one or none when bits are known.
+ * Once T bits are fixed, T being the smallest depth where the lattice has
+ * dimension at most BITS_KNOWN_LATTICE_DIM, p mod 2^T is given to Coppersmith method.
+ *
+ * The tree is explored by a depth-first search with work stealing: each worker
+ * pops the deepest node of its own deque, and an idle worker steals the shallowest
+ * node of another one (the largest subtree). A deque never holds more than one
+ * pending node per level, so the memory is bounded by the depth T.
+ */
+
+typedef struct {
+  pthread_mutex_t lock;
+  ulong *slots;               /* nodes: depth, p' and q' (nw words each) */
+  long top, bottom;           /* nodes in [top, bottom) */
+  long cap;
+} bits_deque_t;
+
+typedef struct {
+  GEN modulus, p_bits, p_mask, q_bits, q_mask;
+  long depth, nw;             /* T and the number of words of p' and q' */
+  int nthreads;
+  bits_deque_t *deques;
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  volatile int idle, stop;
+  GENbin *result;
+  long nodes, leaves;
+  rsa_ctx_t *ctx;
+  double deadline;
+  stats_t *stats;
+} bits_search_t;
+
+struct bits_worker_s {
+  bits_search_t *s;
+  int index;
+  struct pari_thread pth;
+  pthread_t tid;
+};
+
+#define NODE_WORDS(s) (1 + 2*(s)->nw)
+
+static void int_to_words(GEN x, ulong *w, long nw) {
+  long i, l = signe(x) ? lgefint(x) - 2 : 0;
+
+  for (i = 0; i < nw; i++) {
+    w[i] = i < l ? *int_W(x, i) : 0;
+  }
+}
+
+static GEN words_to_int(const ulong *w, long nw) {
+  GEN x = cgeti(nw + 2);
+  long i;
+
+  x[1] = evalsigne(1) | evallgefint(nw + 2);
+  for (i = 0; i < nw; i++) {
+    *int_W(x, i) = w[i];
+  }
+  return int_normalize(x, 0);
+}
+
+static void deque_push(bits_search_t *s, bits_deque_t *dq, long depth, GEN p, GEN q) {
+  ulong *node;
+  long size = NODE_WORDS(s);
+
+  pthread_mutex_lock(&dq->lock);
+  if (dq->bottom == dq->cap) {
+    memmove(dq->slots, dq->slots + dq->top*size, (dq->bottom - dq->top)*size*sizeof(ulong));
+    dq->bottom -= dq->top;
+    dq->top = 0;
+  }
+  /* Full after the compaction: grow the deque rather than overwrite a node */
+  if (dq->bottom == dq->cap) {
+    dq->cap *= 2;
+    dq->slots = realloc(dq->slots, dq->cap*size*sizeof(ulong));
+  }
+  node = dq->slots + dq->bottom*size;
+  node[0] = depth;
+  int_to_words(p, node + 1, s->nw);
+  int_to_words(q, node + 1 + s->nw, s->nw);
+  dq->bottom++;
+  pthread_mutex_unlock(&dq->lock);
+
+  if (s->idle > 0) {
+    pthread_mutex_lock(&s->lock);
+    pthread_cond_signal(&s->work);
+    pthread_mutex_unlock(&s->lock);
+  }
+}
+
+/* Deepest node of the own deque (from_top = FALSE) or shallowest node of another one */
+static int deque_pop(bits_search_t *s, bits_deque_t *dq, ulong *node, int from_top) {
+  long size = NODE_WORDS(s);
+  int ok;
+
+  pthread_mutex_lock(&dq->lock);
+  ok = dq->top < dq->bottom;
+  if (ok && from_top) {
+    memcpy(node, dq->slots + dq->top*size, size*sizeof(ulong));
+    dq->top++;
+  }
+  else if (ok) {
+    dq->bottom--;
+    memcpy(node, dq->slots + dq->bottom*size, size*sizeof(ulong));
+  }
+  pthread_mutex_unlock(&dq->lock);
+
+  return ok;
+}
+
+static int steal(bits_search_t *s, int me, ulong *node) {
+  int i;
+
+  for (i = 1; i < s->nthreads; i++) {
+    if (deque_pop(s, &s->deques[(me + i) % s->nthreads], node, TRUE)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* Wait for a node to steal, FALSE when the search is over (all the workers idle) */
+static int wait_work(bits_search_t *s, int me, ulong *node) {
+  struct timespec ts;
+  int ok = FALSE;
+
+  pthread_mutex_lock(&s->lock);
+  s->idle++;
+  for (;;) {
+    if (s->stop) {
+      break;
+    }
+    if (steal(s, me, node)) {
+      ok = TRUE;
+      break;
+    }
+    if (s->idle == s->nthreads) {
+      s->stop = TRUE;
+      pthread_cond_broadcast(&s->work);
+      break;
+    }
+    /* Timed wait: a push may not see this worker idle yet */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 50000000;
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&s->work, &s->lock, &ts);
+  }
+  s->idle--;
+  pthread_mutex_unlock(&s->lock);
+
+  return ok;
+}
+
+static void stop_search(bits_search_t *s) {
+  pthread_mutex_lock(&s->lock);
+  s->stop = TRUE;
+  pthread_cond_broadcast(&s->work);
+  pthread_mutex_unlock(&s->lock);
+}
+
+/* Value of bit i allowed by the known bits: -1 if unknown */
+static int known_bit(GEN bits, GEN mask, long i) {
+  return int_bit(mask, i) ? int_bit(bits, i) : -1;
+}
+
+static void *bits_worker(void *arg) {
+  struct bits_worker_s *wk = arg;
+  bits_search_t *s = wk->s;
+  bits_deque_t *dq = &s->deques[wk->index];
+  GEN modulus, p_bits, p_mask, q_bits, q_mask, m, pp, qq, pi, qi, fp, fq;
+  coppersmith_t ctx;
+  ulong *node;
+  long depth, nodes = 0, leaves = 0;
+  int c, bp, bq, kp, kq;
+  pari_sp av;
+
+  pari_thread_start(&wk->pth);
+  rsa_ctx_attach(s->ctx);
+  deadline_start(s->deadline);
+  stats_attach(s->stats);
+  trace_thread("worker");
+  node = malloc(NODE_WORDS(s)*sizeof(ulong));
+
+  modulus = gcopy(s->modulus);
+  p_bits = gcopy(s->p_bits);
+  p_mask = gcopy(s->p_mask);
+  q_bits = gcopy(s->q_bits);
+  q_mask = gcopy(s->q_mask);
+  m = int2n(s->depth);
+  coppersmith_p_low_init(&ctx, modulus, m);
+
+  av = avma;
+  while (!s->stop) {
+    if (!deque_pop(s, dq, node, FALSE) && !steal(s, wk->index, node) && !wait_work(s, wk->index, node)) {
+      break;
+    }
+    if (deadline_check()) {
+      stop_search(s);
+      break;
+    }
+    nodes++;
+    stats_iter();
+    depth = node[0];
+    pp = words_to_int(node + 1, s->nw);
+    qq = words_to_int(node + 1 + s->nw, s->nw);
+
+    /* Leaf: Coppersmith method with p mod 2^T */
+    if (depth == s->depth) {
+      leaves++;
+      if (factor_p_linear(&ctx, pp, m, &fp, &fq)) {
+        pthread_mutex_lock(&s->lock);
+        if (s->result == NULL) {
+          s->result = copy_bin(mkvec2(fp, fq));
+        }
+        pthread_mutex_unlock(&s->lock);
+        stop_search(s);
+        break;
+      }
+      avma = av;
+      continue;
+    }
+
+    /* Children: p_i + q_i = c mod 2 */
+    c = int_bit(modulus, depth) ^ int_bit(remi2n(mulii(pp, qq), depth + 1), depth);
+    kp = known_bit(p_bits, p_mask, depth);
+    kq = known_bit(q_bits, q_mask, depth);
+    for (bp = 0; bp <= 1; bp++) {
+      bq = c ^ bp;
+      if ((kp >= 0 && bp != kp) || (kq >= 0 && bq != kq)) {
+        continue;
+      }
+      pi = bp ? addii(pp, int2n(depth)) : pp;
+      qi = bq ? addii(qq, int2n(depth)) : qq;
+      deque_push(s, dq, depth + 1, pi, qi);
+    }
+    avma = av;
+  }
+
+  pthread_mutex_lock(&s->lock);
+  s->nodes += nodes;
+  s->leaves += leaves;
+  pthread_mutex_unlock(&s->lock);
+
+  free(node);
+  trace_thread_end();
+  pari_thread_close();
+  return NULL;
+}
+
+/*
+ * Factor the modulus from the bits of p and q given by their masks.
+ * The known bits above the depth T are not used.
+ */
+int factor_bits_known(GEN modulus, GEN p_bits, GEN p_mask, GEN q_bits, GEN q_mask, int nthreads,
+                      GEN *p, GEN *q) {
+  bits_search_t s;
+  struct bits_worker_s *workers;
+  GEN res;
+  long prime_len, h, i;
+  int n, found = FALSE;
+  pari_sp av = avma;
+
+  /* Smallest depth T where Coppersmith method is cheap */
+  prime_len = (logint(modulus, gen_2) + 1)/2;
+  memset(&s, 0, sizeof(s));
+  for (s.depth = 1; s.depth < prime_len; s.depth++) {
+    i = coppersmith_linear_dim(modulus, addiu(int2n(prime_len - s.depth), 1), &h);
+    if (i > 0 && i <= BITS_KNOWN_LATTICE_DIM) {
+      break;
+    }
+  }
+  avma = av;
+  if (verb) {
+    fprintf(stderr, "[!] Search of the %ld lowest bits of p and q\n", s.depth);
+  }
+
+  /* Both primes are odd */
+  if (known_bit(p_bits, p_mask, 0) == 0 || known_bit(q_bits, q_mask, 0) == 0) {
+    fprintf(stderr, "[!] The known bits give an even prime\n");
+    return FALSE;
+  }
+
+  s.modulus = modulus;
+  s.p_bits = p_bits;
+  s.p_mask = p_mask;
+  s.q_bits = q_bits;
+  s.q_mask = q_mask;
+  s.nw = nbits2nlong(s.depth + 1);
+  s.nthreads = nthreads;
+  s.ctx = rsa_ctx_get();
+  s.deadline = deadline_get();
+  s.stats = stats_get();
+  pthread_mutex_init(&s.lock, NULL);
+  pthread_cond_init(&s.work, NULL);
+  s.deques = calloc(nthreads, sizeof(bits_deque_t));
+  for (i = 0; i < nthreads; i++) {
+    pthread_mutex_init(&s.deques[i].lock, NULL);
+    s.deques[i].cap = 2*s.depth + 8;
+    s.deques[i].slots = malloc(s.deques[i].cap*NODE_WORDS(&s)*sizeof(ulong));
+  }
+  deque_push(&s, &s.deques[0], 1, gen_1, gen_1);
+
+  workers = calloc(nthreads, sizeof(struct bits_worker_s));
+  for (n = 0; n < nthreads; n++) {
+    workers[n].s = &s;
+    workers[n].index = n;
+    stack_thread_alloc(&workers[n].pth, WORKER_PARISIZE_BITS);
+    if (pthread_create(&workers[n].tid, NULL, bits_worker, &workers[n])) {
+      pari_thread_free(&workers[n].pth);
+      break;
+    }
+  }
+  /* The missing workers are idle for good */
+  pthread_mutex_lock(&s.lock);
+  s.idle += nthreads - n;
+  if (n == 0) {
+    fprintf(stderr, "[!] Cannot start the worker threads\n");
+  }
+  pthread_mutex_unlock(&s.lock);
+
+  for (i = 0; i < n; i++) {
+    pthread_join(workers[i].tid, NULL);
+    pari_thread_free(&workers[i].pth);
+  }
+  deadline_check();
+  if (verb) {
+    fprintf(stderr, "[x] %ld nodes explored, %ld candidates for p mod 2^%ld\n", s.nodes, s.leaves, s.depth);
+  }
+
+  if (s.result != NULL) {
+    res = bin_copy(s.result);
+    *p = gel(res, 1);
+    *q = gel(res, 2);
+    gerepileall(av, 2, p, q);
+    found = TRUE;
+  }
+
+  for (i = 0; i < nthreads; i++) {
+    free(s.deques[i].slots);
+    pthread_mutex_destroy(&s.deques[i].lock);
+  }
+  free(s.deques);
+  free(workers);
+  pthread_cond_destroy(&s.work);
+  pthread_mutex_destroy(&s.lock);
+
+  return found;
+}
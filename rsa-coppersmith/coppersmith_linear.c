@@ -0,0 +1,209 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <math.h>
+#include "rsa.h"
+
+/*
+ * Coppersmith method for the linear polynomial f(x) = x + a,
+ * with the Howgrave-Graham lattice: find the small roots x0, |x0| <= X,
+ * of f(x) mod p where p is a prime factor of the modulus N with p >= N^(1/2)/2.
+ *
+ * For a multiplicity h and t shifts, the lattice of dimension n = h + t is spanned by
+ *   N^(h-i)*f(xX)^i         for 0 <= i < h,
+ *   (xX)^j*f(xX)^h          for 0 <= j < t,
+ * all of them vanishing at x0/X mod p^h.
+ * The coefficient of x^k of the polynomial r is S[r][k]*a^(r-k),
+ * where S only depends on N, X and the shape (h, t): it is computed once
+ * by `coppersmith_linear_init`, and the calls for several values of a
+ * (e.g. the candidates for p0 in `factor_d_lsb`) only multiply by the powers of a.
+ */
+
+/*
+ * log2 of the bound on the shortest vector of the reduced lattice (LLL with
+ * the Lovasz condition 0.99) minus log2 of p^h/sqrt(n).
+ * The root is found if it is negative.
+ */
+static double shape_margin(long h, long t, double log_n, double log_x, double log_p) {
+  long n = h + t;
+  double log_det;
+
+  log_det = h*(h + 1)/2.*log_n + n*(n - 1)/2.*log_x;
+  return (n - 1)/4. + log_det/n + log2(n)/2. - h*log_p;
+}
+
+/*
+ * Smallest dimension of the lattice (then smallest multiplicity h) for the bound X on the root,
+ * 0 if X is too close to N^(1/4) for a lattice of dimension at most COPPERSMITH_MAX_DIM.
+ */
+long coppersmith_linear_dim(GEN modulus, GEN X, long *h) {
+  long n, prime_len;
+  double log_n, log_x, log_p;
+
+  prime_len = (logint(modulus, gen_2) + 1)/2;
+  log_n = expi(modulus) + 1;
+  log_x = signe(X) ? expi(X) + 1 : 0;
+  log_p = prime_len - 1;
+
+  for (n = 2; n <= COPPERSMITH_MAX_DIM; n++) {
+    for (*h = 1; *h < n; (*h)++) {
+      if (shape_margin(*h, n - *h, log_n, log_x, log_p) < 0) {
+        return n;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+ * Choose the smallest lattice for the bound X on the root and precompute its template.
+ * Returns FALSE if there is none (see `coppersmith_linear_dim`):
+ * the caller should use `zncoppersmith` instead.
+ * The context lives on the PARI stack of the caller.
+ */
+int coppersmith_linear_init(coppersmith_t *ctx, GEN modulus, GEN X) {
+  long n, h, r, k;
+  GEN Npow, col;
+
+  ctx->n = coppersmith_linear_dim(modulus, X, &ctx->h);
+  if (ctx->n == 0) {
+    return FALSE;
+  }
+  ctx->t = ctx->n - ctx->h;
+  n = ctx->n;
+  h = ctx->h;
+
+  ctx->modulus = modulus;
+  ctx->X = X;
+  ctx->Xpow = cgetg(n + 1, t_VEC);
+  gel(ctx->Xpow, 1) = gen_1;
+  for (k = 1; k < n; k++) {
+    gel(ctx->Xpow, k + 1) = mulii(gel(ctx->Xpow, k), X);
+  }
+  Npow = cgetg(h + 2, t_VEC);
+  gel(Npow, 1) = gen_1;
+  for (k = 1; k <= h; k++) {
+    gel(Npow, k + 1) = mulii(gel(Npow, k), modulus);
+  }
+
+  /* Column r: coefficients S[r][k] of x^k, 0 <= k <= r */
+  ctx->scale = cgetg(n + 1, t_VEC);
+  for (r = 0; r < n; r++) {
+    col = cgetg(n + 1, t_VEC);
+    for (k = 0; k < n; k++) {
+      if (r < h && k <= r) {
+        gel(col, k + 1) = mulii(mulii(gel(Npow, h - r + 1), binomialuu(r, k)), gel(ctx->Xpow, k + 1));
+      }
+      else if (r >= h && k >= r - h && k <= r) {
+        gel(col, k + 1) = mulii(binomialuu(h, k - (r - h)), gel(ctx->Xpow, k + 1));
+      }
+      else {
+        gel(col, k + 1) = gen_0;
+      }
+    }
+    gel(ctx->scale, r + 1) = col;
+  }
+
+  return TRUE;
+}
+
+/*
+ * Candidates for the roots x0 of x + a mod p with |x0| <= X.
+ * They must be checked by the caller.
+ */
+GEN coppersmith_linear_roots(const coppersmith_t *ctx, GEN a) {
+  GEN apow, M, col, pol, roots, res;
+  long n = ctx->n, r, k, i, nb = 0;
+  pari_sp av = avma;
+
+  apow = cgetg(n + 1, t_VEC);
+  gel(apow, 1) = gen_1;
+  for (k = 1; k < n; k++) {
+    gel(apow, k + 1) = mulii(gel(apow, k), a);
+  }
+
+  M = cgetg(n + 1, t_MAT);
+  for (r = 0; r < n; r++) {
+    col = cgetg(n + 1, t_COL);
+    for (k = 0; k < n; k++) {
+      if (k <= r) {
+        gel(col, k + 1) = mulii(gmael(ctx->scale, r + 1, k + 1), gel(apow, r - k + 1));
+      }
+      else {
+        gel(col, k + 1) = gen_0;
+      }
+    }
+    gel(M, r + 1) = col;
+  }
+
+  /* The shortest vector gives a polynomial with x0 as a root over the integers */
+  M = ZM_lll(M, 0.99, LLL_INPLACE);
+  stats_coppersmith();
+  col = gel(M, 1);
+  pol = cgetg(n + 1, t_VEC);
+  for (k = 0; k < n; k++) {
+    gel(pol, k + 1) = diviiexact(gel(col, k + 1), gel(ctx->Xpow, k + 1));
+  }
+  pol = RgV_to_RgX(pol, 0);
+  if (degpol(pol) < 1) {
+    avma = av;
+    return cgetg(1, t_VEC);
+  }
+
+  roots = nfroots(NULL, pol);
+  res = cgetg(lg(roots), t_VEC);
+  for (i = 1; i < lg(roots); i++) {
+    if (typ(gel(roots, i)) == t_INT && abscmpii(gel(roots, i), ctx->X) <= 0) {
+      gel(res, ++nb) = gel(roots, i);
+    }
+  }
+  setlg(res, nb + 1);
+
+  return gerepilecopy(av, res);
+}
+
+/*
+ * Factor the modulus if p = x0*m + p0 with |x0| <= X, X being the bound of the context.
+ * If m is not coprime to the modulus, gcd(m, modulus) is the factor.
+ */
+int factor_p_linear(const coppersmith_t *ctx, GEN p0, GEN m, GEN *p, GEN *q) {
+  GEN a, minv, res;
+  long i;
+  int found = FALSE;
+  pari_sp av = avma;
+
+  /* x*m + p0 = 0 mod p iff x + p0/m = 0 mod p, unless m shares a factor with the modulus */
+  if (!invmod(m, ctx->modulus, &minv)) {
+    *p = gcdii(m, ctx->modulus);
+    if (equali1(*p) || equalii(*p, ctx->modulus)) {
+      avma = av;
+      return FALSE;
+    }
+    *q = diviiexact(ctx->modulus, *p);
+    gerepileall(av, 2, p, q);
+    return TRUE;
+  }
+  a = Fp_mul(p0, minv, ctx->modulus);
+  res = coppersmith_linear_roots(ctx, a);
+
+  for (i = 1; i < lg(res); i++) {
+    *p = addii(mulii(gel(res, i), m), p0);
+    if (signe(*p) > 0 && !equali1(*p) && dvdii(ctx->modulus, *p) && !equalii(*p, ctx->modulus)) {
+      *q = diviiexact(ctx->modulus, *p);
+      found = TRUE;
+      break;
+    }
+  }
+
+  /* Garbage cleaning */
+  if (found) {
+    gerepileall(av, 2, p, q);
+  }
+  else {
+    avma = av;
+  }
+
+  return found;
+}
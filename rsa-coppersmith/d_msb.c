@@ -0,0 +1,187 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Partial key exposure on the most significant bits of d = d1*2^u + d0, d0 < 2^u.
+ * In e*d = 1 + k*(n - s + 1) with s = p + q, the value k is close to
+ *   e*d1*2^u/n,
+ * up to e*2^u/n + 2, so that there are only a few candidates for k.
+ * For each of them:
+ *   - s is known up to e*2^u/k, hence p = (s + sqrt(s^2 - 4n))/2 is known
+ *     in an interval [p_lo, p_hi],
+ *   - s mod e = n + 1 + 1/k, and p mod e is a root of x^2 - s*x + n (e prime):
+ *     the discriminant (p - q)^2 must be a square mod e, a cheap filter on k.
+ * Coppersmith method then finds p = c + e*y with |y| <= (p_hi - p_lo)/(2e) + 2.
+ * It needs about 3/4 of the bits of d for a small e.
+ */
+
+typedef struct {
+  GEN modulus, e, d1;
+  long u, k_first;
+} d_msb_arg_t;
+
+typedef struct {
+  GEN modulus, e, A, B, four_n, s_min;
+  const d_msb_arg_t *arg;
+} d_msb_state_t;
+
+static void *d_msb_init(void *arg) {
+  d_msb_arg_t *da = arg;
+  d_msb_state_t *st = (d_msb_state_t *)stack_malloc(sizeof(d_msb_state_t));
+
+  st->arg = da;
+  st->modulus = gcopy(da->modulus);
+  st->e = gcopy(da->e);
+  /* e*d is in [A, B) */
+  st->A = shifti(mulii(st->e, da->d1), da->u);
+  st->B = addii(st->A, shifti(st->e, da->u));
+  st->four_n = shifti(st->modulus, 2);
+  st->s_min = addiu(sqrtint(st->four_n), 1);
+  return st;
+}
+
+/* Larger root of x^2 - s*x + n */
+static GEN larger_root(GEN s, GEN four_n) {
+  return shifti(addii(s, sqrtint(subii(sqri(s), four_n))), -1);
+}
+
+/*
+ * Interval [*lo, *hi] of p for the value k, and the bound on (p - c)/e.
+ * Returns NULL if k is not a candidate.
+ */
+static GEN d_msb_bound(const d_msb_state_t *st, long k, GEN *lo, GEN *hi) {
+  GEN n1 = addiu(st->modulus, 1), s_lo, s_hi;
+
+  /* s = n + 1 - (e*d - 1)/k, for e*d in [A, B) */
+  s_hi = addiu(subii(n1, divis(subiu(st->A, 1), k)), 1);
+  s_lo = subiu(subii(n1, divis(st->B, k)), 1);
+  if (cmpii(s_hi, st->s_min) < 0) {
+    return NULL;
+  }
+  if (cmpii(s_lo, st->s_min) < 0) {
+    s_lo = st->s_min;
+  }
+  *lo = larger_root(s_lo, st->four_n);
+  *hi = addiu(larger_root(s_hi, st->four_n), 1);
+  return addiu(divii(shifti(subii(*hi, *lo), -1), st->e), 2);
+}
+
+static GEN d_msb_run(long i, void *state) {
+  d_msb_state_t *st = state;
+  GEN e = st->e, kinv, se, disc, r, roots, lo, hi, mid, bound, c, p, q;
+  coppersmith_t ctx;
+  long k = st->arg->k_first + i, j;
+
+  /* p mod e */
+  if (!invmod(stoi(k), e, &kinv)) {
+    stats_skip(SKIP_NOT_INVERTIBLE, 1);
+    return NULL;
+  }
+  se = Fp_add(addiu(st->modulus, 1), kinv, e);
+  disc = Fp_sub(Fp_sqr(se, e), modii(st->four_n, e), e);
+  r = Fp_sqrt(disc, e);
+  if (r == NULL) {
+    stats_skip(SKIP_NO_ROOT_MOD_E, 1);
+    return NULL;
+  }
+  roots = mkvec2(Fp_halve(Fp_add(se, r, e), e), Fp_halve(Fp_sub(se, r, e), e));
+
+  bound = d_msb_bound(st, k, &lo, &hi);
+  if (bound == NULL || !coppersmith_linear_init(&ctx, st->modulus, bound)) {
+    stats_skip(SKIP_BOUND, 1);
+    return NULL;
+  }
+  if (verb) {
+    fprintf(stderr, "[x] Test k = %ld, lattice of dimension %ld\n", k, ctx.n);
+  }
+
+  /* p = c + e*y with c = mid and c = p mod e */
+  mid = shifti(addii(lo, hi), -1);
+  for (j = 1; j <= 2; j++) {
+    c = addii(mid, Fp_sub(gel(roots, j), mid, e));
+    if (factor_p_linear(&ctx, c, e, &p, &q)) {
+      return mkvec2(p, q);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Factor the modulus from the highest bits d1 of d = d1*2^u + d0, d0 < 2^u.
+ * The public exponent must be prime.
+ */
+int factor_d_msb(GEN modulus, GEN e, GEN d1, long u, int nthreads, GEN *p, GEN *q) {
+  d_msb_arg_t da;
+  d_msb_state_t *st;
+  GEN k_approx, res, lo, hi, bound;
+  long k_first, k_last, delta, h;
+  pari_sp av = avma;
+
+  /* p mod e is found with a square root mod e */
+  if (cmpiu(e, 2) <= 0 || !isprime(e)) {
+    fprintf(stderr, "[!] The public exponent must be an odd prime\n");
+    return FALSE;
+  }
+
+  /* k = e*d1*2^u/n up to e*2^u/n + 2 */
+  k_approx = divii(shifti(mulii(e, d1), u), modulus);
+  bound = divii(shifti(e, u), modulus);
+  if (cmpis(bound, D_MSB_MAX_K) > 0) {
+    fprintf(stderr, "[!] Too many unknown bits of d: more than %ld candidates for k\n", (long)D_MSB_MAX_K);
+    avma = av;
+    return FALSE;
+  }
+  delta = itos(bound) + 2;
+  if (cmpii(k_approx, e) >= 0) {
+    fprintf(stderr, "[!] The highest bits of d give k >= e\n");
+    avma = av;
+    return FALSE;
+  }
+  /* The values of k are enumerated as words */
+  if (expi(k_approx) >= BITS_IN_LONG - 2) {
+    fprintf(stderr, "[!] The public exponent is too large: k does not fit in a word\n");
+    avma = av;
+    return FALSE;
+  }
+  k_first = itos(k_approx) - 2;
+  k_last = itos(k_approx) + delta;
+  if (k_first < 1) {
+    k_first = 1;
+  }
+  if (cmpis(e, k_last) <= 0) {
+    k_last = itos(e) - 1;
+  }
+
+  da.modulus = modulus;
+  da.e = e;
+  da.d1 = d1;
+  da.u = u;
+  da.k_first = k_first;
+
+  /* Size of the lattice for the expected k */
+  st = d_msb_init(&da);
+  bound = d_msb_bound(st, itos(k_approx) > 0 ? itos(k_approx) : 1, &lo, &hi);
+  if (bound == NULL || !coppersmith_linear_dim(modulus, bound, &h)) {
+    fprintf(stderr, "[!] Too many unknown bits of d: about 3/4 of d must be known\n");
+    avma = av;
+    return FALSE;
+  }
+  if (verb) {
+    fprintf(stderr, "[!] %ld candidates for k: %ld <= k <= %ld, lattice of dimension %ld\n",
+            k_last - k_first + 1, k_first, k_last, coppersmith_linear_dim(modulus, bound, &h));
+  }
+
+  res = parallel_range(0, k_last - k_first + 1, nthreads, d_msb_init, d_msb_run, &da, "values of k");
+  if (res == NULL) {
+    avma = av;
+    return FALSE;
+  }
+  *p = gel(res, 1);
+  *q = gel(res, 2);
+  gerepileall(av, 2, p, q);
+  return TRUE;
+}
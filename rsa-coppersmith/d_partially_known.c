@@ -5,6 +5,50 @@
 
 #include "rsa.h"
 
+/*
+ * Number of shared lsb gamma of p and q if k is correct in the equation
+ *   e*d = 1 + k*phi(n),
+ * or -1 if k is not a candidate.
+ * The other arguments are precomputed: inv2 = 1/2 mod e, n1 = n + 1,
+ * ed1 = e*d0 - 1 mod 2^u and pow2u = 2^u.
+ */
+long k_detect_gamma(GEN modulus, GEN e, GEN inv2, GEN n1, GEN ed1, GEN pow2u, long u, long k) {
+  long tk, kk, t;
+  GEN kinv, a, b, bb, pow2tk1, pow2v;
+
+  stats_iter();
+  kinv = ginvmod(stoi(k), e);
+  a = gmul(inv2, gadd(kinv, n1));
+  b = gsub(gsqr(a), modulus);
+  b = Fp_sqrt(b, e);
+  if (b == NULL) {
+    stats_skip(SKIP_NO_ROOT_MOD_E, 1);
+    return -1;
+  }
+
+  tk = z_pvalrem(k, gen_2, &kk);
+  pow2tk1 = shifti(gen_1, tk + 1);
+  pow2v = shifti(gen_1, u - tk);
+  a = gmod(gsub(gmulgs(n1, k), ed1), pow2u);
+  if (!gdvd(a, pow2tk1)) {
+    stats_skip(SKIP_PARITY, 1);
+    return -1;
+  }
+  a = shifti(a, -tk);
+  a = gmod(gmul(a, ginvmod(stoi(kk), pow2v)), pow2v);
+  b = gmod(gsub(gsqr(a), gmulgs(modulus,4)), pow2v);
+
+  if (gequal0(b)) {
+    return (u - tk + 1)/2;
+  }
+  t = Z_pvalrem(b, gen_2, &bb);
+  if (t & 1) {
+    stats_skip(SKIP_NOT_SQUARE, 1);
+    return -1;
+  }
+  return t/2;
+}
+
 /* 
  * Detect the value k in the equation
  *   e*d = 1 + k*phi(n).
@@ -13,8 +57,18 @@
  * share more than 2 of their least significant bits.
  */
 void k_detect(GEN modulus, GEN e, GEN d0, long u, long treshold) {
-  long elong, k, tk, kk, gamma, t, i, ctr = 0, k_best, gamma_best;
-  GEN kinv, inv2, a, b, bb, n1, ed1, pow2u, pow2tk1, pow2v, roots;
+  k_detect_checkpoint(modulus, e, d0, u, treshold, NULL);
+}
+
+/*
+ * Same as `k_detect`, with a checkpoint (can be NULL):
+ * the values of k already completed are skipped,
+ * and the best candidate is kept in the checkpoint.
+ */
+void k_detect_checkpoint(GEN modulus, GEN e, GEN d0, long u, long treshold, checkpoint_t *ck) {
+  long elong, k, gamma, i, ctr = 0, k_best, gamma_best;
+  long y_prec = 0;
+  GEN inv2, n1, ed1, pow2u, roots, y = NULL;
   pari_sp av = avma, start_loop;
 
   /* 
@@ -39,36 +93,22 @@ void k_detect(GEN modulus, GEN e, GEN d0, long u, long treshold) {
     /* Garbage cleaning */
     avma = start_loop;
 
-    kinv = ginvmod(stoi(k), e);
-    a = gmul(inv2, gadd(kinv, n1));
-    b = gsub(gsqr(a), modulus);
-    b = Fp_sqrt(b, e);
-    if (b == NULL) {
-      continue;
+    if (ck != NULL) {
+      k = checkpoint_skip(ck, k);
+      if (k >= elong) {
+        break;
+      }
     }
 
-    tk = z_pvalrem(k, gen_2, &kk);
-    pow2tk1 = shifti(gen_1, tk + 1);
-    pow2v = shifti(gen_1, u - tk);
-    a = gmod(gsub(gmulgs(n1, k), ed1), pow2u);
-    if (!gdvd(a, pow2tk1)) {
-      continue;
+    if (deadline_check()) {
+      deadline_progress("k", k);
+      break;
     }
-    a = shifti(a, -tk);
-    a = gmod(gmul(a, ginvmod(stoi(kk), pow2v)), pow2v);
-    b = gmod(gsub(gsqr(a), gmulgs(modulus,4)), pow2v);
 
-    if (gequal0(b)) {
-      gamma = (u - tk + 1)/2;
-    }
-    else {
-      t = Z_pvalrem(b, gen_2, &bb);
-      if (t & 1) {
-        continue;
-      }
-      gamma = t/2;
+    gamma = k_detect_gamma(modulus, e, inv2, n1, ed1, pow2u, u, k);
+    if (ck != NULL) {
+      checkpoint_done(ck, k);
     }
-    
     if (gamma < treshold) {
       continue;
     }
@@ -77,7 +117,11 @@ void k_detect(GEN modulus, GEN e, GEN d0, long u, long treshold) {
       gamma_best = gamma;
       k_best = k;
     }
-    roots = sort(sqrt_mod2(modulus, gamma));
+    if (ck != NULL) {
+      checkpoint_gamma(ck, gamma, k);
+    }
+    /* The modulus is the same for all k: reuse its inverse square root */
+    roots = sort(sqrt_mod2_incr(modulus, gamma, &y, &y_prec));
     printf("[x] k = %ld\n"
            "    Number of shared lsb: %ld\n"
            "    p mod 2^%ld is one of the four values:\n",
@@ -87,18 +131,216 @@ void k_detect(GEN modulus, GEN e, GEN d0, long u, long treshold) {
     }
   }
 
-  /* Print summary of results. */
+  /* Print summary of results, with the candidates of the previous runs */
+  if (ck != NULL) {
+    checkpoint_save(ck);
+    if (ck->gamma_best > gamma_best) {
+      gamma_best = ck->gamma_best;
+      k_best = ck->k_best;
+    }
+  }
   printf("[x] Number of k candidates: %ld\n"
          "    Highest number of lsb: %ld for k = %ld\n",
          ctr, gamma_best, k_best);
 
   /* Garbage cleaning */
+  if (y != NULL) {
+    gunclone(y);
+  }
   avma = av;
 }
 
+/*
+ * Test a candidate k for factor_d_lsb (arguments as in `k_detect_gamma`).
+ * Returns TRUE if the modulus is factored, the factors are left on the stack.
+ */
+int factor_d_lsb_k(GEN modulus, GEN e, GEN inv2, GEN n1, GEN ed1, GEN pow2u, long u, long k, long k_max,
+                   GEN *p, GEN *q) {
+  GEN kinv, a, b, bb, m, p0e, q0e, p02w, p0m, pow2tk1, pow2v, pow2w, roots;
+  long kk, tk, t, i;
+  coppersmith_t ctx;
+  int linear;
+
+  stats_iter();
+  trace_begin("filter");
+  if (verb) {
+    fprintf(stderr, "[x] Test k = %ld (max: %ld)\n", k, k_max);
+  }
+
+  /*
+   * First part:
+   * we look for p mod e and q mod e.
+   */
+
+  kinv = ginvmod(stoi(k), e);
+  a = gmul(inv2, gadd(kinv, n1));
+  b = gsub(gsqr(a), modulus);
+  b = Fp_sqrt(b, e);
+  /* We can discard a wrong candidate for k if there is no square roots. */
+  if (b == NULL) {
+    stats_skip(SKIP_NO_ROOT_MOD_E, 1);
+    trace_end();
+    if (verb) {
+      fprintf(stderr, "    -> Skipped: No candidate for p mod e.\n");
+    }
+    return FALSE;
+  }
+  p0e = gmod(gadd(a, b), e);
+  q0e = gmod(gsub(a, b), e);
+
+  /* 
+   * Second part:
+   * we look for p mod 2^w with w <= u
+   */
+
+  /* Write k = 2^tk * kk, kk odd */
+  tk = z_pvalrem(k, gen_2, &kk);
+  pow2tk1 = shifti(gen_1, tk + 1);
+  pow2v = shifti(gen_1, u - tk);
+  a = gmod(gsub(gmulgs(n1, k), ed1), pow2u);
+  /* If k is correct, then a = k*(p + q) mod 2^(u - tk) and is divisible by 2^(tk + 1) */
+  if (!gdvd(a, pow2tk1)) {
+    stats_skip(SKIP_PARITY, 1);
+    trace_end();
+    if (verb) {
+      fprintf(stderr, "    -> Skipped: Candidate for (p + q) mod 2^u not divisible by 2.\n");
+    }
+    return FALSE;
+  }
+  a = shifti(a, -tk);
+  a = gmod(gmul(a, ginvmod(stoi(kk), pow2v)), pow2v);
+  b = gmod(gsub(gsqr(a), gmulgs(modulus, 4)), pow2v);
+
+  /* 
+   * At this point, we have:
+   *   a = (p + q) mod 2^(u - tk) and
+   *   b = (p - q)^2 mod 2^(u - tk)
+   * We look for square roots of b.
+   * 
+   * If b is 0, then p and q share their (u - tk)/2 least significant bits at least.
+   * Then we are able to find p mod 2^((u - tk)/2).
+   * Successful factorization with Coppersmith means that u should be at least the size of the primes p and q.
+   * We dismiss this case, the tool `factor_shared_lsb` can be used if more than half of the bits are shared.
+   * 
+   * Otherwise, write b = 2^t*bb with bb odd.
+   * Then, if bb mod 8 = 1, we have exactly 4 roots and we can get p mod 2^(u - tk - t/2).
+   * Note that if t is odd, there are no solutions:
+   * if p = p1*2^gamma + ell and q = q1*2^gamma + ell (with ell the gamma least significants in common),
+   * then (p - q)^2 = (p1 - q1)^2 * 2^(2*gamma).
+   * So the value t reveals the number of shared least significant bits gamma = t/2.
+   */
+
+  if (gequal0(b)) {
+    stats_skip(SKIP_SHARED_LSB, 1);
+    trace_end();
+    if (verb) {
+      fprintf(stderr, "    -> Skipped: Primes might share their %ld lsb, try the factor_shared_lsb attack.\n", (u - tk)/2);
+    }
+    return FALSE;
+  }
+
+  /* b = 2^t*bb with bb odd */
+  t = Z_pvalrem(b, gen_2, &bb);
+  
+  /* If t is odd, there is no solution */
+  if (t & 1) {
+    stats_skip(SKIP_NOT_SQUARE, 1);
+    trace_end();
+    if (verb) {
+      fprintf(stderr, "    -> Skipped: Candidate for (p - q)^2 mod 2^v cannot be a square.\n");
+    }
+    return FALSE;
+  }
+  
+  /* 
+   * If modulus mod 4 = 3, we know for sure that p and q share only the least significant bit.
+   * But if modulus mod 4 = 1, they have at least the last two significants bits in common.
+   * If k is correctly guessed, then we can deduce the exact number.
+   */
+  if (verb) {
+    fprintf(stderr, "    -> If k is correct, p and q have their %ld least significant bits in common.\n", t/2);
+  }
+
+  /* Extreme case: calculating roots mod 2 or 4 is useless to run the attack. */
+  if (u - tk - t < 3) {
+    stats_skip(SKIP_SMALL_MODULUS, 1);
+    trace_end();
+    if (verb) {
+      fprintf(stderr, "    -> Skipped: Calculating roots mod 2 or mod 4 is useless.\n");
+    }
+    return FALSE;
+  }
+
+  /* We find the 4 roots of bb mod 2^(u - tk - t) */
+  roots = sqrt_mod2(bb, u - tk - t);
+  
+  /* No roots found if bb mod 8 != 1 */
+  if (roots == NULL) {
+    stats_skip(SKIP_NOT_SQUARE, 1);
+    trace_end();
+    if (verb) {
+      fprintf(stderr, "    -> Skipped: Candidate for (p - q)^2 mod 2^w cannot be a square.\n");
+    }
+    return FALSE;
+  }
+
+  /* 
+   * Now the last part.
+   * The four roots are candidates either for p mod 2^w or q mod 2^w.
+   * We combine with p mod e and q mod e using CRT.
+   * So we have in total 8 candidates for p mod (e*2^w).
+   * We apply Coppersmith method with the same lattice for the 8 candidates
+   * (`factor_p_low` if the lattice would be too large).
+   */
+
+  trace_end();
+  trace_begin("coppersmith");
+  pow2w = shifti(gen_1, u - tk - t/2);
+  m = gmul(e, pow2w);
+  linear = coppersmith_p_low_init(&ctx, modulus, m);
+  if (verb) {
+    pari_fprintf(stderr, "    -> Trying Coppersmith with p mod (%Ps*2^%ld), a %ld-bit integer.\n", e, u - tk - t/2, logint(m, gen_2) + 1);
+    if (linear) {
+      fprintf(stderr, "    -> Lattice of dimension %ld (multiplicity %ld).\n", ctx.n, ctx.h);
+    }
+  }
+ 
+  for(i = 1; i <= 4; i++) {
+    b = shifti(gel(roots, i), t/2);
+    /* Here, (a + b)/2 is a candidate for p mod 2^(u - tk - t/2) */
+    p02w = gmod(shifti(gadd(a, b), -1), pow2w);
+
+    /* We combine with p mod e */
+    p0m = Z_chinese(p0e, p02w, e, pow2w);
+    if (linear ? factor_p_linear(&ctx, p0m, m, p, q) : factor_p_low(modulus, p0m, m, p, q)) {
+      trace_end();
+      return TRUE;
+    }
+    
+    /* Second try with q mod e */
+    p0m = Z_chinese(q0e, p02w, e, pow2w);
+    if (linear ? factor_p_linear(&ctx, p0m, m, p, q) : factor_p_low(modulus, p0m, m, p, q)) {
+      trace_end();
+      return TRUE;
+    }
+  }
+
+  trace_end();
+  return FALSE;
+}
+
 int factor_d_lsb(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end, GEN *p, GEN *q) {
-  GEN kinv, inv2, a, b, bb, m, n1, p0e, q0e, p02w, p0m, ed1, pow2u, pow2tk1, pow2v, pow2w, roots;
-  long k, kk, tk, t, i;
+  return factor_d_lsb_checkpoint(modulus, e, d0, u, k_start, k_end, NULL, p, q);
+}
+
+/*
+ * Same as `factor_d_lsb`, with a checkpoint (can be NULL):
+ * the values of k already completed are skipped, and the progress is saved.
+ */
+int factor_d_lsb_checkpoint(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end,
+                            checkpoint_t *ck, GEN *p, GEN *q) {
+  GEN inv2, n1, ed1, pow2u;
+  long k, k0;
   int found = FALSE;
   pari_sp av = avma, start_loop;
 
@@ -130,151 +372,34 @@ int factor_d_lsb(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end, G
     /* Garbage cleaning */
     avma = start_loop;
 
-    if (verb) {
-      fprintf(stderr, "[x] Test k = %ld (max: %ld)\n", k, k_end - 1);
-    }
-
-    /*
-     * First part:
-     * we look for p mod e and q mod e.
-     */
-
-    kinv = ginvmod(stoi(k), e);
-    a = gmul(inv2, gadd(kinv, n1));
-    b = gsub(gsqr(a), modulus);
-    b = Fp_sqrt(b, e);
-    /* We can discard a wrong candidate for k if there is no square roots. */
-    if (b == NULL) {
-      if (verb) {
-        fprintf(stderr, "    -> Skipped: No candidate for p mod e.\n");
+    if (ck != NULL) {
+      k0 = k;
+      k = checkpoint_skip(ck, k);
+      stats_skip(SKIP_CHECKPOINT, (k < k_end ? k : k_end) - k0);
+      if (k >= k_end) {
+        break;
       }
-      continue;
-    }
-    p0e = gmod(gadd(a, b), e);
-    q0e = gmod(gsub(a, b), e);
-
-    /* 
-     * Second part:
-     * we look for p mod 2^w with w <= u
-     */
-
-    /* Write k = 2^tk * kk, kk odd */
-    tk = z_pvalrem(k, gen_2, &kk);
-    pow2tk1 = shifti(gen_1, tk + 1);
-    pow2v = shifti(gen_1, u - tk);
-    a = gmod(gsub(gmulgs(n1, k), ed1), pow2u);
-    /* If k is correct, then a = k*(p + q) mod 2^(u - tk) and is divisible by 2^(tk + 1) */
-    if (!gdvd(a, pow2tk1)) {
-      if (verb) {
-        fprintf(stderr, "    -> Skipped: Candidate for (p + q) mod 2^u not divisible by 2.\n");
-      }
-      continue;
-    }
-    a = shifti(a, -tk);
-    a = gmod(gmul(a, ginvmod(stoi(kk), pow2v)), pow2v);
-    b = gmod(gsub(gsqr(a), gmulgs(modulus, 4)), pow2v);
-
-    /* 
-     * At this point, we have:
-     *   a = (p + q) mod 2^(u - tk) and
-     *   b = (p - q)^2 mod 2^(u - tk)
-     * We look for square roots of b.
-     * 
-     * If b is 0, then p and q share their (u - tk)/2 least significant bits at least.
-     * Then we are able to find p mod 2^((u - tk)/2).
-     * Successful factorization with Coppersmith means that u should be at least the size of the primes p and q.
-     * We dismiss this case, the tool `factor_shared_lsb` can be used if more than half of the bits are shared.
-     * 
-     * Otherwise, write b = 2^t*bb with bb odd.
-     * Then, if bb mod 8 = 1, we have exactly 4 roots and we can get p mod 2^(u - tk - t/2).
-     * Note that if t is odd, there are no solutions:
-     * if p = p1*2^gamma + ell and q = q1*2^gamma + ell (with ell the gamma least significants in common),
-     * then (p - q)^2 = (p1 - q1)^2 * 2^(2*gamma).
-     * So the value t reveals the number of shared least significant bits gamma = t/2.
-     */
-
-    if (gequal0(b)) {
-      if (verb) {
-        fprintf(stderr, "    -> Skipped: Primes might share their %ld lsb, try the factor_shared_lsb attack.\n", (u - tk)/2);
-      }
-      continue;
     }
 
-    /* b = 2^t*bb with bb odd */
-    t = Z_pvalrem(b, gen_2, &bb);
-    
-    /* If t is odd, there is no solution */
-    if (t & 1) {
-      if (verb) {
-        fprintf(stderr, "    -> Skipped: Candidate for (p - q)^2 mod 2^v cannot be a square.\n");
-      }
-      continue;
-    }
-    
-    /* 
-     * If modulus mod 4 = 3, we know for sure that p and q share only the least significant bit.
-     * But if modulus mod 4 = 1, they have at least the last two significants bits in common.
-     * If k is correctly guessed, then we can deduce the exact number.
-     */
-    if (verb) {
-      fprintf(stderr, "    -> If k is correct, p and q have their %ld least significant bits in common.\n", t/2);
+    /* Cancellation point, the scan can be resumed from k with `--kstart` */
+    if (deadline_check()) {
+      deadline_progress("k", k);
+      break;
     }
 
-    /* Extreme case: calculating roots mod 2 or 4 is useless to run the attack. */
-    if (u - tk - t < 3) {
-      if (verb) {
-        fprintf(stderr, "    -> Skipped: Calculating roots mod 2 or mod 4 is useless.\n");
-      }
-      continue;
+    found = factor_d_lsb_k(modulus, e, inv2, n1, ed1, pow2u, u, k, k_end - 1, p, q);
+    if (found) {
+      break;
     }
-
-    /* We find the 4 roots of bb mod 2^(u - tk - t) */
-    roots = sqrt_mod2(bb, u - tk - t);
-    
-    /* No roots found if bb mod 8 != 1 */
-    if (roots == NULL) {
-      if (verb) {
-        fprintf(stderr, "    -> Skipped: Candidate for (p - q)^2 mod 2^w cannot be a square.\n");
-      }
-      continue;
+    if (ck != NULL) {
+      checkpoint_done(ck, k);
     }
+  }
 
-    /* 
-     * Now the last part.
-     * The four roots are candidates either for p mod 2^w or q mod 2^w.
-     * We combine with p mod e and q mod e using CRT.
-     * So we have in total 8 candidates for p mod (e*2^w).
-     * We use the function `factor_p_low` to apply Coppersmith method.
-     */
-
-    pow2w = shifti(gen_1, u - tk - t/2);
-    m = gmul(e, pow2w);
-    if (verb) {
-      pari_fprintf(stderr, "    -> Trying Coppersmith with p mod (%Ps*2^%ld), a %ld-bit integer.\n", e, u - tk - t/2, logint(m, gen_2) + 1);
-    }
-   
-    for(i = 1; i <= 4; i++) {
-      b = shifti(gel(roots, i), t/2);
-      /* Here, (a + b)/2 is a candidate for p mod 2^(u - tk - t/2) */
-      p02w = gmod(shifti(gadd(a, b), -1), pow2w);
-
-      /* We combine with p mod e */
-      p0m = Z_chinese(p0e, p02w, e, pow2w);
-      found = factor_p_low(modulus, p0m, gmul(e, pow2w), p, q);
-      if (found) {
-        goto end;
-      }
-      
-      /* Second try with q mod e */
-      p0m = Z_chinese(q0e, p02w, e, pow2w);
-      found = factor_p_low(modulus, p0m, gmul(e, pow2w), p, q);
-      if (found) {
-        goto end;
-      }
-    }
+  if (ck != NULL) {
+    checkpoint_save(ck);
   }
 
-end:
   /* Garbage cleaning */
   if (found) {
     gerepileall(av, 2, p, q);
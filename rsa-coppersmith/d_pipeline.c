@@ -0,0 +1,279 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Two-stage scan over k for the partial key exposure attack on the lsb of d.
+ * Stage 1 (the calling thread) runs the cheap filter of `k_detect` on each k,
+ * and pushes the surviving values in a priority queue ranked by the number
+ * of shared lsb gamma: the larger gamma, the more bits of p are known
+ * and the more likely k is correct.
+ * Stage 2 (worker threads) pulls the best candidates first and runs the
+ * Coppersmith method on them while stage 1 is still producing.
+ * The first success stops both stages.
+ */
+
+typedef struct {
+  long gamma, k;
+} k_cand_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  k_cand_t *heap;             /* max-heap on (gamma, -k) */
+  long size, cap;
+  int producing;              /* stage 1 is still running */
+  int stop;                   /* success or deadline, stop both stages */
+  GENbin *factors;            /* [p, q] found by a worker */
+  long tested;
+  rsa_ctx_t *ctx;
+  double deadline;
+  stats_t *stats;
+  GEN modulus, e, inv2, n1, ed1, pow2u;
+  long u, k_max;
+} pipeline_t;
+
+struct pipeline_worker_s {
+  pipeline_t *pl;
+  struct pari_thread pth;
+  pthread_t tid;
+};
+
+static int cand_better(const k_cand_t *a, const k_cand_t *b) {
+  return a->gamma > b->gamma || (a->gamma == b->gamma && a->k < b->k);
+}
+
+static void heap_push(pipeline_t *pl, long gamma, long k) {
+  k_cand_t c = {gamma, k}, tmp;
+  long i, parent;
+
+  if (pl->size == pl->cap) {
+    pl->cap = pl->cap ? 2*pl->cap : 1024;
+    pl->heap = realloc(pl->heap, pl->cap*sizeof(k_cand_t));
+  }
+  i = pl->size++;
+  pl->heap[i] = c;
+  while (i > 0) {
+    parent = (i - 1)/2;
+    if (!cand_better(&pl->heap[i], &pl->heap[parent])) {
+      break;
+    }
+    tmp = pl->heap[i];
+    pl->heap[i] = pl->heap[parent];
+    pl->heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+static k_cand_t heap_pop(pipeline_t *pl) {
+  k_cand_t top = pl->heap[0], tmp;
+  long i = 0, child;
+
+  pl->heap[0] = pl->heap[--pl->size];
+  for (;;) {
+    child = 2*i + 1;
+    if (child >= pl->size) {
+      break;
+    }
+    if (child + 1 < pl->size && cand_better(&pl->heap[child + 1], &pl->heap[child])) {
+      child++;
+    }
+    if (!cand_better(&pl->heap[child], &pl->heap[i])) {
+      break;
+    }
+    tmp = pl->heap[i];
+    pl->heap[i] = pl->heap[child];
+    pl->heap[child] = tmp;
+    i = child;
+  }
+  return top;
+}
+
+/* Best candidate, FALSE when the scan is over */
+static int next_cand(pipeline_t *pl, k_cand_t *c) {
+  int ok;
+
+  pthread_mutex_lock(&pl->lock);
+  while (pl->size == 0 && pl->producing && !pl->stop) {
+    pthread_cond_wait(&pl->not_empty, &pl->lock);
+  }
+  ok = pl->size > 0 && !pl->stop;
+  if (ok) {
+    *c = heap_pop(pl);
+    pl->tested++;
+  }
+  pthread_mutex_unlock(&pl->lock);
+
+  return ok;
+}
+
+static void stop_all(pipeline_t *pl) {
+  pthread_mutex_lock(&pl->lock);
+  pl->stop = TRUE;
+  pthread_cond_broadcast(&pl->not_empty);
+  pthread_mutex_unlock(&pl->lock);
+}
+
+static void *pipeline_worker(void *arg) {
+  struct pipeline_worker_s *wk = arg;
+  pipeline_t *pl = wk->pl;
+  GEN modulus, e, inv2, n1, ed1, pow2u, p, q;
+  k_cand_t c;
+  pari_sp av;
+
+  pari_thread_start(&wk->pth);
+  rsa_ctx_attach(pl->ctx);
+  deadline_start(pl->deadline);
+  stats_attach(pl->stats);
+  trace_thread("worker");
+
+  /* Own copies of the parameters, the main stack is not touched by the workers */
+  modulus = gcopy(pl->modulus);
+  e = gcopy(pl->e);
+  inv2 = gcopy(pl->inv2);
+  n1 = gcopy(pl->n1);
+  ed1 = gcopy(pl->ed1);
+  pow2u = gcopy(pl->pow2u);
+
+  av = avma;
+  while (next_cand(pl, &c)) {
+    if (deadline_check()) {
+      stop_all(pl);
+      break;
+    }
+    if (verb) {
+      fprintf(stderr, "[x] Stage 2: k = %ld with %ld shared lsb\n", c.k, c.gamma);
+    }
+    if (factor_d_lsb_k(modulus, e, inv2, n1, ed1, pow2u, pl->u, c.k, pl->k_max, &p, &q)) {
+      pthread_mutex_lock(&pl->lock);
+      if (pl->factors == NULL) {
+        pl->factors = copy_bin(mkvec2(p, q));
+      }
+      pthread_mutex_unlock(&pl->lock);
+      stop_all(pl);
+      break;
+    }
+    avma = av;
+  }
+
+  trace_thread_end();
+  pari_thread_close();
+  return NULL;
+}
+
+/*
+ * Same as `factor_d_lsb`, with the values of k filtered by `k_detect_gamma`
+ * and tested by nthreads workers, best candidates first.
+ */
+int factor_d_lsb_pipeline(GEN modulus, GEN e, GEN d0, long u, long k_start, long k_end, int nthreads,
+                          GEN *p, GEN *q) {
+  pipeline_t pl;
+  struct pipeline_worker_s *workers;
+  GEN res;
+  long k, gamma, ctr = 0;
+  int i, n, found = FALSE;
+  pari_sp av = avma, start_loop;
+
+  if (k_start < 1 || k_start >= gtolong(e)) {
+    k_start = 1;
+  }
+  if (k_end < 2 || k_end > gtolong(e)) {
+    k_end = gtolong(e);
+  }
+  if (k_end <= k_start) {
+    k_end = k_start + 1;
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+
+  memset(&pl, 0, sizeof(pl));
+  pthread_mutex_init(&pl.lock, NULL);
+  pthread_cond_init(&pl.not_empty, NULL);
+  pl.producing = TRUE;
+  pl.ctx = rsa_ctx_get();
+  pl.deadline = deadline_get();
+  pl.stats = stats_get();
+  pl.modulus = modulus;
+  pl.e = e;
+  pl.u = u;
+  pl.k_max = k_end - 1;
+  pl.pow2u = shifti(gen_1, u);
+  pl.ed1 = gmod(gsub(gmul(e, d0), gen_1), pl.pow2u);
+  pl.inv2 = ginvmod(gen_2, e);
+  pl.n1 = gadd(modulus, gen_1);
+
+  workers = calloc(nthreads, sizeof(struct pipeline_worker_s));
+  for (n = 0; n < nthreads; n++) {
+    workers[n].pl = &pl;
+    stack_thread_alloc(&workers[n].pth, WORKER_PARISIZE_LATTICE);
+    if (pthread_create(&workers[n].tid, NULL, pipeline_worker, &workers[n])) {
+      pari_thread_free(&workers[n].pth);
+      break;
+    }
+  }
+  if (n == 0) {
+    fprintf(stderr, "[!] Cannot start the workers of the pipeline\n");
+    pl.producing = FALSE;
+  }
+
+  /* Stage 1 */
+  start_loop = avma;
+  trace_begin("stage1");
+  for (k = k_start; n > 0 && k < k_end && !pl.stop; k++) {
+    /* Garbage cleaning */
+    avma = start_loop;
+
+    if (deadline_check()) {
+      deadline_progress("k", k);
+      stop_all(&pl);
+      break;
+    }
+
+    gamma = k_detect_gamma(modulus, e, pl.inv2, pl.n1, pl.ed1, pl.pow2u, u, k);
+    if (gamma < 0) {
+      continue;
+    }
+    ctr++;
+    pthread_mutex_lock(&pl.lock);
+    heap_push(&pl, gamma, k);
+    pthread_cond_signal(&pl.not_empty);
+    pthread_mutex_unlock(&pl.lock);
+  }
+  avma = start_loop;
+  trace_end();
+
+  pthread_mutex_lock(&pl.lock);
+  pl.producing = FALSE;
+  pthread_cond_broadcast(&pl.not_empty);
+  pthread_mutex_unlock(&pl.lock);
+  if (verb) {
+    fprintf(stderr, "[x] Stage 1 over: %ld candidates for k in [%ld, %ld)\n", ctr, k_start, k);
+  }
+
+  for (i = 0; i < n; i++) {
+    pthread_join(workers[i].tid, NULL);
+    pari_thread_free(&workers[i].pth);
+  }
+  if (verb) {
+    fprintf(stderr, "[x] Stage 2 over: %ld candidates tested\n", pl.tested);
+  }
+
+  avma = av;
+  if (pl.factors != NULL) {
+    res = bin_copy(pl.factors);
+    *p = gel(res, 1);
+    *q = gel(res, 2);
+    found = TRUE;
+  }
+
+  free(workers);
+  free(pl.heap);
+  pthread_cond_destroy(&pl.not_empty);
+  pthread_mutex_destroy(&pl.lock);
+
+  return found;
+}
@@ -0,0 +1,219 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Partial key exposure on the CRT exponent dp = d mod (p - 1).
+ * There exists an integer k_p with 1 <= k_p < e such that
+ *   e*dp = 1 + k_p*(p - 1),
+ * so for each k_p:
+ *   - p = 1 - 1/k_p mod e,
+ *   - if the lowest ell bits of dp are known, k_p*p = e*dp - 1 + k_p mod 2^ell
+ *     gives p mod 2^(ell - t) with 2^t the power of 2 dividing k_p,
+ *   - if the highest bits dp1 of dp = dp1*2^ell + dp0 are known,
+ *     p - 1 = (e*dp - 1)/k_p is known up to e*2^ell/k_p.
+ * Both are combined into a single candidate for Coppersmith method.
+ * The values of k_p are split between worker threads (see `parallel_range`),
+ * and the lattices are built once per worker for each size of the unknown part.
+ */
+
+typedef struct {
+  GEN modulus, e, dp;
+  long ell;
+  int msb;
+} dp_arg_t;
+
+typedef struct {
+  const dp_arg_t *arg;
+  GEN modulus, e, pow2ell;
+  GEN ed1;                    /* e*dp0 - 1 (lsb) or e*dp1*2^ell - 1 (msb) */
+  long prime_len;
+  coppersmith_t *ctx;         /* by 2-adic valuation of k_p (lsb) or size of the bound (msb) */
+  int *ctx_ok;
+  long nctx;
+} dp_state_t;
+
+static void *dp_init(void *arg) {
+  dp_arg_t *da = arg;
+  dp_state_t *st = (dp_state_t *)stack_malloc(sizeof(dp_state_t));
+  GEN m, X;
+  long i;
+
+  st->arg = da;
+  st->modulus = gcopy(da->modulus);
+  st->e = gcopy(da->e);
+  st->pow2ell = int2n(da->ell);
+  st->prime_len = (logint(st->modulus, gen_2) + 1)/2;
+
+  if (da->msb) {
+    /* Bound 2^i on the unknown part, for i <= ell + 1 */
+    st->ed1 = subiu(mulii(mulii(st->e, da->dp), st->pow2ell), 1);
+    st->nctx = da->ell + 2;
+  }
+  else {
+    st->ed1 = subiu(mulii(st->e, da->dp), 1);
+    st->nctx = DP_LSB_MAX_VAL + 1;
+  }
+  st->ctx = (coppersmith_t *)stack_malloc(st->nctx*sizeof(coppersmith_t));
+  st->ctx_ok = (int *)stack_malloc(st->nctx*sizeof(int));
+  for (i = 0; i < st->nctx; i++) {
+    if (da->msb && i + expi(st->e) + 1 < da->ell) {
+      /* 2^ell/k_p > 2^ell/e */
+      st->ctx_ok[i] = FALSE;
+      continue;
+    }
+    else if (da->msb) {
+      X = int2n(i);
+    }
+    else if (da->ell - i < 1) {
+      st->ctx_ok[i] = FALSE;
+      continue;
+    }
+    else {
+      m = mulii(st->e, int2n(da->ell - i));
+      X = addiu(divii(int2n(st->prime_len), m), 1);
+    }
+    st->ctx_ok[i] = coppersmith_linear_init(&st->ctx[i], st->modulus, X);
+  }
+  return st;
+}
+
+/* Candidate p mod e, NULL if k_p is not invertible or p = 0 mod e */
+static GEN dp_p_mod_e(const dp_state_t *st, GEN kp) {
+  GEN kinv, pe;
+
+  if (!invmod(kp, st->e, &kinv)) {
+    stats_skip(SKIP_NOT_INVERTIBLE, 1);
+    return NULL;
+  }
+  pe = Fp_sub(gen_1, kinv, st->e);
+  return signe(pe) ? pe : NULL;
+}
+
+static GEN dp_lsb_run(long k, void *state) {
+  dp_state_t *st = state;
+  GEN kp = stoi(k), a, pe, p2, pow2w, p0m, m, p, q;
+  long t, kk, w;
+  int found;
+
+  pe = dp_p_mod_e(st, kp);
+  if (pe == NULL) {
+    return NULL;
+  }
+
+  /* k_p = 2^t*kk: k_p*p = e*dp0 - 1 + k_p mod 2^ell must be divisible by 2^t */
+  t = vals(k);
+  kk = k >> t;
+  w = st->arg->ell - t;
+  if (w < 1) {
+    stats_skip(SKIP_BOUND, 1);
+    return NULL;
+  }
+  a = remi2n(addis(st->ed1, k), st->arg->ell);
+  if (signe(a) && vali(a) < t) {
+    stats_skip(SKIP_PARITY, 1);
+    return NULL;
+  }
+  pow2w = int2n(w);
+  p2 = Fp_mul(shifti(a, -t), Fp_inv(stoi(kk), pow2w), pow2w);
+  /* p is odd */
+  if (!mpodd(p2)) {
+    stats_skip(SKIP_PARITY, 1);
+    return NULL;
+  }
+
+  p0m = Z_chinese(pe, p2, st->e, pow2w);
+  m = mulii(st->e, pow2w);
+  if (t < st->nctx && st->ctx_ok[t]) {
+    found = factor_p_linear(&st->ctx[t], p0m, m, &p, &q);
+  }
+  else {
+    found = factor_p_low(st->modulus, p0m, m, &p, &q);
+  }
+  return found ? mkvec2(p, q) : NULL;
+}
+
+static GEN dp_msb_run(long k, void *state) {
+  dp_state_t *st = state;
+  GEN kp = stoi(k), pe, lo, p0, bound, p, q;
+  long b;
+
+  pe = dp_p_mod_e(st, kp);
+  if (pe == NULL) {
+    return NULL;
+  }
+
+  /* p >= lo = (e*dp1*2^ell - 1)/k_p + 1, and p = pe mod e */
+  lo = addiu(divis(st->ed1, k), 1);
+  p0 = addii(lo, Fp_sub(pe, lo, st->e));
+  /* Balanced primes */
+  if (labs(expi(p0) + 1 - st->prime_len) > 2) {
+    stats_skip(SKIP_BOUND, 1);
+    return NULL;
+  }
+
+  /* p = p0 + e*y with 0 <= y <= 2^ell/k_p + 1 */
+  bound = addiu(divis(st->pow2ell, k), 1);
+  b = expi(bound) + 1;
+  if (b >= st->nctx || !st->ctx_ok[b]) {
+    stats_skip(SKIP_BOUND, 1);
+    return NULL;
+  }
+  return factor_p_linear(&st->ctx[b], p0, st->e, &p, &q) ? mkvec2(p, q) : NULL;
+}
+
+static int dp_scan(dp_arg_t *da, long k_start, long k_end, int nthreads, GEN *p, GEN *q) {
+  GEN res;
+  long e;
+  pari_sp av = avma;
+
+  /* k_p < e is enumerated as a word */
+  if (signe(da->e) <= 0 || expi(da->e) >= BITS_IN_LONG - 2) {
+    fprintf(stderr, "[!] The public exponent must be positive and less than 2^%d to scan k_p\n", BITS_IN_LONG - 2);
+    return FALSE;
+  }
+  e = itos(da->e);
+
+  if (k_start < 1 || k_start >= e) {
+    k_start = 1;
+  }
+  if (k_end < 2 || k_end > e) {
+    k_end = e;
+  }
+  if (k_end <= k_start) {
+    k_end = k_start + 1;
+  }
+  if (verb) {
+    fprintf(stderr, "[!] Scan of %ld <= k_p < %ld with %d threads\n", k_start, k_end, nthreads);
+  }
+
+  res = parallel_range(k_start, k_end, nthreads, dp_init, da->msb ? dp_msb_run : dp_lsb_run, da,
+                       "values of k_p");
+  if (res == NULL) {
+    avma = av;
+    return FALSE;
+  }
+  *p = gel(res, 1);
+  *q = gel(res, 2);
+  gerepileall(av, 2, p, q);
+  return TRUE;
+}
+
+/* Factor the modulus from the lowest u bits dp0 of dp */
+int factor_dp_lsb(GEN modulus, GEN e, GEN dp0, long u, long k_start, long k_end, int nthreads,
+                  GEN *p, GEN *q) {
+  dp_arg_t da = {modulus, e, dp0, u, FALSE};
+
+  return dp_scan(&da, k_start, k_end, nthreads, p, q);
+}
+
+/* Factor the modulus from the highest bits dp1 of dp = dp1*2^u + dp0 */
+int factor_dp_msb(GEN modulus, GEN e, GEN dp1, long u, long k_start, long k_end, int nthreads,
+                  GEN *p, GEN *q) {
+  dp_arg_t da = {modulus, e, dp1, u, TRUE};
+
+  return dp_scan(&da, k_start, k_end, nthreads, p, q);
+}
@@ -0,0 +1,171 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <math.h>
+#include "rsa.h"
+
+/*
+ * Prime factor known on an arbitrary set of bits (mask),
+ * e.g. a side-channel leak with a few unknown or unreliable bits.
+ * A window of the bits of p is chosen, either the lowest L bits (`factor_p_low`)
+ * or the bits above the s lowest ones (`factor_p_hi`), and the r unknown
+ * bits of the window are guessed: the 2^r assignments are split between
+ * worker threads, each of them running Coppersmith method with its own lattice.
+ * The window minimizes 2^r times the cost of the lattice reduction.
+ */
+
+typedef struct {
+  GEN modulus;
+  GEN base;                   /* known bits of the window */
+  long *pos;                  /* positions of the r unknown bits of the window */
+  long r;
+  long shift;                 /* L for the lowest bits, s for the highest bits */
+  int hi;
+} mask_arg_t;
+
+typedef struct {
+  const mask_arg_t *arg;
+  GEN modulus, base, m;
+  coppersmith_t ctx;
+} mask_state_t;
+
+static void *mask_init(void *arg) {
+  mask_arg_t *ma = arg;
+  mask_state_t *st = (mask_state_t *)stack_malloc(sizeof(mask_state_t));
+
+  st->arg = ma;
+  st->modulus = gcopy(ma->modulus);
+  st->base = gcopy(ma->base);
+  if (ma->hi) {
+    st->m = gen_1;
+    coppersmith_linear_init(&st->ctx, st->modulus, int2n(ma->shift));
+  }
+  else {
+    st->m = int2n(ma->shift);
+    coppersmith_p_low_init(&st->ctx, st->modulus, st->m);
+  }
+  return st;
+}
+
+/* Assignment i of the unknown bits */
+static GEN mask_run(long i, void *state) {
+  mask_state_t *st = state;
+  GEN v = st->base, p, q;
+  long j;
+
+  for (j = 0; j < st->arg->r; j++) {
+    if (i >> j & 1) {
+      v = addii(v, int2n(st->arg->pos[j]));
+    }
+  }
+  if (factor_p_linear(&st->ctx, v, st->m, &p, &q)) {
+    return mkvec2(p, q);
+  }
+  return NULL;
+}
+
+/* Number of bits in [start, end) missing from the mask */
+static long missing_bits(GEN mask, long start, long end) {
+  long i, r = 0;
+
+  for (i = start; i < end; i++) {
+    r += !int_bit(mask, i);
+  }
+  return r;
+}
+
+/* Cost of a window: 2^r lattice reductions of dimension n, in units of n^4 */
+static double window_cost(long r, long n) {
+  return ldexp((double)n*n*n*n, r);
+}
+
+/*
+ * Factor the modulus if the bits of p given by mask are those of bits.
+ * The bits outside the chosen window are not used.
+ */
+int factor_p_mask(GEN modulus, GEN bits, GEN mask, int nthreads, GEN *p, GEN *q) {
+  mask_arg_t ma;
+  GEN res;
+  long prime_len, w, r, n, h, i, best_r = -1, best_w = 0;
+  double cost, best_cost = 0;
+  int best_hi = FALSE, hi;
+  pari_sp av = avma;
+
+  prime_len = (logint(modulus, gen_2) + 1)/2;
+
+  /* Lowest L = w bits, or the bits above the s = w lowest ones */
+  for (hi = FALSE; hi <= TRUE; hi++) {
+    for (w = 1; w < prime_len; w++) {
+      n = hi ? coppersmith_linear_dim(modulus, int2n(w), &h)
+             : coppersmith_linear_dim(modulus, addiu(int2n(prime_len - w), 1), &h);
+      if (n == 0) {
+        continue;
+      }
+      r = hi ? missing_bits(mask, w, prime_len) : missing_bits(mask, 0, w);
+      if (r > MASK_MAX_MISSING) {
+        continue;
+      }
+      cost = window_cost(r, n);
+      if (best_r < 0 || cost < best_cost) {
+        best_cost = cost;
+        best_r = r;
+        best_w = w;
+        best_hi = hi;
+      }
+    }
+    avma = av;
+  }
+
+  if (best_r < 0) {
+    fprintf(stderr, "[!] Not enough known bits: no window with at most %d unknown bits\n", MASK_MAX_MISSING);
+    return FALSE;
+  }
+
+  ma.modulus = modulus;
+  ma.hi = best_hi;
+  ma.shift = best_w;
+  ma.r = best_r;
+  ma.pos = malloc((best_r + 1)*sizeof(long));
+  if (best_hi) {
+    ma.base = shifti(shifti(bits, -best_w), best_w);
+    for (i = best_w, r = 0; i < prime_len; i++) {
+      if (!int_bit(mask, i)) {
+        ma.pos[r++] = i;
+      }
+    }
+  }
+  else {
+    ma.base = remi2n(bits, best_w);
+    for (i = 0, r = 0; i < best_w; i++) {
+      if (!int_bit(mask, i)) {
+        ma.pos[r++] = i;
+      }
+    }
+  }
+  /* Unknown bits of the window are guessed from 0 */
+  for (i = 0; i < r; i++) {
+    if (int_bit(ma.base, ma.pos[i])) {
+      ma.base = subii(ma.base, int2n(ma.pos[i]));
+    }
+  }
+
+  if (verb) {
+    n = coppersmith_linear_dim(modulus, best_hi ? int2n(best_w) : addiu(int2n(prime_len - best_w), 1), &h);
+    fprintf(stderr, "[!] Window: %s %ld bits of p, %ld unknown bits, lattice of dimension %ld\n",
+            best_hi ? "highest" : "lowest", best_hi ? prime_len - best_w : best_w, best_r, n);
+  }
+
+  res = parallel_range(0, 1L << best_r, nthreads, mask_init, mask_run, &ma, "guesses");
+  free(ma.pos);
+
+  if (res == NULL) {
+    avma = av;
+    return FALSE;
+  }
+  *p = gel(res, 1);
+  *q = gel(res, 2);
+  gerepileall(av, 2, p, q);
+  return TRUE;
+}
@@ -14,13 +14,28 @@ int factor_p_hi(GEN modulus, GEN p1, GEN m, GEN *p, GEN *q) {
   GEN pol, res, B, p1m;
   long nbsol, i;
   int found = FALSE;
+  coppersmith_t ctx;
   pari_sp av = avma;
 
   /* Construct pol = x + p1*m and apply Coppersmith */
   p1m = gmul(p1, m);
   B = powuu(2, logint(modulus, gen_2)/2);
+
+  /* Dedicated lattice for the linear case, unless p0 is too close to the bound */
+  if (coppersmith_linear_init(&ctx, modulus, m)) {
+    found = factor_p_linear(&ctx, p1m, gen_1, p, q);
+    if (found) {
+      gerepileall(av, 2, p, q);
+    }
+    else {
+      avma = av;
+    }
+    return found;
+  }
+
   pol = deg1pol(gen_1, p1m, 0);
   res = zncoppersmith(pol, modulus, m, B);
+  stats_coppersmith();
 
   /* Reconstruct the primes from the small roots */
   nbsol = lg(res) - 1;
@@ -53,14 +68,28 @@ int factor_p_low(GEN modulus, GEN p0, GEN m, GEN *p, GEN *q) {
   GEN pol, res, X, B;
   long nbsol, i, prime_len;
   int found = FALSE;
+  coppersmith_t ctx;
   pari_sp av = avma;
 
+  /* Dedicated lattice for the linear case, unless p1 is too close to the bound */
+  if (coppersmith_p_low_init(&ctx, modulus, m)) {
+    found = factor_p_linear(&ctx, p0, m, p, q);
+    if (found) {
+      gerepileall(av, 2, p, q);
+    }
+    else {
+      avma = av;
+    }
+    return found;
+  }
+
   /* Construct pol = x*m + p0 */
   prime_len = (logint(modulus, gen_2) + 1)/2;
   X = gdiv(powuu(2, prime_len), m);
   B = powuu(2, prime_len - 1);
   pol = deg1pol(m, p0, 0);
   res = zncoppersmith(pol, modulus, X, B);
+  stats_coppersmith();
 
   /* Reconstruc the primes from the small roots */
   nbsol = lg(res) - 1;
@@ -83,3 +112,13 @@ int factor_p_low(GEN modulus, GEN p0, GEN m, GEN *p, GEN *q) {
 
   return found;
 }
+
+/*
+ * Context of `factor_p_linear` for p = p1*m + p0 with p0 known,
+ * to be shared by the calls with the same m.
+ */
+int coppersmith_p_low_init(coppersmith_t *ctx, GEN modulus, GEN m) {
+  long prime_len = (logint(modulus, gen_2) + 1)/2;
+
+  return coppersmith_linear_init(ctx, modulus, addiu(divii(int2n(prime_len), m), 1));
+}
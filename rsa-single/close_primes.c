@@ -6,16 +6,23 @@
 #include "rsa.h"
 
 int factor_close_primes(GEN modulus, GEN *p, GEN *q, const int max) {
-  int i, found = FALSE;
+  return factor_close_primes_range(modulus, p, q, 0, max);
+}
+
+/* Same as `factor_close_primes` with start <= k < max */
+int factor_close_primes_range(GEN modulus, GEN *p, GEN *q, long start, long max) {
+  long i;
+  int found = FALSE;
   pari_sp av = avma;
 
   if (verb) {
-    fprintf(stderr, "    x = floor(sqrt(n)) and checks if (x + k)^2 - n is a square with 0 <= k < %d\n"
-                    "    Maximal value for k can be increased with the `--fermat-bound` option\n", max);
+    fprintf(stderr, "    x = floor(sqrt(n)) and checks if (x + k)^2 - n is a square with %ld <= k < %ld\n"
+                    "    Maximal value for k can be increased with the `--fermat-bound` option\n", start, max);
   }
 
-  *p = sqrti(modulus);
-  for(i = 0; i < max; i++) {
+  *p = addis(sqrti(modulus), start);
+  for(i = start; i < max; i++) {
+    stats_iter();
     *q = gsqr(*p);
     *q = gsub(*q, modulus);
     if (Z_issquareall(*q, q)) {
@@ -26,7 +33,12 @@ int factor_close_primes(GEN modulus, GEN *p, GEN *q, const int max) {
       break;
     }
     *p = gadd(*p, gen_1);
-    
+
+    /* Cancellation point: k = i + 1 is the next value to test */
+    if (deadline_check()) {
+      deadline_progress("Fermat offset k", i + 1);
+      break;
+    }
     if (gc_needed(av, 1)) {
       gerepileall(av, 2, p, q);
     }
@@ -20,15 +20,21 @@ int factor_cm_anomalous_core(GEN modulus, long disc_i, GEN *p, GEN *q) {
    * Step 1:
    * We construct the ring R = (Z/nZ)[x]/H_j(x)
    */
-  H = polclass(disc, 0, -1);  /* Hilbert polynomial */
+  trace_begin("polclass");
+  H = table_polclass(disc_i);
+  if (H == NULL) {
+    H = polclass(disc, 0, -1);  /* Hilbert polynomial */
+  }
   Hmod = gmodulo(H, modulus); /* Polynomial in Z/nZ ring */
   xn = varn(Hmod);
   x = pol_x(xn);  
   g = gsubsg(1728, x);
   inv_den = ginvmod(g, Hmod); /* 1/(1728 - x) mod H_j(x) */
+  trace_end();
 
-  while (n < CM_ANOMALOUS_MAX_ATTEMPTS) {
+  while (n < CM_ANOMALOUS_MAX_ATTEMPTS && !deadline_check()) {
     start_loop = avma;
+    stats_iter();
     if (verb) {
       fprintf(stderr, "    Run %d out of %d\n", n+1, CM_ANOMALOUS_MAX_ATTEMPTS);
     }
@@ -55,7 +61,13 @@ int factor_cm_anomalous_core(GEN modulus, long disc_i, GEN *p, GEN *q) {
      * Step 4:
      * scalar multiplication with Montgomery ladder algorithm
      */
+    trace_begin("ladder");
     ladder(modulus, x0, A, B, &res_x, &res_z);
+    trace_end();
+    if (deadline_expired()) {
+      /* The ladder was stopped, the result is meaningless */
+      break;
+    }
 
     /* 
      * Step 5:
@@ -64,8 +76,11 @@ int factor_cm_anomalous_core(GEN modulus, long disc_i, GEN *p, GEN *q) {
      * - We compute the resultant with Hilbert polynomial to get an integer
      * - Finally, gcd to get (hopefully) the prime factor
      */
+    trace_begin("resultant_gcd");
     res = gmod(ZX_resultant(H, lift(lift(res_z))), modulus);
+    stats_gcd();
     *p = gcdii(res, modulus);
+    trace_end();
     /* If non-trivial gcd, we have the prime factor */
     if (gcmp(*p, gen_1) == 1 && gcmp(*p, modulus) == -1) {
       *q = gdivexact(modulus, *p);
@@ -88,17 +103,30 @@ int factor_cm_anomalous_core(GEN modulus, long disc_i, GEN *p, GEN *q) {
 
 /* Factor modulus, trying discriminants D with -max_disc < D <= -3 */
 int factor_cm_anomalous(GEN modulus, GEN *p, GEN *q, int max_disc) {
+  return factor_cm_anomalous_range(modulus, p, q, 0, max_disc);
+}
+
+/* Same as `factor_cm_anomalous` with -max_disc < D <= -3 and D <= -min_disc */
+int factor_cm_anomalous_range(GEN modulus, GEN *p, GEN *q, int min_disc, int max_disc) {
   int found = FALSE;
   int disc_i = -3;
 
+  while (disc_i > -min_disc) {
+    disc_i -= 4;
+  }
   if (verb) {
-    fprintf(stderr, "    Discriminants between -3 and -%d will be tested\n", max_disc);
+    fprintf(stderr, "    Discriminants between %d and -%d will be tested\n", disc_i, max_disc);
   }
   while (!found && disc_i > -max_disc) {
     if (verb) {
       fprintf(stderr, "    Testing discriminant %d\n", disc_i);
     }
     found = factor_cm_anomalous_core(modulus, disc_i, p, q);
+    if (!found && deadline_expired()) {
+      /* The discriminant disc_i is not completely tested */
+      deadline_progress("discriminant", -disc_i);
+      break;
+    }
     disc_i -= 4;
   }
   
@@ -0,0 +1,391 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <ctype.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * Daemon mode of rsa_single: PARI, the random seeds of the workers and the
+ * tables (see tables.c) are initialized once, and the jobs are received over
+ * a UNIX socket and run by a pool of workers, highest priority first.
+ * The protocol is line based (see rsa_client):
+ *   JOB [option=value ...] <record>  -> QUEUED <job>, or ERROR <reason>
+ *       record: as in the streaming mode (JSON object or decimal values)
+ *       options: priority (default 0), attacks (comma-separated names), budget, timeout,
+ *                fermat-bound, p1-prime-bound, p1-nbits-bound, cm-disc-bound, cm-disc
+ *   STATUS    -> STATUS <queued> <running> <done>
+ *   SHUTDOWN  the queued jobs are completed, then the daemon stops
+ * The result of a job is sent to the client which submitted it:
+ *   RESULT <job> <JSON result of the streaming mode>
+ * The jobs of a client which disconnects are dropped.
+ */
+
+typedef struct {
+  int fd;
+  pthread_mutex_t lock;
+  int refs;                   /* the connection and the jobs in flight */
+  int closed;                 /* disconnected, or the daemon is stopping */
+  char buf[DAEMON_LINE_SIZE];
+  size_t len;
+} daemon_client_t;
+
+typedef struct {
+  long index;
+  key_rec_t rec;
+  single_cfg_t cfg;
+  daemon_client_t *cl;
+} daemon_job_t;
+
+static volatile sig_atomic_t stopping = FALSE;
+static long jobs_queued = 0, jobs_running = 0, jobs_done = 0;
+
+static void daemon_interrupt(int sig) {
+  (void)sig;
+  stopping = TRUE;
+}
+
+static void client_unref(daemon_client_t *cl) {
+  int refs;
+
+  pthread_mutex_lock(&cl->lock);
+  refs = --cl->refs;
+  pthread_mutex_unlock(&cl->lock);
+  if (refs == 0) {
+    close(cl->fd);
+    pthread_mutex_destroy(&cl->lock);
+    free(cl);
+  }
+}
+
+/* Send a line to a client, nothing if it is disconnected */
+static void client_send(daemon_client_t *cl, const char *line) {
+  size_t len = strlen(line);
+  ssize_t w;
+
+  pthread_mutex_lock(&cl->lock);
+  while (!cl->closed && len > 0) {
+    w = send(cl->fd, line, len, MSG_NOSIGNAL);
+    if (w <= 0) {
+      cl->closed = TRUE;
+      break;
+    }
+    line += w;
+    len -= w;
+  }
+  pthread_mutex_unlock(&cl->lock);
+}
+
+static char *daemon_job_run(void *data, void *arg) {
+  daemon_job_t *job = data;
+  single_res_t res;
+  GEN e = NULL;
+  GEN volatile modulus = NULL;
+  char *out, *line;
+  (void)arg;
+
+  __atomic_sub_fetch(&jobs_queued, 1, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&job->cl->closed, __ATOMIC_RELAXED)) {
+    return NULL;
+  }
+  __atomic_add_fetch(&jobs_running, 1, __ATOMIC_RELAXED);
+
+  res.found = FALSE;
+  res.timeout = FALSE;
+  pari_CATCH(CATCH_ALL) {
+    modulus = NULL;
+    res.found = FALSE;
+  }
+  pari_TRY {
+    modulus = strtoi(job->rec.n);
+    e = job->rec.e != NULL ? strtoi(job->rec.e) : NULL;
+    run_single(&job->cfg, modulus, e, NULL, &res);
+  }
+  pari_ENDCATCH;
+
+  out = stream_result(&job->rec, modulus, &res);
+  line = pari_sprintf("RESULT %ld %s\n", job->index, out);
+  client_send(job->cl, line);
+  pari_free(line);
+  pari_free(out);
+
+  __atomic_sub_fetch(&jobs_running, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&jobs_done, 1, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static void daemon_job_release(void *data) {
+  daemon_job_t *job = data;
+
+  key_rec_free(&job->rec);
+  client_unref(job->cl);
+  free(job);
+}
+
+/* Option name=value of a job, FALSE if unknown or invalid */
+static int job_option(daemon_job_t *job, const char *name, const char *value, long *priority) {
+  single_cfg_t *cfg = &job->cfg;
+  int set;
+
+  if (!strcmp(name, "priority")) {
+    *priority = atol(value);
+  }
+  else if (!strcmp(name, "attacks")) {
+    set = attack_set(value);
+    if (set <= 0) {
+      return FALSE;
+    }
+    cfg->attack = NULL;
+    cfg->select = set;
+  }
+  else if (!strcmp(name, "budget")) {
+    cfg->budget = atof(value);
+  }
+  else if (!strcmp(name, "timeout")) {
+    cfg->timeout = atof(value);
+  }
+  else if (!strcmp(name, "fermat-bound")) {
+    cfg->close_primes_bound = atol(value);
+  }
+  else if (!strcmp(name, "p1-prime-bound")) {
+    cfg->p1_prime_bound = atol(value);
+  }
+  else if (!strcmp(name, "p1-nbits-bound")) {
+    cfg->p1_nbits_bound = atol(value);
+  }
+  else if (!strcmp(name, "cm-disc-bound")) {
+    cfg->cm_disc_bound = atol(value);
+  }
+  else if (!strcmp(name, "cm-disc")) {
+    cfg->disc = atol(value);
+  }
+  else {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Parse the options and the record of a job (the line is modified), the error or NULL */
+static const char *job_parse(char *s, daemon_job_t *job, long *priority) {
+  char *name, *eq;
+
+  for (;;) {
+    while (isspace((unsigned char)*s)) {
+      s++;
+    }
+    if (*s == '{' || isdigit((unsigned char)*s) || *s == '\0') {
+      break;
+    }
+    name = s;
+    while (*s && !isspace((unsigned char)*s)) {
+      s++;
+    }
+    if (*s) {
+      *s++ = '\0';
+    }
+    eq = strchr(name, '=');
+    if (eq == NULL) {
+      return "option without value";
+    }
+    *eq = '\0';
+    if (!job_option(job, name, eq + 1, priority)) {
+      return "unknown or invalid option";
+    }
+  }
+
+  if (key_rec_parse(s, job->index, &job->rec) != KEY_REC_OK) {
+    return job->rec.error != NULL ? job->rec.error : "record missing";
+  }
+  /* The attacks of the record, unless given as an option */
+  if (job->rec.attacks != NULL && job->cfg.select == 0 && job->cfg.attack == NULL) {
+    job->cfg.select = attack_set(job->rec.attacks);
+  }
+  return NULL;
+}
+
+static void handle_job(workers_t *pool, const single_cfg_t *cfg, daemon_client_t *cl, char *line, long index) {
+  daemon_job_t *job = malloc(sizeof(daemon_job_t));
+  const char *error;
+  char reply[128];
+  long priority = 0;
+
+  memset(job, 0, sizeof(*job));
+  job->index = index;
+  job->cfg = *cfg;
+  job->cl = cl;
+
+  error = job_parse(line, job, &priority);
+  if (error == NULL) {
+    pthread_mutex_lock(&cl->lock);
+    cl->refs++;
+    pthread_mutex_unlock(&cl->lock);
+    __atomic_add_fetch(&jobs_queued, 1, __ATOMIC_RELAXED);
+    if (!workers_submit_priority(pool, job, priority)) {
+      __atomic_sub_fetch(&jobs_queued, 1, __ATOMIC_RELAXED);
+      pthread_mutex_lock(&cl->lock);
+      cl->refs--;
+      pthread_mutex_unlock(&cl->lock);
+      error = "queue full";
+    }
+  }
+  if (error != NULL) {
+    key_rec_free(&job->rec);
+    free(job);
+    snprintf(reply, sizeof(reply), "ERROR %s\n", error);
+  }
+  else {
+    snprintf(reply, sizeof(reply), "QUEUED %ld\n", index);
+    if (verb) {
+      fprintf(stderr, "[x] Job %ld queued with priority %ld\n", index, priority);
+    }
+  }
+  client_send(cl, reply);
+}
+
+/* Read the available lines of a client, FALSE if it disconnected */
+static int handle_client(workers_t *pool, const single_cfg_t *cfg, daemon_client_t *cl, long *njobs) {
+  char reply[128], *nl;
+  ssize_t r;
+
+  r = read(cl->fd, cl->buf + cl->len, sizeof(cl->buf) - 1 - cl->len);
+  if (r <= 0) {
+    return FALSE;
+  }
+  cl->len += r;
+  cl->buf[cl->len] = '\0';
+  while ((nl = strchr(cl->buf, '\n')) != NULL) {
+    *nl = '\0';
+    if (!strncmp(cl->buf, "JOB ", 4)) {
+      handle_job(pool, cfg, cl, cl->buf + 4, (*njobs)++);
+    }
+    else if (!strcmp(cl->buf, "STATUS")) {
+      snprintf(reply, sizeof(reply), "STATUS %ld %ld %ld\n", jobs_queued, jobs_running, jobs_done);
+      client_send(cl, reply);
+    }
+    else if (!strcmp(cl->buf, "SHUTDOWN")) {
+      stopping = TRUE;
+    }
+    else {
+      client_send(cl, "ERROR unknown command\n");
+    }
+    cl->len -= nl + 1 - cl->buf;
+    memmove(cl->buf, nl + 1, cl->len + 1);
+  }
+  /* Line too long */
+  return cl->len < sizeof(cl->buf) - 1;
+}
+
+static void drop_client(daemon_client_t **clients, int *nclients, int i) {
+  daemon_client_t *cl = clients[i];
+
+  pthread_mutex_lock(&cl->lock);
+  cl->closed = TRUE;
+  pthread_mutex_unlock(&cl->lock);
+  clients[i] = clients[--*nclients];
+  client_unref(cl);
+}
+
+/*
+ * Run the daemon on the UNIX socket path with nthreads workers,
+ * until SHUTDOWN, SIGINT or SIGTERM. The options of the jobs override cfg.
+ */
+void daemon_run(const char *path, const single_cfg_t *cfg, int nthreads) {
+  struct sockaddr_un addr;
+  struct pollfd *fds = NULL;
+  daemon_client_t **clients = NULL, *cl;
+  workers_t pool;
+  struct stat sb;
+  long njobs = 0;
+  int lfd, fd, i, nclients = 0;
+
+  /* Only the socket of a previous daemon is replaced */
+  if (lstat(path, &sb) == 0) {
+    if (!S_ISSOCK(sb.st_mode)) {
+      fprintf(stderr, "[!] %s exists and is not a socket\n", path);
+      return;
+    }
+    unlink(path);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, daemon_interrupt);
+  signal(SIGTERM, daemon_interrupt);
+
+  lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, 64)) {
+    fprintf(stderr, "[!] Cannot listen on %s\n", path);
+    if (lfd >= 0) {
+      close(lfd);
+    }
+    return;
+  }
+
+  tables_init(cfg->cm_disc_bound, cfg->p1_prime_bound, cfg->p1_nbits_bound);
+  nthreads = workers_start(&pool, nthreads, WORKER_PARISIZE, FALSE, DAEMON_QUEUE_MAX, stdout,
+                           daemon_job_run, daemon_job_release, NULL);
+  if (nthreads == 0) {
+    fprintf(stderr, "[!] Cannot start the worker threads\n");
+    stopping = TRUE;
+  }
+  else if (verb) {
+    fprintf(stderr, "[!] Daemon listening on %s with %d workers\n", path, nthreads);
+  }
+
+  while (!stopping) {
+    fds = realloc(fds, (nclients + 1)*sizeof(struct pollfd));
+    fds[0].fd = lfd;
+    fds[0].events = POLLIN;
+    for (i = 0; i < nclients; i++) {
+      fds[i+1].fd = clients[i]->fd;
+      fds[i+1].events = POLLIN;
+    }
+    if (poll(fds, nclients + 1, -1) < 0) {
+      continue;
+    }
+
+    /* Clients in reverse order: a dropped client is replaced by the last one */
+    for (i = nclients - 1; i >= 0; i--) {
+      if (fds[i+1].revents && !handle_client(&pool, cfg, clients[i], &njobs)) {
+        drop_client(clients, &nclients, i);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      fd = accept(lfd, NULL, NULL);
+      if (fd >= 0) {
+        cl = malloc(sizeof(daemon_client_t));
+        memset(cl, 0, sizeof(*cl));
+        cl->fd = fd;
+        cl->refs = 1;
+        pthread_mutex_init(&cl->lock, NULL);
+        clients = realloc(clients, (nclients + 1)*sizeof(daemon_client_t *));
+        clients[nclients++] = cl;
+      }
+    }
+  }
+
+  if (verb) {
+    fprintf(stderr, "[!] Daemon stopping, %ld jobs queued\n", jobs_queued);
+  }
+  close(lfd);
+  unlink(path);
+  if (nthreads > 0) {
+    /* The clients still connected receive the results of the queued jobs */
+    workers_finish(&pool);
+  }
+  while (nclients > 0) {
+    drop_client(clients, &nclients, nclients - 1);
+  }
+  tables_close();
+  free(fds);
+  free(clients);
+}
@@ -0,0 +1,115 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Faulty CRT signatures (Bellcore attack).
+ * A signature s = m^d mod n computed with the CRT, with an error in the
+ * computation modulo p only, is still correct modulo q:
+ *   gcd(s^e - m mod n, n) = q.
+ * For the signatures of a same key, the values v_i = s_i^e - m_i mod n of the
+ * invalid signatures are multiplied in a product tree modulo n, so that a single
+ * gcd with the root tells if one of them is faulty.
+ * The tree is descended from the root to the faulty signature, a subtree being
+ * pruned as soon as the gcd of its product with n is 1.
+ */
+
+/* Levels of the product tree of v modulo n, from the leaves to the root */
+static GEN product_tree(GEN v, GEN n) {
+  GEN T, prev, cur;
+  long h = 1, i, j, l = lg(v) - 1;
+
+  while ((1L << (h - 1)) < l) {
+    h++;
+  }
+  T = cgetg(h + 1, t_VEC);
+  gel(T, 1) = v;
+  for (j = 2; j <= h; j++) {
+    prev = gel(T, j - 1);
+    l = lg(prev) - 1;
+    cur = cgetg((l + 1)/2 + 1, t_VEC);
+    for (i = 1; i <= l/2; i++) {
+      gel(cur, i) = Fp_mul(gel(prev, 2*i - 1), gel(prev, 2*i), n);
+    }
+    if (l & 1) {
+      gel(cur, (l + 1)/2) = gel(prev, l);
+    }
+    gel(T, j) = cur;
+  }
+  return T;
+}
+
+/*
+ * Leaf below the node i of the level j whose gcd with n is a proper factor *g, or 0.
+ * The gcd of a node is n when faults modulo p and modulo q cancel its product.
+ */
+static long tree_descend(GEN T, long j, long i, GEN n, GEN *g) {
+  GEN d;
+  long r;
+
+  stats_gcd();
+  d = gcdii(gmael(T, j, i), n);
+  if (equali1(d)) {
+    return 0;
+  }
+  if (j == 1) {
+    if (equalii(d, n)) {
+      return 0;
+    }
+    *g = d;
+    return i;
+  }
+  r = tree_descend(T, j - 1, 2*i - 1, n, g);
+  if (r == 0 && 2*i < lg(gel(T, j - 1))) {
+    r = tree_descend(T, j - 1, 2*i, n, g);
+  }
+  return r;
+}
+
+/*
+ * Screen the signatures sigs = [[m_1, s_1], ...] under the key (modulus, e).
+ * Returns the index of a faulty signature and the factors, or 0.
+ * The number of valid signatures is written in *nvalid.
+ */
+long factor_fault_crt(GEN modulus, GEN e, GEN sigs, long *nvalid, GEN *p, GEN *q) {
+  GEN v, idx, T, g, s;
+  long i, l = lg(sigs) - 1, nv = 0, leaf;
+  pari_sp av = avma;
+
+  /* s^e - m mod n, Fp_powu works in Montgomery form for a small e */
+  v = cgetg(l + 1, t_VEC);
+  idx = cgetg(l + 1, t_VECSMALL);
+  for (i = 1; i <= l; i++) {
+    s = modii(gmael(sigs, i, 2), modulus);
+    s = lgefint(e) == 3 ? Fp_powu(s, itou(e), modulus) : Fp_pow(s, e, modulus);
+    s = Fp_sub(s, gmael(sigs, i, 1), modulus);
+    if (signe(s)) {
+      nv++;
+      gel(v, nv) = s;
+      idx[nv] = i;
+    }
+  }
+  *nvalid = l - nv;
+  if (verb) {
+    fprintf(stderr, "[x] %ld signatures, %ld valid\n", l, l - nv);
+  }
+  if (nv == 0) {
+    avma = av;
+    return 0;
+  }
+  setlg(v, nv + 1);
+
+  T = product_tree(v, modulus);
+  leaf = tree_descend(T, lg(T) - 1, 1, modulus, &g);
+  if (leaf == 0) {
+    avma = av;
+    return 0;
+  }
+  *p = g;
+  *q = diviiexact(modulus, g);
+  gerepileall(av, 2, p, q);
+  return idx[leaf];
+}
@@ -5,10 +5,33 @@
 
 #include "rsa.h"
 
+/*
+ * Lucas sequence V_m(x) with V_0 = 2, V_1 = x and V_{k+1} = x*V_k - V_{k-1}:
+ * it is the x-coordinate of [m]P if P has x-coordinate x
+ * on the circle x^2 + y^2 = 4 or on the hyperbola x^2 - y^2 = 4.
+ * Ladder with V_{2k} = V_k^2 - 2 and V_{2k+1} = V_k*V_{k+1} - x.
+ */
+GEN lucas_ladder(GEN m, GEN x) {
+  GEN x0 = x, x1 = gsub(gsqr(x), gen_2);
+  long i, len = logint(m, gen_2) + 1;
+
+  for (i = len - 2; i >= 0; i--) {
+    if (bittest(m, i)) {
+      x0 = gsub(gmul(x0, x1), x);
+      x1 = gsubgs(gsqr(x1), 2);
+    }
+    else {
+      x1 = gsub(gmul(x0, x1), x);
+      x0 = gsubgs(gsqr(x0), 2);
+    }
+  }
+  return x0;
+}
+
 int factor_p_plus_minus_one(GEN modulus, GEN *p, GEN *q, GEN maxprime, long logbound) {
-  int found = FALSE, n = 0, i;
-  long len, bit, e;
-  GEN x, x0, x1, pp, exponent;
+  int found = FALSE, n = 0;
+  long e, i;
+  GEN x0, pp, exponent, powers = table_prime_powers(maxprime, logbound);
   pari_sp av = avma, start_loop;
   forprime_t T;
 
@@ -31,32 +54,34 @@ int factor_p_plus_minus_one(GEN modulus, GEN *p, GEN *q, GEN maxprime, long logb
     x0 = gmodulo(randomi(modulus), modulus);
     forprime_init(&T, gen_2, maxprime);
     start_loop = avma;
+    i = 0;
     while ((pp = forprime_next(&T))) {
       if (pp == NULL) { break; }
-      e = logbound/logint(pp, gen_2);
-      exponent = powiu(pp, e);
-      
-      /* Ladder exponentiation */
-      len = logint(exponent, gen_2) + 1;
-      x = gcopy(x0);
-      x1 = gsub(gsqr(x0), gen_2);
-      for (i = len - 2; i >= 0; i--) {
-        bit = bittest(exponent, i);
-        if (bit == 1) {
-          x0 = gsub(gmul(x0, x1), x);
-          x1 = gsubgs(gsqr(x1), 2);
-        }
-        else {
-          x1 = gsub(gmul(x0, x1), x);
-          x0 = gsubgs(gsqr(x0), 2);
-        }
+      if (deadline_check()) {
+        deadline_progress("prime", itos(pp));
+        break;
       }
+      stats_iter();
+      if (powers != NULL) {
+        exponent = gel(powers, ++i);
+      }
+      else {
+        e = logbound/logint(pp, gen_2);
+        exponent = powiu(pp, e);
+      }
+      
+      trace_begin("lucas_ladder");
+      x0 = lucas_ladder(exponent, x0);
+      trace_end();
 
       /* 
        * If non-trivial gcd, we have the prime factor.
        * Otherwise we continue until the bound is reached.
        */
+      trace_begin("gcd");
+      stats_gcd();
       *p = gcdii(lift(gsub(x0, gen_2)), modulus);
+      trace_end();
       if (!gequal1(*p) && !gequal(*p, modulus)) {
         *q = gdivexact(modulus, *p);
         found = TRUE;
@@ -72,6 +97,9 @@ int factor_p_plus_minus_one(GEN modulus, GEN *p, GEN *q, GEN maxprime, long logb
     n++;
     /* Garbage cleaning */
     avma = av;
+    if (deadline_expired()) {
+      break;
+    }
   }
 
   /* Garbage cleaning */
@@ -82,4 +110,126 @@ int factor_p_plus_minus_one(GEN modulus, GEN *p, GEN *q, GEN maxprime, long logb
     avma = av;
   }
   return found;
-}
\ No newline at end of file
+}
+
+/*
+ * Stage 1 of the sharded p-1 and p+1 attack:
+ * the P_PM_1_MAX_ATTEMPTS random points multiplied by the smooth M of
+ * `factor_p_plus_minus_one` are returned in *xs, for the stage 2
+ * (fewer of them if the deadline stopped the stage 1).
+ * Returns TRUE if stage 1 already factors the modulus.
+ */
+int factor_p_pm_1_stage1(GEN modulus, GEN maxprime, long logbound, GEN *xs, GEN *p, GEN *q) {
+  int found = FALSE, n;
+  long i;
+  GEN x0, pp, powers = table_prime_powers(maxprime, logbound);
+  pari_sp av = avma, start_loop;
+  forprime_t T;
+
+  *xs = cgetg(P_PM_1_MAX_ATTEMPTS + 1, t_VEC);
+  for (n = 1; !found && n <= P_PM_1_MAX_ATTEMPTS && !deadline_expired(); n++) {
+    x0 = gmodulo(randomi(modulus), modulus);
+    forprime_init(&T, gen_2, maxprime);
+    start_loop = avma;
+    trace_begin("stage1");
+    i = 0;
+    while ((pp = forprime_next(&T))) {
+      if (deadline_check()) {
+        deadline_progress("prime", itos(pp));
+        break;
+      }
+      stats_iter();
+      i++;
+      x0 = lucas_ladder(powers != NULL ? gel(powers, i) : powiu(pp, logbound/logint(pp, gen_2)), x0);
+      if (gc_needed(start_loop, 1)) {
+        x0 = gerepilecopy(start_loop, x0);
+      }
+    }
+    trace_end();
+    trace_begin("gcd");
+    stats_gcd();
+    *p = gcdii(lift(gsub(x0, gen_2)), modulus);
+    trace_end();
+    if (!gequal1(*p) && !gequal(*p, modulus)) {
+      *q = diviiexact(modulus, *p);
+      found = TRUE;
+    }
+    gel(*xs, n) = x0;
+  }
+  /* Points of the attempts run before an interruption */
+  setlg(*xs, n);
+
+  if (found) {
+    gerepileall(av, 2, p, q);
+  }
+  else {
+    *xs = gerepilecopy(av, *xs);
+  }
+  return found;
+}
+
+/*
+ * Stage 2 of the p-1 and p+1 attack over the primes start <= ell < end:
+ * p-1 (or p+1) may have one prime factor ell above the bound of the stage 1.
+ * The products of V_ell(x) - 2 are accumulated and a gcd is computed
+ * every P_PM_1_STAGE2_GCD primes.
+ */
+int factor_p_pm_1_stage2(GEN modulus, GEN xs, GEN start, GEN end, GEN *p, GEN *q) {
+  int found = FALSE, n;
+  long count;
+  GEN acc, ell;
+  pari_sp av = avma, start_loop;
+  forprime_t T;
+
+  if (cmpii(start, end) >= 0) {
+    return FALSE;
+  }
+  for (n = 1; !found && n < lg(xs) && !deadline_expired(); n++) {
+    if (verb) {
+      fprintf(stderr, "    Stage 2, run %d out of %ld\n", n, lg(xs) - 1);
+    }
+    forprime_init(&T, start, subiu(end, 1));
+    acc = gmodulo(gen_1, modulus);
+    count = 0;
+    start_loop = avma;
+    trace_begin("stage2");
+    while (!found && (ell = forprime_next(&T))) {
+      stats_iter();
+      acc = gmul(acc, gsubgs(lucas_ladder(ell, gel(xs, n)), 2));
+      if (deadline_check()) {
+        deadline_progress("prime", itos(ell));
+        break;
+      }
+      if (++count == P_PM_1_STAGE2_GCD) {
+        trace_begin("gcd");
+        stats_gcd();
+        *p = gcdii(lift(acc), modulus);
+        trace_end();
+        found = !gequal1(*p) && !gequal(*p, modulus);
+        acc = gmodulo(gen_1, modulus);
+        count = 0;
+      }
+      if (gc_needed(start_loop, 1)) {
+        acc = gerepilecopy(start_loop, acc);
+      }
+    }
+    trace_end();
+    /* Remaining primes since the last gcd */
+    if (!found) {
+      trace_begin("gcd");
+      stats_gcd();
+      *p = gcdii(lift(acc), modulus);
+      trace_end();
+      found = !gequal1(*p) && !gequal(*p, modulus);
+    }
+  }
+
+  if (found) {
+    *q = diviiexact(modulus, *p);
+    gerepileall(av, 2, p, q);
+  }
+  else {
+    avma = av;
+  }
+  return found;
+}
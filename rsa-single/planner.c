@@ -0,0 +1,218 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <math.h>
+#include "rsa.h"
+
+/*
+ * Attack planner of rsa_single.
+ * Cheap features of (n, e) rule out some attacks:
+ *   - factor_small only works below SMALL_MODULUS_NBITS_BOUND bits,
+ *   - factor_square only works if n is a square, and then nothing else is needed,
+ *   - a private exponent d < n^(1/4) implies e > phi(n)/d > n^(3/4)/2,
+ *     so factor_small_d and factor_wiener need e of almost the size of n,
+ *   - if p = q mod 2^l with l >= 3, then n = p^2 mod 8 = 1 mod 8,
+ *     in particular if n mod 4 = 3, p and q share only the least significant bit,
+ *   - factor_siqs factors any modulus of SMALL_MODULUS_NBITS_BOUND to
+ *     SIQS_NBITS_BOUND bits, in a time L(n)^(1 + o(1)) = exp(sqrt(ln n ln ln n)).
+ * The other attacks are ordered by decreasing ratio probability / cost,
+ * which minimizes the expected time before the first success.
+ * Costs are rough estimates in seconds, from the cost M of a modular
+ * multiplication, and the probabilities are priors on weak keys.
+ */
+
+/* Prior probabilities of success, indexed by ATTACK_* */
+static const double PRIORS[ATTACK_COUNT] = {
+  0.9,    /* factor_small */
+  0.9,    /* factor_square */
+  0.3,    /* factor_small_d */
+  0.3,    /* factor_wiener */
+  0.05,   /* factor_fermat */
+  0.5,    /* factor_shared_lsb */
+  0.02,   /* factor_p_pm_1 */
+  0.01,   /* factor_cm */
+  0.99    /* factor_siqs */
+};
+
+/* Estimated time of a multiplication mod n in seconds */
+static double mulmod_cost(long nbits) {
+  return 1e-6*pow(nbits/2048., 1.6);
+}
+
+/* Estimated number of primes less than x */
+static double prime_count(double x) {
+  return x < 3 ? 1 : x/log(x);
+}
+
+static double cost_fermat(long nbits, long bound) {
+  return 2*bound*mulmod_cost(nbits);
+}
+
+/* P_PM_1_MAX_ATTEMPTS ladders of logbound bits for each prime */
+static double cost_p_pm_1(long nbits, long prime_bound, long nbits_bound) {
+  return P_PM_1_MAX_ATTEMPTS*prime_count(prime_bound)*nbits_bound*2*mulmod_cost(nbits);
+}
+
+/* Ladders over n in an extension of degree h(D) ~ sqrt(|D|)/pi */
+static double cost_cm_disc(long nbits, long disc) {
+  double h = sqrt(disc)/M_PI;
+
+  h = h < 1 ? 1 : h;
+  return CM_ANOMALOUS_MAX_ATTEMPTS*nbits*25*h*h*mulmod_cost(nbits);
+}
+
+/* Discriminants D with -max_disc < D <= -3 */
+static double cost_cm(long nbits, long max_disc) {
+  double cost = 0;
+  long disc;
+
+  for (disc = 3; disc < max_disc; disc += 4) {
+    cost += cost_cm_disc(nbits, disc);
+  }
+  return cost;
+}
+
+/* L(n) up to a rough constant */
+static double cost_siqs(long nbits, int threads) {
+  double ln = nbits*log(2);
+
+  return 1.5e-10*exp(sqrt(ln*log(ln)))/(threads > 0 ? threads : 1);
+}
+
+static double attack_cost(const single_cfg_t *cfg, int id, long nbits) {
+  double m = mulmod_cost(nbits);
+
+  switch (id) {
+    case ATTACK_SMALL:
+      return 1e-3*pow(2, (nbits - 100)/10.);
+    case ATTACK_SQUARE:
+      return 10*m;
+    case ATTACK_SMALL_D:
+      return nbits*m;
+    case ATTACK_WIENER:
+      return 0.9*nbits*nbits*m;
+    case ATTACK_FERMAT:
+      return cost_fermat(nbits, cfg->close_primes_bound);
+    case ATTACK_SHARED_LSB:
+      return 50*m;
+    case ATTACK_P_PM_1:
+      return cost_p_pm_1(nbits, cfg->p1_prime_bound, cfg->p1_nbits_bound);
+    case ATTACK_CM:
+      if (cfg->disc != -1) {
+        return cost_cm_disc(nbits, cfg->disc);
+      }
+      return cost_cm(nbits, cfg->cm_disc_bound);
+    case ATTACK_SIQS:
+      return cost_siqs(nbits, cfg->threads);
+  }
+  return m;
+}
+
+/*
+ * Compute the plan of the attacks on (modulus, e), e can be NULL.
+ * With cfg->attack, only this attack is planned, with cfg->select only these attacks.
+ * Without cfg->plan, the attacks are planned in the fixed order of ATTACK_*.
+ */
+void plan_attacks(const single_cfg_t *cfg, GEN modulus, GEN e, attack_plan_t *plan) {
+  int i, j, id, single = -1;
+  double ri, rj;
+  pari_sp av = avma;
+
+  memset(plan, 0, sizeof(*plan));
+  plan->nbits = logint(modulus, gen_2) + 1;
+  plan->ebits = e != NULL && signe(e) > 0 ? logint(e, gen_2) + 1 : 0;
+  plan->n_mod16 = umodiu(modulus, 16);
+  plan->square = Z_issquareall(modulus, NULL);
+  avma = av;
+
+  if (cfg->attack != NULL) {
+    single = attack_index(cfg->attack);
+  }
+
+  for (id = 0; id < ATTACK_COUNT; id++) {
+    plan->prob[id] = PRIORS[id];
+    if ((cfg->attack != NULL && id != single) || (cfg->select != 0 && !(cfg->select & (1 << id)))) {
+      plan->pruned[id] = "not selected";
+      continue;
+    }
+    if (cfg->attack == NULL && cfg->plan) {
+      if (id == ATTACK_SMALL && plan->nbits > SMALL_MODULUS_NBITS_BOUND) {
+        plan->pruned[id] = "modulus is too big";
+      }
+      else if (id == ATTACK_SQUARE && !plan->square) {
+        plan->pruned[id] = "modulus is not a square";
+      }
+      else if (id != ATTACK_SQUARE && plan->square) {
+        plan->pruned[id] = "modulus is a square";
+      }
+      else if ((id == ATTACK_SMALL_D || id == ATTACK_WIENER) && plan->ebits == 0) {
+        plan->pruned[id] = "public exponent not provided";
+      }
+      else if ((id == ATTACK_SMALL_D || id == ATTACK_WIENER) && 4*plan->ebits < 3*plan->nbits - 4) {
+        plan->pruned[id] = "e < n^(3/4) rules out d < n^(1/4)";
+      }
+      else if (id == ATTACK_SHARED_LSB && plan->n_mod16 % 8 != 1) {
+        plan->pruned[id] = "n mod 8 != 1, p and q share at most 2 bits";
+      }
+      else if (id == ATTACK_SIQS && plan->nbits > SIQS_NBITS_BOUND) {
+        plan->pruned[id] = "modulus is too big";
+      }
+      else if (id == ATTACK_SIQS && plan->nbits <= SMALL_MODULUS_NBITS_BOUND) {
+        plan->pruned[id] = "factor_small is faster";
+      }
+    }
+    /* At least one multiplication, the ratio is then always defined */
+    plan->cost[id] = attack_cost(cfg, id, plan->nbits) + mulmod_cost(plan->nbits);
+    if (plan->pruned[id] == NULL) {
+      plan->order[plan->n++] = id;
+    }
+  }
+
+  if (cfg->attack != NULL || !cfg->plan) {
+    return;
+  }
+
+  /* Insertion sort by decreasing probability / cost */
+  for (i = 1; i < plan->n; i++) {
+    id = plan->order[i];
+    ri = plan->prob[id]/plan->cost[id];
+    for (j = i; j > 0; j--) {
+      rj = plan->prob[plan->order[j-1]]/plan->cost[plan->order[j-1]];
+      if (rj >= ri) {
+        break;
+      }
+      plan->order[j] = plan->order[j-1];
+    }
+    plan->order[j] = id;
+  }
+}
+
+/* Print the plan on stderr */
+void plan_print(const single_cfg_t *cfg, const attack_plan_t *plan) {
+  int i, id;
+
+  fprintf(stderr, "[!] Attack plan: n has %ld bits, n mod 16 = %ld, ",
+          plan->nbits, plan->n_mod16);
+  if (plan->ebits > 0) {
+    fprintf(stderr, "e has %ld bits\n", plan->ebits);
+  }
+  else {
+    fprintf(stderr, "e not provided\n");
+  }
+  for (i = 0; i < plan->n; i++) {
+    id = plan->order[i];
+    fprintf(stderr, "    %d. %-18s cost ~ %.2e s, success ~ %.2f\n",
+            i + 1, ATTACK_NAMES[id], plan->cost[id], plan->prob[id]);
+  }
+  for (id = 0; id < ATTACK_COUNT; id++) {
+    if (plan->pruned[id] != NULL && cfg->attack == NULL) {
+      fprintf(stderr, "    -  %-18s pruned: %s\n", ATTACK_NAMES[id], plan->pruned[id]);
+    }
+  }
+  if (cfg->budget > 0 || cfg->timeout > 0) {
+    fprintf(stderr, "    Time budget per attack: %.1f s, global timeout: %.1f s (0 for none)\n",
+            cfg->budget, cfg->timeout);
+  }
+}
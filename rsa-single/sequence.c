@@ -0,0 +1,401 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/* Names of the attacks, indexed by ATTACK_* */
+const char *ATTACK_NAMES[ATTACK_COUNT] = {
+  "factor_small", "factor_square", "factor_small_d", "factor_wiener",
+  "factor_fermat", "factor_shared_lsb", "factor_p_pm_1", "factor_cm",
+  "factor_siqs"
+};
+
+static const char *ATTACK_HEADERS[ATTACK_COUNT] = {
+  "[x] Small modulus factorization...",
+  "[x] Square modulus factorization...",
+  "[x] Running small d attack...",
+  "[x] Running Wiener attack...",
+  "[x] Running close primes attack...",
+  "[x] Running shared LSB attack...",
+  "[x] Running p-1 and p+1 attack...",
+  "[x] Running 4p-1 attack...",
+  "[x] Running quadratic sieve (SIQS)..."
+};
+
+/* Default configuration of the attacks (values from config.h) */
+void single_cfg_init(single_cfg_t *cfg) {
+  cfg->attack = NULL;
+  cfg->select = 0;
+  cfg->cache = NULL;
+  cfg->close_primes_bound = FERMAT_BOUND;
+  cfg->p1_prime_bound = P_PM_1_PRIME_BOUND;
+  cfg->p1_nbits_bound = P_PM_1_NBITS_BOUND;
+  cfg->p1_stage2_bound = 0;
+  cfg->cm_disc_bound = CM_ANOMALOUS_DISC_BOUND;
+  cfg->disc = -1;
+  cfg->siqs_fb_size = 0;
+  cfg->siqs_block_size = 0;
+  cfg->threads = 1;
+  cfg->budget = ATTACK_BUDGET;
+  cfg->timeout = 0;
+  cfg->plan = TRUE;
+  cfg->quiet = FALSE;
+  cfg->triage = FALSE;
+}
+
+/* Index of an attack from its name, -1 if unknown */
+int attack_index(const char *name) {
+  int i;
+
+  for (i = 0; i < ATTACK_COUNT; i++) {
+    if (!strcmp(ATTACK_NAMES[i], name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Set of attacks from a comma-separated list of names, -1 if one is unknown */
+int attack_set(const char *list) {
+  char name[32];
+  const char *end;
+  int set = 0, id;
+  size_t len;
+
+  while (*list) {
+    end = strchr(list, ',');
+    len = end != NULL ? (size_t)(end - list) : strlen(list);
+    if (len >= sizeof(name)) {
+      return -1;
+    }
+    memcpy(name, list, len);
+    name[len] = '\0';
+    id = attack_index(name);
+    if (id < 0) {
+      return -1;
+    }
+    set |= 1 << id;
+    list += end != NULL ? len + 1 : len;
+  }
+  return set;
+}
+
+/* Name of the attack recorded in the cache */
+static const char *cached_attack(const char *name) {
+  int i = attack_index(name);
+
+  if (i >= 0) {
+    return ATTACK_NAMES[i];
+  }
+  return strcmp(name, "prime_factor_recovery") ? "result_cache" : "prime_factor_recovery";
+}
+
+static void header(const single_cfg_t *cfg, const char *msg) {
+  if (!cfg->quiet || verb) {
+    fprintf(stderr, "%s\n", msg);
+  }
+}
+
+/* Attack already run without success according to the cache */
+static int cached(const single_cfg_t *cfg, int done) {
+  if (done) {
+    header(cfg, "    Skipped: already run (result cache)");
+  }
+  return done;
+}
+
+/*
+ * TRUE if the attack was stopped by its deadline,
+ * then the progress is reported so that the attack can be resumed.
+ */
+static int stopped(const single_cfg_t *cfg, single_res_t *res) {
+  const char *what;
+  long reached;
+
+  if (!deadline_expired()) {
+    return FALSE;
+  }
+  res->timeout = TRUE;
+  reached = deadline_reached(&what);
+  if (!cfg->quiet || verb) {
+    if (what != NULL) {
+      fprintf(stderr, "    Stopped by the time budget at %s = %ld\n", what, reached);
+    }
+    else {
+      fprintf(stderr, "    Stopped by the time budget\n");
+    }
+  }
+  return TRUE;
+}
+
+/* Record the progress in the cache after an attack */
+static void store(const single_cfg_t *cfg, cache_slot_t *entry) {
+  if (cfg->cache != NULL) {
+    cache_store(cfg->cache, entry);
+  }
+}
+
+/*
+ * Record the factors, and the private exponent d if the attack recovered it (NULL otherwise):
+ * the one left by a failed Wiener attack is not reported with the factors of another attack.
+ */
+static int success(const single_cfg_t *cfg, cache_slot_t *entry, single_res_t *res,
+                   const char *attack, GEN p, GEN q, GEN d) {
+  res->found = TRUE;
+  res->attack = attack;
+  res->p = p;
+  res->q = q;
+  res->d = d;
+  if (cfg->cache != NULL) {
+    cache_set_factor(entry, cmpii(p, q) < 0 ? p : q, attack);
+    cache_store(cfg->cache, entry);
+  }
+  return TRUE;
+}
+
+/*
+ * Run one attack.
+ * With a result cache, attacks already run are skipped,
+ * and the Fermat and 4p-1 attacks continue from the previous bounds,
+ * or from where they were stopped by their deadline.
+ */
+static int run_attack(int id, const single_cfg_t *cfg, GEN modulus, GEN e,
+                      cache_slot_t *entry, single_res_t *res) {
+  GEN p, q, dd = NULL;
+  long modulus_nbits;
+
+  header(cfg, ATTACK_HEADERS[id]);
+  switch (id) {
+    /* Run small modulus attack (n < 2^200 by default in config.h) */
+    case ATTACK_SMALL:
+      modulus_nbits = logint(modulus, gen_2) + 1;
+      if (modulus_nbits > SMALL_MODULUS_NBITS_BOUND) {
+        if (!cfg->quiet || verb) {
+          fprintf(stderr, "    Skipped: modulus is too big (%ld bits)\n", modulus_nbits);
+        }
+      }
+      else if (!cached(cfg, entry->flags & CACHE_SMALL)) {
+        if (factor_small_modulus(modulus, &p, &q)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        entry->flags |= CACHE_SMALL;
+        store(cfg, entry);
+      }
+      break;
+
+    /* Run square modulus attack */
+    case ATTACK_SQUARE:
+      if (!cached(cfg, entry->flags & CACHE_SQUARE)) {
+        if (factor_square_modulus(modulus, &p, &q)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        entry->flags |= CACHE_SQUARE;
+        store(cfg, entry);
+      }
+      break;
+
+    /* Run small d attack (in case Wiener did not work) */
+    case ATTACK_SMALL_D:
+      if (e == NULL) {
+        header(cfg, "    Skipped: public exponent not provided (use -e option)");
+      }
+      else if (!cached(cfg, entry->flags & CACHE_SMALL_D)) {
+        if (factor_small_d(modulus, e, &dd, &p, &q)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, dd);
+        }
+        entry->flags |= CACHE_SMALL_D;
+        store(cfg, entry);
+      }
+      break;
+
+    /* Run Wiener attack */
+    case ATTACK_WIENER:
+      if (e == NULL) {
+        header(cfg, "    Skipped: public exponent not provided (use -e option)");
+      }
+      else if (!cached(cfg, entry->flags & CACHE_WIENER)) {
+        if (factor_wiener(modulus, e, &dd, &p, &q)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, dd);
+        }
+        /* The private exponent might be known even if the factors are not */
+        res->d = dd;
+        if (!stopped(cfg, res)) {
+          entry->flags |= CACHE_WIENER;
+          store(cfg, entry);
+        }
+      }
+      break;
+
+    /* Run close primes attack (Fermat), from the previous bound */
+    case ATTACK_FERMAT:
+      if (!cached(cfg, entry->fermat_bound >= cfg->close_primes_bound)) {
+        if (factor_close_primes_range(modulus, &p, &q, entry->fermat_bound, cfg->close_primes_bound)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        entry->fermat_bound = stopped(cfg, res) ? deadline_reached(NULL) : cfg->close_primes_bound;
+        store(cfg, entry);
+      }
+      break;
+
+    /* Run shared lsb attack */
+    case ATTACK_SHARED_LSB:
+      if (!cached(cfg, entry->flags & CACHE_SHARED_LSB)) {
+        if (factor_shared_lsb(modulus, &p, &q)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        entry->flags |= CACHE_SHARED_LSB;
+        store(cfg, entry);
+      }
+      break;
+
+    /*
+     * Run p-1 and p+1 attack.
+     * Attempts start from random points, so they cannot be continued:
+     * the attack is run again unless the previous bounds were at least as high.
+     */
+    case ATTACK_P_PM_1:
+      if (!cached(cfg, entry->p1_prime_bound >= cfg->p1_prime_bound
+                       && entry->p1_nbits_bound >= cfg->p1_nbits_bound)) {
+        if (factor_p_plus_minus_one(modulus, &p, &q, stoi(cfg->p1_prime_bound), cfg->p1_nbits_bound)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        if (!stopped(cfg, res)) {
+          entry->p1_prime_bound = cfg->p1_prime_bound;
+          entry->p1_nbits_bound = cfg->p1_nbits_bound;
+          store(cfg, entry);
+        }
+      }
+      break;
+
+    /* Run 4p-1 attack, from the previous bound on the discriminants */
+    case ATTACK_CM:
+      if (cfg->disc != -1) {
+        if (factor_cm_anomalous_core(modulus, -cfg->disc, &p, &q)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        stopped(cfg, res);
+      }
+      else if (!cached(cfg, entry->cm_disc_bound >= cfg->cm_disc_bound)) {
+        if (factor_cm_anomalous_range(modulus, &p, &q, entry->cm_disc_bound, cfg->cm_disc_bound)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        entry->cm_disc_bound = stopped(cfg, res) ? deadline_reached(NULL) : cfg->cm_disc_bound;
+        store(cfg, entry);
+      }
+      break;
+
+    /* Run quadratic sieve (200 < n < 2^350 by default in config.h) */
+    case ATTACK_SIQS:
+      modulus_nbits = logint(modulus, gen_2) + 1;
+      if (modulus_nbits > SIQS_NBITS_BOUND || modulus_nbits <= SMALL_MODULUS_NBITS_BOUND) {
+        if (!cfg->quiet || verb) {
+          fprintf(stderr, "    Skipped: modulus is too %s (%ld bits)\n",
+                  modulus_nbits > SIQS_NBITS_BOUND ? "big" : "small", modulus_nbits);
+        }
+      }
+      else if (!cached(cfg, entry->flags & CACHE_SIQS)) {
+        if (factor_siqs(modulus, &p, &q, cfg->siqs_fb_size, cfg->siqs_block_size, cfg->threads)) {
+          return success(cfg, entry, res, ATTACK_NAMES[id], p, q, NULL);
+        }
+        if (!stopped(cfg, res)) {
+          entry->flags |= CACHE_SIQS;
+          store(cfg, entry);
+        }
+      }
+      break;
+  }
+
+  return FALSE;
+}
+
+/*
+ * Run the attacks on a single modulus.
+ * The public exponent e and the private exponent d can be NULL.
+ * Returns TRUE if the modulus is factored, then res->p and res->q are set
+ * (and res->d if the attack recovered the private exponent).
+ * If the Wiener attack recovers d but not the factors, res->d is set.
+ *
+ * With cfg->plan, the attacks are ordered and pruned by the planner,
+ * otherwise they run in the fixed order of ATTACK_*.
+ * Each attack runs until its time budget or the global timeout,
+ * then res->timeout is set.
+ * With a result cache, a factored modulus is not attacked again.
+ * With a seed in the context, each attack draws from its own random stream.
+ * No garbage cleaning: the results are left on the stack.
+ */
+int run_single(const single_cfg_t *cfg, GEN modulus, GEN e, GEN d, single_res_t *res) {
+  GEN p, q;
+  int i, id, found = FALSE;
+  double now, end;
+  uint64_t e_key = cache_exponent_key(e);
+  cache_slot_t entry;
+  attack_plan_t plan;
+  stats_t st;
+
+  res->found = FALSE;
+  res->timeout = FALSE;
+  res->attack = NULL;
+  res->p = res->q = res->d = NULL;
+
+  memset(&entry, 0, sizeof(entry));
+  if (cfg->cache != NULL && cache_lookup(cfg->cache, modulus, &entry)) {
+    if (entry.p_len > 0) {
+      p = int_from_bytes(entry.p, entry.p_len);
+      if (signe(p) && !equali1(p) && dvdii(modulus, p)) {
+        header(cfg, "[x] Modulus already factored (result cache)");
+        res->found = TRUE;
+        res->attack = cached_attack(entry.attack);
+        res->p = p;
+        res->q = diviiexact(modulus, p);
+        return TRUE;
+      }
+    }
+    if (entry.e_key != e_key) {
+      /* Attacks with another public exponent */
+      entry.flags &= ~(CACHE_SMALL_D | CACHE_WIENER);
+    }
+  }
+  entry.e_key = e_key;
+
+  /* We run the prime factor recovery */
+  if (e != NULL && d != NULL) {
+    header(cfg, "[x] Prime factor recovery...");
+    stats_begin(&st, "prime_factor_recovery", modulus);
+    trace_begin("prime_factor_recovery");
+    seed_attack(modulus, ATTACK_COUNT);
+    found = prime_factor_recovery(modulus, e, d, PRIME_RECOVERY_MAX_ITER, &p, &q);
+    trace_end();
+    stats_end(&st, found);
+    if (found) {
+      return success(cfg, &entry, res, "prime_factor_recovery", p, q, NULL);
+    }
+  }
+
+  plan_attacks(cfg, modulus, e, &plan);
+  if (verb) {
+    plan_print(cfg, &plan);
+  }
+
+  end = cfg->timeout > 0 ? wall_clock() + cfg->timeout : 0;
+  for (i = 0; !found && i < plan.n; i++) {
+    id = plan.order[i];
+    now = wall_clock();
+    if (end > 0 && now >= end) {
+      header(cfg, "[!] Timeout reached, the remaining attacks are skipped");
+      res->timeout = TRUE;
+      break;
+    }
+    deadline_start(deadline_min(cfg->budget > 0 ? now + cfg->budget : 0, end));
+    stats_begin(&st, ATTACK_NAMES[id], modulus);
+    trace_begin(ATTACK_NAMES[id]);
+    seed_attack(modulus, id);
+    found = run_attack(id, cfg, modulus, e, &entry, res);
+    trace_end();
+    stats_end(&st, found);
+  }
+  deadline_start(0);
+
+  return found;
+}
@@ -20,6 +20,7 @@ int factor_shared_lsb(GEN modulus, GEN *p, GEN *q) {
   roots = sqrt_mod2(modulus, u);
   if (roots != NULL) {
     for(i = 1; i <= 4; i++) {
+      stats_iter();
       m = gsqr(gel(roots, i));
       m = gsub(m, modulus);
       m = shifti(m, -u);
@@ -0,0 +1,706 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <limits.h>
+#include <math.h>
+#include "rsa.h"
+
+/*
+ * Self-initialising quadratic sieve (SIQS), for moduli of 200 to 350 bits.
+ * With a multiplier k chosen by the Knuth-Schroeppel function, the factor base
+ * holds -1, 2 and the primes p such that kn is a square mod p.
+ * A polynomial is g(x) = A x^2 + 2 B x + C with A = q_1...q_s a product of
+ * primes of the factor base close to sqrt(2kn)/M, B^2 = kn mod A and
+ * C = (B^2 - kn)/A, so that (A x + B)^2 = A g(x) mod n.
+ * The 2^(s-1) values of B = B_1 +/- ... +/- B_s of an A are enumerated in
+ * Gray code order: the roots of g mod p are then updated with one addition.
+ * g(x) is sieved over -M <= x < M by blocks which fit in the cache, with the
+ * logarithms of the primes, and the values above a threshold are trial divided.
+ * A relation is full if g(x) factors over the factor base, partial if the
+ * cofactor is less than SIQS_LARGE_PRIME_MULT times the largest prime:
+ * two partial relations with the same cofactor make one relation.
+ * The values of A are handed out to the workers by `parallel_range`, a worker
+ * sieves all the polynomials of its A. With more relations than primes,
+ * a product of relations which is a square is found by Gaussian elimination
+ * over GF(2), then X^2 = Y^2 mod n and gcd(X - Y, n) splits n.
+ * The memory of a worker is about 4 SIQS_MAX_A_FACTORS bytes per prime
+ * of the factor base plus a sieve block.
+ */
+
+/* Multipliers tested by the Knuth-Schroeppel function */
+static const long SIQS_MULTIPLIERS[] = {
+  1, 3, 5, 7, 11, 13, 15, 17, 19, 21, 23, 29, 31, 33, 35, 37, 39, 41, 43, 47
+};
+
+/* Size of the factor base and number of blocks of SIQS_BLOCK_SIZE bytes in [0, M), by size of kn */
+static const long SIQS_PARAMS[][3] = {
+  {140, 300, 1}, {160, 600, 1}, {180, 900, 1}, {200, 1200, 2}, {220, 2000, 2}, {240, 3000, 3},
+  {260, 4500, 4}, {280, 6000, 6}, {300, 8000, 8}, {320, 10000, 10}, {350, 14000, 12}
+};
+
+/* Relation (A x + B)^2 = A g(x) mod n, with A g(x) = large * primes of the factor base */
+typedef struct siqs_rel_s {
+  GENbin *x;                  /* A x + B mod n */
+  long id;                    /* index in the vector of the values A x + B */
+  ulong large;                /* cofactor, 1 for a full relation */
+  int nfactors;
+  int *factors;               /* indices in the factor base with multiplicity, 0 for -1 */
+  struct siqs_rel_s *next;    /* partial relations of the same bucket */
+  struct siqs_rel_s *all;     /* all the relations */
+} siqs_rel_t;
+
+/* Column of the matrix: a full relation, or two partial relations with the same cofactor */
+typedef struct {
+  siqs_rel_t *a, *b;
+} siqs_col_t;
+
+typedef struct {
+  GEN n, kn;
+  long nfb;                   /* factor base at indices 1 to nfb, 0 is -1 */
+  uint32_t *p, *t;            /* primes and square roots of kn mod p */
+  unsigned char *logp;
+  long first;                 /* first prime sieved, the smaller ones are trial divided */
+  long a_lo, a_hi;            /* range of the factors of A */
+  double a_log, a_log1;       /* log of the target value of A, and where its random choice stops */
+  long m, block;              /* interval [-m, m), sieved by blocks */
+  unsigned char thresh;
+  ulong large_bound;
+  ulong seed;
+  long target;                /* number of relations needed */
+
+  /* Shared by the workers, under the lock */
+  pthread_mutex_t lock;
+  volatile int done;
+  siqs_rel_t *rels, **partials;
+  siqs_col_t *cols;
+  long ncols, cap, nfull, npartial, nrels;
+  uint64_t *used_a;           /* open addressing table of the hashes of the values of A */
+  long nused, cap_a;
+} siqs_t;
+
+/* State of a worker: the current polynomial and the roots of g mod p */
+typedef struct {
+  siqs_t *sq;
+  GEN n, kn, A, B, C;
+  GEN Bl[SIQS_MAX_A_FACTORS];
+  int sign[SIQS_MAX_A_FACTORS];
+  long q[SIQS_MAX_A_FACTORS], s;
+  uint32_t *soln1, *soln2;    /* roots of g mod p, shifted by M */
+  uint32_t *next1, *next2;    /* next positions to sieve */
+  uint32_t *bainv;            /* 2 B_l/A mod p at l*(nfb + 1) + i */
+  unsigned char *in_a, *sieve;
+  int *factors;
+} siqs_thread_t;
+
+/* Knuth-Schroeppel function: multiplier k maximizing the contribution of the small primes to kn */
+static long siqs_multiplier(GEN n) {
+  long nk = sizeof(SIQS_MULTIPLIERS)/sizeof(long), i, k, best = 0;
+  double score[sizeof(SIQS_MULTIPLIERS)/sizeof(long)];
+  ulong p, r, n8 = umodiu(n, 8);
+  forprime_t T;
+
+  for (i = 0; i < nk; i++) {
+    k = SIQS_MULTIPLIERS[i];
+    r = (k*n8) % 8;
+    score[i] = -0.5*log(k) + (r == 1 ? 2 : r == 5 ? 1 : 0.5)*log(2);
+  }
+  u_forprime_init(&T, 3, SIQS_MULTIPLIER_PRIME_BOUND);
+  while ((p = u_forprime_next(&T))) {
+    r = umodiu(n, p);
+    for (i = 0; i < nk; i++) {
+      k = SIQS_MULTIPLIERS[i];
+      if (k % p == 0) {
+        score[i] += log(p)/p;
+      }
+      else if (krouu(Fl_mul(k % p, r, p), p) == 1) {
+        score[i] += 2*log(p)/(p - 1);
+      }
+    }
+  }
+
+  for (i = 1; i < nk; i++) {
+    if (score[i] > score[best]) {
+      best = i;
+    }
+  }
+  return SIQS_MULTIPLIERS[best];
+}
+
+/* Factor base of nfb primes, FALSE if one of them divides n, then it is *f */
+static int siqs_factor_base(siqs_t *sq, long nfb, ulong *f) {
+  ulong p, r;
+  long i;
+  forprime_t T;
+
+  sq->nfb = nfb;
+  sq->p = malloc((nfb + 1)*sizeof(uint32_t));
+  sq->t = malloc((nfb + 1)*sizeof(uint32_t));
+  sq->logp = malloc(nfb + 1);
+  sq->p[0] = sq->t[0] = sq->logp[0] = 0;
+  sq->p[1] = 2;
+  sq->t[1] = 1;
+  sq->logp[1] = 1;
+
+  u_forprime_init(&T, 3, ULONG_MAX);
+  for (i = 2; i <= nfb; ) {
+    p = u_forprime_next(&T);
+    r = umodiu(sq->kn, p);
+    if (r == 0) {
+      if (umodiu(sq->n, p) == 0) {
+        *f = p;
+        return FALSE;
+      }
+      /* p divides the multiplier */
+      continue;
+    }
+    if (krouu(r, p) == 1) {
+      sq->p[i] = p;
+      sq->t[i] = Fl_sqrt(r, p);
+      sq->logp[i] = (unsigned char)(log2(p) + 0.5);
+      i++;
+    }
+  }
+  return TRUE;
+}
+
+/* Default size of the factor base and number of blocks in [0, M) for kn of nbits bits */
+static void siqs_params(long nbits, long *nfb, long *nblocks) {
+  long i, n = sizeof(SIQS_PARAMS)/sizeof(SIQS_PARAMS[0]);
+
+  for (i = 0; i < n - 1 && SIQS_PARAMS[i][0] < nbits; i++);
+  *nfb = SIQS_PARAMS[i][1];
+  *nblocks = SIQS_PARAMS[i][2];
+}
+
+/* Sieve interval, range of the factors of A and threshold, once the factor base is known */
+static void siqs_setup(siqs_t *sq, long nblocks, long block) {
+  double lg_kn = expi(sq->kn) + 0.5, thresh;
+
+  sq->block = block;
+  sq->m = (nblocks*SIQS_BLOCK_SIZE + block - 1)/block*block;
+
+  for (sq->first = 2; sq->first < sq->nfb && sq->p[sq->first] < SIQS_SMALL_PRIME; sq->first++);
+
+  /* Factors of A of about 2000, or any sieved prime for a small factor base */
+  for (sq->a_lo = sq->first; sq->a_lo < sq->nfb && sq->p[sq->a_lo] < SIQS_A_PRIME_MIN; sq->a_lo++);
+  for (sq->a_hi = sq->a_lo; sq->a_hi < sq->nfb && sq->p[sq->a_hi + 1] <= SIQS_A_PRIME_MAX; sq->a_hi++);
+  if (sq->a_hi - sq->a_lo < 20) {
+    sq->a_lo = sq->first;
+    sq->a_hi = sq->nfb;
+  }
+  /* A ~ sqrt(2 kn)/M, the last factor is drawn once the product is within an average factor */
+  sq->a_log = 0.5*(lg_kn + 1)*log(2) - log(sq->m);
+  sq->a_log1 = sq->a_log - 0.5*log((sq->p[sq->a_lo] + sq->p[sq->a_hi])/2.);
+
+  /*
+   * |g(x)| < M sqrt(kn/2): the values whose cofactor is less than the large prime
+   * bound are above the threshold, with a margin for the primes which are not sieved
+   */
+  sq->large_bound = (ulong)sq->p[sq->nfb]*SIQS_LARGE_PRIME_MULT;
+  thresh = log2(sq->m) + (lg_kn - 1)/2 - log2(sq->large_bound) - SIQS_THRESHOLD_SLACK;
+  sq->thresh = thresh < 1 ? 1 : (unsigned char)thresh;
+  sq->target = sq->nfb + SIQS_EXTRA_RELATIONS;
+}
+
+/* State of a worker, on its own stack */
+static void *siqs_init(void *arg) {
+  siqs_t *sq = arg;
+  siqs_thread_t *th = (siqs_thread_t *)stack_malloc(sizeof(siqs_thread_t));
+  long nfb = sq->nfb + 1;
+
+  memset(th, 0, sizeof(*th));
+  th->sq = sq;
+  th->n = icopy(sq->n);
+  th->kn = icopy(sq->kn);
+  th->soln1 = (uint32_t *)stack_malloc(nfb*sizeof(uint32_t));
+  th->soln2 = (uint32_t *)stack_malloc(nfb*sizeof(uint32_t));
+  th->next1 = (uint32_t *)stack_malloc(nfb*sizeof(uint32_t));
+  th->next2 = (uint32_t *)stack_malloc(nfb*sizeof(uint32_t));
+  th->bainv = (uint32_t *)stack_malloc(SIQS_MAX_A_FACTORS*nfb*sizeof(uint32_t));
+  th->in_a = (unsigned char *)stack_malloc(nfb);
+  th->sieve = (unsigned char *)stack_malloc(sq->block);
+  th->factors = (int *)stack_malloc(SIQS_MAX_FACTORS*sizeof(int));
+  memset(th->in_a, 0, nfb);
+
+  return th;
+}
+
+/* TRUE if A was not used yet, then it is recorded */
+static int siqs_new_a(siqs_t *sq, GEN A) {
+  uint64_t h = int_hash(A, 0) | 1, *old;
+  long i, j, cap;
+  int found;
+
+  pthread_mutex_lock(&sq->lock);
+  if (2*(sq->nused + 1) > sq->cap_a) {
+    old = sq->used_a;
+    cap = sq->cap_a;
+    sq->cap_a = cap > 0 ? 2*cap : 1024;
+    sq->used_a = calloc(sq->cap_a, sizeof(uint64_t));
+    for (i = 0; i < cap; i++) {
+      if (old[i] != 0) {
+        for (j = old[i] & (sq->cap_a - 1); sq->used_a[j] != 0; j = (j + 1) & (sq->cap_a - 1));
+        sq->used_a[j] = old[i];
+      }
+    }
+    free(old);
+  }
+  for (j = h & (sq->cap_a - 1); sq->used_a[j] != 0 && sq->used_a[j] != h; j = (j + 1) & (sq->cap_a - 1));
+  found = sq->used_a[j] == h;
+  if (!found) {
+    sq->used_a[j] = h;
+    sq->nused++;
+  }
+  pthread_mutex_unlock(&sq->lock);
+
+  return !found;
+}
+
+/*
+ * Random A = q_1...q_s with log(A) close to sq->a_log (best of SIQS_A_TRIES draws),
+ * the values B_l and the roots of the first polynomial B = B_1 + ... + B_s.
+ * FALSE if A was already used.
+ */
+static int siqs_poly_a(siqs_thread_t *th) {
+  siqs_t *sq = th->sq;
+  long best[SIQS_MAX_A_FACTORS], cur[SIQS_MAX_A_FACTORS], nbest = 0, ncur, i, j, l, span;
+  double lg, ratio, best_ratio = 0, min_ratio = log(0.9);
+  ulong p, q, gamma, ainv, bm;
+  uint32_t *bainv;
+
+  span = sq->a_hi - sq->a_lo + 1;
+  for (j = 0; j < SIQS_A_TRIES; j++) {
+    ncur = 0;
+    lg = 0;
+    while ((ncur == 0 || lg < sq->a_log1) && ncur < SIQS_MAX_A_FACTORS && ncur < span) {
+      i = sq->a_lo + random_Fl(span);
+      for (l = 0; l < ncur && cur[l] != i; l++);
+      if (l == ncur) {
+        cur[ncur++] = i;
+        lg += log(sq->p[i]);
+      }
+    }
+    /* Not much less than the target, and as close as possible */
+    ratio = lg - sq->a_log;
+    if (nbest == 0 || (ratio >= min_ratio && (best_ratio < min_ratio || ratio < best_ratio))
+        || (best_ratio < min_ratio && ratio > best_ratio)) {
+      memcpy(best, cur, ncur*sizeof(long));
+      nbest = ncur;
+      best_ratio = ratio;
+    }
+  }
+
+  th->s = nbest;
+  th->A = gen_1;
+  for (l = 0; l < th->s; l++) {
+    th->q[l] = best[l];
+    th->A = muliu(th->A, sq->p[best[l]]);
+  }
+  if (!siqs_new_a(sq, th->A)) {
+    return FALSE;
+  }
+
+  /* B_l = A/q_l (t/(A/q_l) mod q_l), so that B^2 = kn mod A */
+  th->B = gen_0;
+  for (l = 0; l < th->s; l++) {
+    q = sq->p[th->q[l]];
+    th->Bl[l] = diviuexact(th->A, q);
+    gamma = Fl_mul(sq->t[th->q[l]], Fl_inv(umodiu(th->Bl[l], q), q), q);
+    if (gamma > q/2) {
+      gamma = q - gamma;
+    }
+    th->Bl[l] = muliu(th->Bl[l], gamma);
+    th->sign[l] = 1;
+    th->B = addii(th->B, th->Bl[l]);
+    th->in_a[th->q[l]] = TRUE;
+  }
+
+  /* Roots (-B +/- t)/A + M mod p */
+  for (i = 2; i <= sq->nfb; i++) {
+    if (th->in_a[i]) {
+      continue;
+    }
+    p = sq->p[i];
+    ainv = Fl_inv(umodiu(th->A, p), p);
+    bm = umodiu(th->B, p);
+    for (l = 0; l < th->s; l++) {
+      bainv = th->bainv + l*(sq->nfb + 1);
+      bainv[i] = Fl_mul(Fl_double(umodiu(th->Bl[l], p), p), ainv, p);
+    }
+    th->soln1[i] = Fl_add(Fl_mul(ainv, Fl_sub(sq->t[i], bm, p), p), sq->m % p, p);
+    th->soln2[i] = Fl_add(Fl_mul(ainv, Fl_sub(Fl_neg(sq->t[i], p), bm, p), p), sq->m % p, p);
+  }
+  return TRUE;
+}
+
+/*
+ * Polynomial j > 0 in Gray code order: the sign of B_v changes, with v the lowest bit of j.
+ * If B_v was positive, B decreases by 2 B_v and the roots increase by 2 B_v/A.
+ */
+static void siqs_next_b(siqs_thread_t *th, long j) {
+  siqs_t *sq = th->sq;
+  long i, v = vals(j);
+  uint32_t *bainv = th->bainv + v*(sq->nfb + 1);
+  ulong p;
+
+  if (th->sign[v] > 0) {
+    th->B = subii(th->B, shifti(th->Bl[v], 1));
+    for (i = 2; i <= sq->nfb; i++) {
+      if (!th->in_a[i]) {
+        p = sq->p[i];
+        th->soln1[i] = Fl_add(th->soln1[i], bainv[i], p);
+        th->soln2[i] = Fl_add(th->soln2[i], bainv[i], p);
+      }
+    }
+  }
+  else {
+    th->B = addii(th->B, shifti(th->Bl[v], 1));
+    for (i = 2; i <= sq->nfb; i++) {
+      if (!th->in_a[i]) {
+        p = sq->p[i];
+        th->soln1[i] = Fl_sub(th->soln1[i], bainv[i], p);
+        th->soln2[i] = Fl_sub(th->soln2[i], bainv[i], p);
+      }
+    }
+  }
+  th->sign[v] = -th->sign[v];
+}
+
+/* Logarithms of the primes dividing g(x) for start <= x + M < start + block */
+static void siqs_sieve_block(siqs_thread_t *th, long start) {
+  siqs_t *sq = th->sq;
+  unsigned char *sieve = th->sieve, lg;
+  uint32_t p, j, end = start + sq->block;
+  long i;
+
+  memset(sieve, 0, sq->block);
+  for (i = sq->first; i <= sq->nfb; i++) {
+    if (th->in_a[i]) {
+      continue;
+    }
+    p = sq->p[i];
+    lg = sq->logp[i];
+    for (j = th->next1[i]; j < end; j += p) {
+      sieve[j - start] += lg;
+    }
+    th->next1[i] = j;
+    for (j = th->next2[i]; j < end; j += p) {
+      sieve[j - start] += lg;
+    }
+    th->next2[i] = j;
+  }
+}
+
+/* Record a relation, and a column of the matrix if it is full or matches a partial relation */
+static void siqs_add(siqs_t *sq, GEN x, int *factors, int nfactors, ulong large) {
+  siqs_rel_t *rel = malloc(sizeof(siqs_rel_t)), *r;
+  siqs_col_t *col = NULL;
+  long h = large & (SIQS_PARTIAL_BUCKETS - 1), step;
+
+  rel->x = copy_bin(x);
+  rel->large = large;
+  rel->nfactors = nfactors;
+  rel->factors = malloc(nfactors*sizeof(int));
+  memcpy(rel->factors, factors, nfactors*sizeof(int));
+  rel->next = NULL;
+
+  pthread_mutex_lock(&sq->lock);
+  rel->all = sq->rels;
+  sq->rels = rel;
+  sq->nrels++;
+  if (sq->ncols == sq->cap) {
+    sq->cap = 2*sq->cap + 1024;
+    sq->cols = realloc(sq->cols, sq->cap*sizeof(siqs_col_t));
+  }
+  if (large == 1) {
+    col = &sq->cols[sq->ncols++];
+    col->a = rel;
+    col->b = NULL;
+    sq->nfull++;
+  }
+  else {
+    for (r = sq->partials[h]; r != NULL && r->large != large; r = r->next);
+    if (r != NULL) {
+      col = &sq->cols[sq->ncols++];
+      col->a = r;
+      col->b = rel;
+    }
+    else {
+      rel->next = sq->partials[h];
+      sq->partials[h] = rel;
+      sq->npartial++;
+    }
+  }
+  if (col != NULL) {
+    step = sq->target/10 > 0 ? sq->target/10 : 1;
+    if (verb && sq->ncols % step == 0) {
+      fprintf(stderr, "    %ld/%ld relations (%ld full), %ld partial relations\n",
+              sq->ncols, sq->target, sq->nfull, sq->npartial);
+    }
+    if (sq->ncols >= sq->target) {
+      sq->done = TRUE;
+    }
+  }
+  pthread_mutex_unlock(&sq->lock);
+}
+
+/* Trial division of A g(x) for the index idx = x + M of the sieve */
+static void siqs_candidate(siqs_thread_t *th, long idx) {
+  siqs_t *sq = th->sq;
+  GEN g;
+  long i, e, xi = idx - sq->m;
+  int nf = 0;
+  ulong p, r;
+  pari_sp av = avma;
+
+  g = addii(mulis(addii(mulis(th->A, xi), shifti(th->B, 1)), xi), th->C);
+  if (signe(g) == 0) {
+    return;
+  }
+  if (signe(g) < 0) {
+    th->factors[nf++] = 0;
+    g = negi(g);
+  }
+  e = vali(g);
+  g = shifti(g, -e);
+  for (; e > 0 && nf < SIQS_MAX_FACTORS; e--) {
+    th->factors[nf++] = 1;
+  }
+
+  for (i = 2; i <= sq->nfb; i++) {
+    p = sq->p[i];
+    if (i < sq->first || th->in_a[i]) {
+      if (umodiu(g, p) != 0) {
+        continue;
+      }
+    }
+    else {
+      r = idx % p;
+      if (r != th->soln1[i] && r != th->soln2[i]) {
+        continue;
+      }
+    }
+    for (e = Z_lvalrem(g, p, &g); e > 0 && nf < SIQS_MAX_FACTORS; e--) {
+      th->factors[nf++] = i;
+    }
+  }
+  for (i = 0; i < th->s && nf < SIQS_MAX_FACTORS; i++) {
+    th->factors[nf++] = th->q[i];
+  }
+
+  if (nf < SIQS_MAX_FACTORS && lgefint(g) <= 3 && cmpiu(g, sq->large_bound) < 0) {
+    siqs_add(sq, modii(addii(mulis(th->A, xi), th->B), th->n), th->factors, nf, itou(g));
+  }
+  avma = av;
+}
+
+/* Sieve the polynomials of the A of index `index`, not NULL once there are enough relations */
+static GEN siqs_run(long index, void *state) {
+  siqs_thread_t *th = state;
+  siqs_t *sq = th->sq;
+  unsigned char *sieve = th->sieve;
+  long i, j, l, start, npoly;
+  pari_sp av;
+
+  if (sq->done) {
+    return gen_1;
+  }
+  /* A only depends on the seed and its index */
+  setrand(utoi(seed_derive(sq->seed, index)));
+  if (!siqs_poly_a(th)) {
+    return NULL;
+  }
+
+  trace_begin("sieve");
+  av = avma;
+  npoly = 1L << (th->s - 1);
+  for (j = 0; j < npoly && !sq->done; j++) {
+    if (j > 0) {
+      siqs_next_b(th, j);
+    }
+    th->B = gerepilecopy(av, th->B);
+    th->C = diviiexact(subii(sqri(th->B), th->kn), th->A);
+    memcpy(th->next1, th->soln1, (sq->nfb + 1)*sizeof(uint32_t));
+    memcpy(th->next2, th->soln2, (sq->nfb + 1)*sizeof(uint32_t));
+
+    for (start = 0; start < 2*sq->m; start += sq->block) {
+      siqs_sieve_block(th, start);
+      for (i = 0; i < sq->block; i++) {
+        if (sieve[i] >= sq->thresh) {
+          siqs_candidate(th, start + i);
+        }
+      }
+    }
+    if (deadline_check()) {
+      break;
+    }
+  }
+  trace_end();
+
+  for (l = 0; l < th->s; l++) {
+    th->in_a[th->q[l]] = FALSE;
+  }
+  return sq->done ? gen_1 : NULL;
+}
+
+/* Square root step on the dependencies between the relations, TRUE if n is split */
+static int siqs_solve(siqs_t *sq, GEN *p, GEN *q) {
+  GEN xs, mat, col, K, v, X, Y, g;
+  long i, j, c, l, nrows = sq->nfb + 1, *exps;
+  siqs_rel_t *rel, *pair[2];
+  int found = FALSE;
+  pari_sp av;
+
+  /* Values A x + B of the relations, copied from the workers */
+  xs = cgetg(sq->nrels + 1, t_VEC);
+  for (rel = sq->rels, i = 1; rel != NULL; rel = rel->all, i++) {
+    rel->id = i;
+    gel(xs, i) = bin_copy(rel->x);
+    rel->x = NULL;
+  }
+
+  /* Exponents mod 2 of -1 and of the primes of the factor base, one column per relation */
+  mat = cgetg(sq->ncols + 1, t_MAT);
+  for (j = 0; j < sq->ncols; j++) {
+    col = zero_F2v(nrows);
+    pair[0] = sq->cols[j].a;
+    pair[1] = sq->cols[j].b;
+    for (l = 0; l < 2 && pair[l] != NULL; l++) {
+      for (i = 0; i < pair[l]->nfactors; i++) {
+        F2v_flip(col, pair[l]->factors[i] + 1);
+      }
+    }
+    gel(mat, j + 1) = col;
+  }
+  if (verb) {
+    fprintf(stderr, "    Linear algebra on %ld relations and %ld primes\n", sq->ncols, nrows);
+  }
+  trace_begin("linear_algebra");
+  K = F2m_ker(mat);
+  trace_end();
+
+  /* X = product of the A x + B, Y = square root of the product of the A g(x) */
+  trace_begin("square_root");
+  exps = (long *)stack_malloc(nrows*sizeof(long));
+  av = avma;
+  for (c = 1; c < lg(K) && !found; c++) {
+    v = gel(K, c);
+    X = Y = gen_1;
+    memset(exps, 0, nrows*sizeof(long));
+    for (j = 0; j < sq->ncols; j++) {
+      if (!F2v_coeff(v, j + 1)) {
+        continue;
+      }
+      pair[0] = sq->cols[j].a;
+      pair[1] = sq->cols[j].b;
+      for (l = 0; l < 2 && pair[l] != NULL; l++) {
+        X = Fp_mul(X, gel(xs, pair[l]->id), sq->n);
+        for (i = 0; i < pair[l]->nfactors; i++) {
+          exps[pair[l]->factors[i]]++;
+        }
+      }
+      if (pair[1] != NULL) {
+        Y = Fp_mul(Y, utoi(pair[0]->large), sq->n);
+      }
+    }
+    for (i = 1; i < nrows; i++) {
+      if (exps[i] > 0) {
+        Y = Fp_mul(Y, Fp_powu(utoi(sq->p[i]), exps[i]/2, sq->n), sq->n);
+      }
+    }
+    g = gcdii(subii(X, Y), sq->n);
+    stats_gcd();
+    if (!equali1(g) && !equalii(g, sq->n)) {
+      *p = g;
+      *q = diviiexact(sq->n, g);
+      found = TRUE;
+    }
+    else {
+      avma = av;
+    }
+  }
+  trace_end();
+
+  if (verb) {
+    fprintf(stderr, "    %ld dependencies tested\n", c - 1);
+  }
+  return found;
+}
+
+static void siqs_free(siqs_t *sq) {
+  siqs_rel_t *rel, *next;
+
+  for (rel = sq->rels; rel != NULL; rel = next) {
+    next = rel->all;
+    free(rel->x);
+    free(rel->factors);
+    free(rel);
+  }
+  free(sq->partials);
+  free(sq->cols);
+  free(sq->used_a);
+  free(sq->p);
+  free(sq->t);
+  free(sq->logp);
+  pthread_mutex_destroy(&sq->lock);
+}
+
+/*
+ * Factor the modulus with the quadratic sieve and nthreads workers.
+ * The size of the factor base and the size of the sieve blocks in bytes
+ * are chosen from the size of the modulus if 0.
+ */
+int factor_siqs(GEN modulus, GEN *p, GEN *q, long fb_size, long block_size, int nthreads) {
+  siqs_t sq;
+  long k, nfb, nblocks;
+  ulong f;
+  int found = FALSE;
+  pari_sp av = avma;
+
+  memset(&sq, 0, sizeof(sq));
+  pthread_mutex_init(&sq.lock, NULL);
+  k = siqs_multiplier(modulus);
+  sq.n = modulus;
+  sq.kn = mulsi(k, modulus);
+  siqs_params(expi(sq.kn) + 1, &nfb, &nblocks);
+  nfb = fb_size > 0 ? fb_size : nfb;
+  block_size = block_size > 0 ? block_size : SIQS_BLOCK_SIZE;
+
+  if (!siqs_factor_base(&sq, nfb, &f)) {
+    *p = utoi(f);
+    *q = diviuexact(modulus, f);
+    found = TRUE;
+  }
+  else {
+    siqs_setup(&sq, nblocks, block_size);
+    sq.seed = pari_rand();
+    sq.partials = calloc(SIQS_PARTIAL_BUCKETS, sizeof(siqs_rel_t *));
+    if (verb) {
+      fprintf(stderr, "    Multiplier k = %ld, factor base of %ld primes up to %u, sieve interval of 2*%ld\n"
+                      "    by blocks of %ld bytes, with %d threads\n"
+                      "    The sizes can be changed with the `--siqs-fb` and `--siqs-block` options\n",
+              k, sq.nfb, sq.p[sq.nfb], sq.m, sq.block, nthreads);
+    }
+
+    parallel_range(0, SIQS_A_MAX, nthreads, siqs_init, siqs_run, &sq, "polynomials A");
+    if (sq.done) {
+      found = siqs_solve(&sq, p, q);
+    }
+    else if (deadline_expired()) {
+      deadline_progress("relations", sq.ncols);
+    }
+  }
+  siqs_free(&sq);
+
+  /* Garbage cleaning */
+  if (found) {
+    gerepileall(av, 2, p, q);
+  }
+  else {
+    avma = av;
+  }
+
+  return found;
+}
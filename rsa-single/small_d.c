@@ -41,6 +41,7 @@ void gauss_reduction(GEN a, GEN b, GEN c, GEN d,
   *v1 = c;
   *v2 = d;
   while (TRUE) {
+    stats_iter();
     m = gadd(gmul(*u1, *v1), gmul(*u2, *v2));
     u_norm = gadd(gsqr(*u1), gsqr(*u2));
     m = gdivent(m, u_norm);
@@ -0,0 +1,81 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Precomputed tables of rsa_single, kept by the long-running modes
+ * (streaming and daemon) for all the keys:
+ *   - the Hilbert class polynomials of the discriminants -3, -7, -11, ...
+ *     used by factor_cm,
+ *   - the prime powers l^(b/log2(l)) of the smooth exponent of factor_p_pm_1.
+ * The tables are built by the main thread before the workers start,
+ * as clones outside of the PARI stacks, and are only read afterwards.
+ * An attack with other bounds computes its values as usual.
+ */
+
+static GEN polclass_table = NULL;   /* polclass_table[i] for the discriminant -3 - 4*(i - 1) */
+static GEN powers_table = NULL;     /* prime powers in the order of the primes */
+static long powers_prime_bound = 0, powers_nbits_bound = 0;
+
+/* Tables for the discriminants -disc_bound < D <= -3 and the bounds of p-1 and p+1 */
+void tables_init(long disc_bound, long prime_bound, long nbits_bound) {
+  GEN v, pp;
+  long i, n;
+  forprime_t T;
+  pari_sp av = avma;
+
+  n = disc_bound > 0 ? disc_bound/4 : 0;
+  v = cgetg(n + 1, t_VEC);
+  for (i = 1; i <= n; i++) {
+    gel(v, i) = polclass(stoi(-3 - 4*(i - 1)), 0, -1);
+  }
+  polclass_table = gclone(v);
+  avma = av;
+
+  v = cgetg(uprimepi(prime_bound) + 1, t_VEC);
+  forprime_init(&T, gen_2, stoi(prime_bound));
+  for (i = 1; (pp = forprime_next(&T)) != NULL; i++) {
+    gel(v, i) = powiu(pp, nbits_bound/logint(pp, gen_2));
+  }
+  setlg(v, i);
+  powers_table = gclone(v);
+  powers_prime_bound = prime_bound;
+  powers_nbits_bound = nbits_bound;
+  avma = av;
+
+  if (verb) {
+    fprintf(stderr, "[!] Tables: %ld class polynomials, %ld prime powers\n", n, i - 1);
+  }
+}
+
+void tables_close() {
+  if (polclass_table != NULL) {
+    gunclone(polclass_table);
+    polclass_table = NULL;
+  }
+  if (powers_table != NULL) {
+    gunclone(powers_table);
+    powers_table = NULL;
+  }
+}
+
+/* Hilbert class polynomial of the discriminant disc < 0, NULL if not in the table */
+GEN table_polclass(long disc) {
+  long i = (-disc - 3)/4 + 1;
+
+  if (polclass_table == NULL || disc > -3 || (-disc - 3) % 4 != 0 || i >= lg(polclass_table)) {
+    return NULL;
+  }
+  return gel(polclass_table, i);
+}
+
+/* Prime powers of p-1 and p+1 for these bounds, NULL if not in the table */
+GEN table_prime_powers(GEN prime_bound, long nbits_bound) {
+  if (powers_table == NULL || nbits_bound != powers_nbits_bound || cmpis(prime_bound, powers_prime_bound)) {
+    return NULL;
+  }
+  return powers_table;
+}
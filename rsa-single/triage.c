@@ -0,0 +1,245 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Triage pass of the streaming mode (rsa_single --triage), to route the keys
+ * of a large corpus to the attacks which may work on them:
+ *   - the residues of n modulo the odd primes less than TRIAGE_PRIME_BOUND
+ *     give its tiny factors, and modulo 64, 63, 65 and 11 they rule out
+ *     almost all the non-squares before the square test,
+ *   - n = 1 mod 2^k with k >= TRIAGE_LSB_BITS suggests factor_shared_lsb,
+ *   - e > n^(3/4)/2 is needed for a private exponent d < n^(1/4),
+ *   - Fermat and p-1/p+1 with tiny bounds catch the worst keys,
+ *   - the size of n tells if factor_small or factor_siqs apply.
+ * The residues are computed for all the moduli at once, 16 bits of n at a
+ * time, with a Barrett reduction: a loop over arrays of 32-bit words without
+ * division nor branch, which the compiler can vectorize.
+ */
+
+/* Names of the flags and attacks they route to (bits 1 << ATTACK_*), indexed by bit */
+static const char *TRIAGE_NAMES[TRIAGE_COUNT] = {
+  "square", "tiny_factor", "shared_lsb", "large_e",
+  "close_primes", "smooth_p_pm_1", "small_modulus", "siqs"
+};
+
+static const int TRIAGE_ROUTES[TRIAGE_COUNT] = {
+  1 << ATTACK_SQUARE, 0, 1 << ATTACK_SHARED_LSB, (1 << ATTACK_SMALL_D) | (1 << ATTACK_WIENER),
+  1 << ATTACK_FERMAT, 1 << ATTACK_P_PM_1, 1 << ATTACK_SMALL, 1 << ATTACK_SIQS
+};
+
+/* Square filter 63*65*11 in the first lane, then the odd primes */
+#define TRIAGE_SQUARE_MOD 45045
+
+static long nlanes = 0;
+static uint32_t *lane_mod = NULL, *lane_inv = NULL;   /* m and floor(2^32/m) */
+static char square_mod64[64], square_mod63[63], square_mod65[65], square_mod11[11];
+
+/* Tables of the moduli, built by the main thread before the workers start */
+void triage_init() {
+  ulong p;
+  long i;
+  forprime_t T;
+
+  nlanes = uprimepi(TRIAGE_PRIME_BOUND);
+  lane_mod = malloc(nlanes*sizeof(uint32_t));
+  lane_inv = malloc(nlanes*sizeof(uint32_t));
+  lane_mod[0] = TRIAGE_SQUARE_MOD;
+  u_forprime_init(&T, 3, TRIAGE_PRIME_BOUND - 1);
+  for (i = 1; (p = u_forprime_next(&T)); i++) {
+    lane_mod[i] = p;
+  }
+  nlanes = i;
+  for (i = 0; i < nlanes; i++) {
+    lane_inv[i] = (1ULL << 32)/lane_mod[i];
+  }
+
+  memset(square_mod64, 0, sizeof(square_mod64));
+  memset(square_mod63, 0, sizeof(square_mod63));
+  memset(square_mod65, 0, sizeof(square_mod65));
+  memset(square_mod11, 0, sizeof(square_mod11));
+  for (i = 0; i < 65; i++) {
+    square_mod64[(i*i) % 64] = TRUE;
+    square_mod63[(i*i) % 63] = TRUE;
+    square_mod65[(i*i) % 65] = TRUE;
+    square_mod11[(i*i) % 11] = TRUE;
+  }
+}
+
+void triage_close() {
+  free(lane_mod);
+  free(lane_inv);
+  lane_mod = lane_inv = NULL;
+  nlanes = 0;
+}
+
+/*
+ * r[j] = n mod lane_mod[j], from the most significant 16 bits of n.
+ * With m < 2^16 and x = r*2^16 + c < 2^32, q = x*floor(2^32/m)/2^32 is
+ * floor(x/m) or floor(x/m) - 1, then x - q*m < 2m.
+ */
+static void triage_residues(GEN n, uint32_t *r) {
+  long i, j, b, nw = lgefint(n) - 2;
+  uint32_t x, c;
+  ulong w;
+
+  memset(r, 0, nlanes*sizeof(uint32_t));
+  for (i = nw - 1; i >= 0; i--) {
+    w = *int_W(n, i);
+    for (b = BITS_IN_LONG - 16; b >= 0; b -= 16) {
+      c = (w >> b) & 0xffff;
+      for (j = 0; j < nlanes; j++) {
+        x = r[j] << 16 | c;
+        x -= (uint32_t)(((uint64_t)x*lane_inv[j]) >> 32)*lane_mod[j];
+        r[j] = x >= lane_mod[j] ? x - lane_mod[j] : x;
+      }
+    }
+  }
+}
+
+/*
+ * Cheap checks on (modulus, e), e can be NULL.
+ * Returns TRUE if one of them factored the modulus, then t->p and t->q are set.
+ */
+int triage_key(GEN modulus, GEN e, triage_t *t) {
+  GEN p, q;
+  uint32_t *r;
+  ulong low = *int_W(modulus, 0), f = 0;
+  long j;
+  int found = FALSE;
+  pari_sp av = avma;
+
+  memset(t, 0, sizeof(*t));
+  t->nbits = logint(modulus, gen_2) + 1;
+  t->ebits = e != NULL && signe(e) > 0 ? logint(e, gen_2) + 1 : 0;
+
+  r = (uint32_t *)stack_malloc(nlanes*sizeof(uint32_t));
+  triage_residues(modulus, r);
+
+  /* Tiny factors */
+  if (!(low & 1) && cmpiu(modulus, 2) > 0) {
+    f = 2;
+  }
+  for (j = 1; j < nlanes && f == 0; j++) {
+    if (r[j] == 0 && cmpiu(modulus, lane_mod[j]) > 0) {
+      f = lane_mod[j];
+    }
+  }
+  if (f != 0) {
+    t->flags |= TRIAGE_TINY_FACTOR;
+    t->attack = "trial_division";
+    t->p = utoi(f);
+    t->q = diviuexact(modulus, f);
+    found = TRUE;
+  }
+
+  /* Square test on the values which are squares modulo 64, 63, 65 and 11 */
+  if (square_mod64[low & 63] && square_mod63[r[0] % 63] && square_mod65[r[0] % 65]
+      && square_mod11[r[0] % 11] && Z_issquareall(modulus, &p)) {
+    t->flags |= TRIAGE_SQUARE;
+    if (!found) {
+      t->attack = ATTACK_NAMES[ATTACK_SQUARE];
+      t->p = p;
+      t->q = icopy(p);
+      found = TRUE;
+    }
+  }
+
+  t->lsb = (low & 1) ? vali(subiu(modulus, 1)) : 0;
+  if (t->lsb >= TRIAGE_LSB_BITS) {
+    t->flags |= TRIAGE_SHARED_LSB;
+  }
+  if (t->ebits > 0 && 4*t->ebits >= 3*t->nbits - 4) {
+    t->flags |= TRIAGE_LARGE_E;
+  }
+  if (t->nbits <= SMALL_MODULUS_NBITS_BOUND) {
+    t->flags |= TRIAGE_SMALL_MODULUS;
+  }
+  else if (t->nbits <= SIQS_NBITS_BOUND) {
+    t->flags |= TRIAGE_SIQS;
+  }
+
+  /* A few iterations of the attacks on the worst keys */
+  if (!found && factor_close_primes(modulus, &p, &q, TRIAGE_FERMAT_BOUND)) {
+    t->flags |= TRIAGE_CLOSE_PRIMES;
+    t->attack = ATTACK_NAMES[ATTACK_FERMAT];
+    t->p = p;
+    t->q = q;
+    found = TRUE;
+  }
+  if (!found) {
+    seed_attack(modulus, ATTACK_P_PM_1);
+    if (factor_p_plus_minus_one(modulus, &p, &q, utoi(TRIAGE_P1_PRIME_BOUND), TRIAGE_P1_NBITS_BOUND)) {
+      t->flags |= TRIAGE_SMOOTH;
+      t->attack = ATTACK_NAMES[ATTACK_P_PM_1];
+      t->p = p;
+      t->q = q;
+      found = TRUE;
+    }
+  }
+
+  /* Garbage cleaning */
+  if (found) {
+    gerepileall(av, 2, &t->p, &t->q);
+  }
+  else {
+    avma = av;
+  }
+
+  return found;
+}
+
+/*
+ * Result of the triage of a record as a JSON object:
+ * the flags and the attacks to run as comma-separated names (see `attack_set`),
+ * so that the line can be given back to the streaming mode. Without attacks to
+ * suggest, the field is omitted and all of them are run.
+ */
+char *triage_result(key_rec_t *rec, GEN modulus, GEN e, const triage_t *t) {
+  char *id, *out, *exponent, *factors, *routes, flags[256], attacks[256];
+  size_t nf = 0, na = 0;
+  int i, route = 0;
+
+  id = rec->id != NULL ? pari_sprintf("\"id\": \"%s\", ", rec->id) : pari_sprintf("");
+  if (rec->error != NULL || modulus == NULL) {
+    out = pari_sprintf("{%s\"line\": %ld, \"found\": false, \"error\": \"%s\"}",
+                       id, rec->line, rec->error != NULL ? rec->error : "PARI error");
+    pari_free(id);
+    return out;
+  }
+
+  flags[0] = attacks[0] = '\0';
+  for (i = 0; i < TRIAGE_COUNT; i++) {
+    if (t->flags & (1 << i)) {
+      nf += snprintf(flags + nf, sizeof(flags) - nf, "%s%s", nf > 0 ? "," : "", TRIAGE_NAMES[i]);
+      route |= TRIAGE_ROUTES[i];
+    }
+  }
+  for (i = 0; i < ATTACK_COUNT && t->attack == NULL; i++) {
+    if (route & (1 << i)) {
+      na += snprintf(attacks + na, sizeof(attacks) - na, "%s%s", na > 0 ? "," : "", ATTACK_NAMES[i]);
+    }
+  }
+
+  routes = na > 0 ? pari_sprintf(", \"attacks\": \"%s\"", attacks) : pari_sprintf("");
+  exponent = e != NULL ? pari_sprintf(", \"e\": \"%Ps\"", e) : pari_sprintf("");
+  if (t->attack != NULL) {
+    factors = pari_sprintf(", \"found\": true, \"attack\": \"%s\", \"p\": \"%Ps\", \"q\": \"%Ps\"",
+                           t->attack, t->p, t->q);
+  }
+  else {
+    factors = pari_sprintf(", \"found\": false");
+  }
+  out = pari_sprintf("{%s\"line\": %ld, \"n\": \"%Ps\"%s, \"nbits\": %ld, \"lsb\": %ld, "
+                     "\"flags\": \"%s\"%s%s}",
+                     id, rec->line, modulus, exponent, t->nbits, t->lsb, flags, routes, factors);
+  pari_free(factors);
+  pari_free(routes);
+  pari_free(exponent);
+  pari_free(id);
+
+  return out;
+}
@@ -21,6 +21,11 @@ GEN find_d_cvg(GEN modulus, GEN e) {
   cvg = contfracpnqn(cf, WIENER_MAX_CVG);
   ncvg = glength(cvg);
   for(i = 1; i <= ncvg; i++) {
+    if (deadline_check()) {
+      deadline_progress("convergent", i);
+      break;
+    }
+    stats_iter();
     dd = gcoeff(cvg, 2, i);
     /* Private exponent might be in the list of denominators */
     if (gequal(powgi(c, dd), m)) {
@@ -53,7 +58,9 @@ int factor_wiener(GEN modulus, GEN e, GEN *d, GEN *p, GEN *q) {
   *d = find_d_cvg(modulus, e);
 
   if (*d != NULL) {
-    pari_printf("D = %Ps\n", *d);
+    if (verb) {
+      pari_fprintf(stderr, "    Private exponent found: %Ps\n", *d);
+    }
     found = prime_factor_recovery(modulus, e, *d, PRIME_RECOVERY_MAX_ITER, p, q);
   }
 
@@ -0,0 +1,245 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * Checkpoint of a scan over k, in a small text file:
+ *   rsatools-checkpoint 1
+ *   key <fingerprint of the parameters of the scan>
+ *   seed <seed of the random generator>
+ *   gamma <best gamma of k_detect> <k of the best gamma>
+ *   range <start> <end>      (completed ranges start <= k < end)
+ * Several processes can share a checkpoint (each scanning its own range of k):
+ * a save merges the ranges of the file with its own, under a lock on FILE.lock,
+ * and the file is replaced atomically.
+ */
+
+#define CHECKPOINT_MAGIC "rsatools-checkpoint"
+#define CHECKPOINT_VERSION 1
+
+/* Insert [start, end) in the sorted list of disjoint ranges, merging the overlaps */
+static void add_range(checkpoint_t *ck, long start, long end) {
+  long i, j;
+
+  if (end <= start) {
+    return;
+  }
+  if (ck->nranges == ck->cap) {
+    ck->cap = ck->cap ? 2*ck->cap : 16;
+    ck->ranges = realloc(ck->ranges, 2*ck->cap*sizeof(long));
+  }
+
+  /* First range ending at or after start */
+  for (i = 0; i < ck->nranges && ck->ranges[2*i+1] < start; i++);
+  /* Ranges i..j-1 overlap or touch [start, end) */
+  for (j = i; j < ck->nranges && ck->ranges[2*j] <= end; j++) {
+    start = ck->ranges[2*j] < start ? ck->ranges[2*j] : start;
+    end = ck->ranges[2*j+1] > end ? ck->ranges[2*j+1] : end;
+  }
+  memmove(&ck->ranges[2*(i+1)], &ck->ranges[2*j], 2*(ck->nranges - j)*sizeof(long));
+  ck->nranges += 1 - (j - i);
+  ck->ranges[2*i] = start;
+  ck->ranges[2*i+1] = end;
+}
+
+/*
+ * Merge the content of the file into the checkpoint.
+ * Returns FALSE if the file belongs to another scan or is malformed.
+ */
+static int read_file(checkpoint_t *ck, FILE *fp) {
+  char word[32];
+  int version;
+  unsigned long key, seed;
+  long a, b;
+
+  if (fscanf(fp, "%31s %d", word, &version) != 2 || strcmp(word, CHECKPOINT_MAGIC)
+      || version != CHECKPOINT_VERSION) {
+    return FALSE;
+  }
+  if (fscanf(fp, " key %lx", &key) != 1 || key != ck->key) {
+    return FALSE;
+  }
+  if (fscanf(fp, " seed %lu", &seed) != 1) {
+    return FALSE;
+  }
+  ck->seed = seed;
+  if (fscanf(fp, " gamma %ld %ld", &a, &b) != 2) {
+    return FALSE;
+  }
+  if (a > ck->gamma_best) {
+    ck->gamma_best = a;
+    ck->k_best = b;
+  }
+  while (fscanf(fp, " range %ld %ld", &a, &b) == 2) {
+    add_range(ck, a, b);
+  }
+  return TRUE;
+}
+
+/* Replace the file atomically by the checkpoint, the lock must be held */
+static int write_file(const checkpoint_t *ck) {
+  FILE *fp;
+  char *tmp = malloc(strlen(ck->filename) + 5);
+  long i;
+  int ok;
+
+  sprintf(tmp, "%s.tmp", ck->filename);
+  fp = fopen(tmp, "w");
+  ok = fp != NULL;
+  if (ok) {
+    fprintf(fp, "%s %d\nkey %016lx\nseed %lu\ngamma %ld %ld\n", CHECKPOINT_MAGIC, CHECKPOINT_VERSION,
+            (unsigned long)ck->key, (unsigned long)ck->seed, ck->gamma_best, ck->k_best);
+    for (i = 0; i < ck->nranges; i++) {
+      fprintf(fp, "range %ld %ld\n", ck->ranges[2*i], ck->ranges[2*i+1]);
+    }
+    ok = !fflush(fp) && !fsync(fileno(fp));
+    ok = !fclose(fp) && ok && !rename(tmp, ck->filename);
+  }
+  if (!ok) {
+    fprintf(stderr, "[!] Cannot write the checkpoint %s\n", ck->filename);
+  }
+  free(tmp);
+  return ok;
+}
+
+static int lock_file(const checkpoint_t *ck) {
+  char *name = malloc(strlen(ck->filename) + 6);
+  int fd;
+
+  sprintf(name, "%s.lock", ck->filename);
+  fd = open(name, O_RDWR | O_CREAT, 0644);
+  free(name);
+  if (fd >= 0) {
+    flock(fd, LOCK_EX);
+  }
+  return fd;
+}
+
+static void unlock_file(int fd) {
+  if (fd >= 0) {
+    flock(fd, LOCK_UN);
+    close(fd);
+  }
+}
+
+/*
+ * Open the checkpoint of a scan identified by key.
+ * With resume, the state of the file (if any) is loaded,
+ * otherwise the file is checked and replaced by an empty checkpoint:
+ * the ranges of a previous scan are not merged by the next save.
+ * Returns FALSE if the file belongs to another scan.
+ */
+int checkpoint_open(checkpoint_t *ck, const char *filename, uint64_t key, ulong seed, int resume) {
+  FILE *fp;
+  checkpoint_t old;
+  int fd, ok = TRUE;
+
+  memset(ck, 0, sizeof(*ck));
+  ck->filename = filename;
+  ck->key = key;
+  ck->seed = seed;
+  ck->run_start = ck->run_end = -1;
+  ck->saved = wall_clock();
+
+  fd = lock_file(ck);
+  fp = fopen(filename, "r");
+  if (fp != NULL && resume) {
+    ok = read_file(ck, fp);
+    fclose(fp);
+  }
+  else if (fp != NULL) {
+    old = *ck;
+    ok = read_file(&old, fp);
+    free(old.ranges);
+    fclose(fp);
+  }
+  else if (resume) {
+    fprintf(stderr, "[!] No checkpoint in %s, starting a new scan\n", filename);
+  }
+
+  if (!ok) {
+    fprintf(stderr, "[!] %s is not a checkpoint of this scan\n", filename);
+  }
+  else if (!resume && fp != NULL) {
+    ok = write_file(ck);
+  }
+  unlock_file(fd);
+  return ok;
+}
+
+/* Save the checkpoint, merged with the current content of the file */
+int checkpoint_save(checkpoint_t *ck) {
+  FILE *fp;
+  int fd, ok;
+
+  if (ck->run_start >= 0) {
+    add_range(ck, ck->run_start, ck->run_end);
+    ck->run_start = ck->run_end = -1;
+  }
+
+  fd = lock_file(ck);
+  fp = fopen(ck->filename, "r");
+  if (fp != NULL) {
+    /* Progress of the other workers, the seed of this one is kept */
+    ulong seed = ck->seed;
+    read_file(ck, fp);
+    ck->seed = seed;
+    fclose(fp);
+  }
+
+  ok = write_file(ck);
+  unlock_file(fd);
+
+  ck->saved = wall_clock();
+  return ok;
+}
+
+/* First k' >= k which is not in a completed range */
+long checkpoint_skip(checkpoint_t *ck, long k) {
+  long i;
+
+  for (i = 0; i < ck->nranges; i++) {
+    if (ck->ranges[2*i] <= k && k < ck->ranges[2*i+1]) {
+      return ck->ranges[2*i+1];
+    }
+  }
+  return k;
+}
+
+/* Mark k as completed, the checkpoint is saved every CHECKPOINT_INTERVAL seconds */
+void checkpoint_done(checkpoint_t *ck, long k) {
+  if (ck->run_start >= 0 && k != ck->run_end) {
+    add_range(ck, ck->run_start, ck->run_end);
+    ck->run_start = -1;
+  }
+  if (ck->run_start < 0) {
+    ck->run_start = k;
+  }
+  ck->run_end = k + 1;
+
+  if (wall_clock() - ck->saved >= CHECKPOINT_INTERVAL) {
+    checkpoint_save(ck);
+  }
+}
+
+/* Record a candidate of k_detect */
+void checkpoint_gamma(checkpoint_t *ck, long gamma, long k) {
+  if (gamma > ck->gamma_best) {
+    ck->gamma_best = gamma;
+    ck->k_best = k;
+  }
+}
+
+/* Save and free the checkpoint */
+void checkpoint_close(checkpoint_t *ck) {
+  checkpoint_save(ck);
+  free(ck->ranges);
+  ck->ranges = NULL;
+  ck->nranges = ck->cap = 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Context of the attacks, so that they can be embedded in a multi-threaded
+ * program with the library librsatools.
+ * A context holds the verbosity, the attacks and their bounds, the seed of
+ * the random streams and a cancellation flag. A thread is attached to one
+ * context at a time (the default one, used by the programs, unless
+ * `rsa_ctx_attach` is called), and the threads started by an attack are
+ * attached to the context of their parent.
+ * The calling threads must be PARI threads (pari_init or pari_thread_start).
+ * The result cache, the statistics and the trace remain global to the process.
+ */
+
+/* Default context: its cfg is not used, the programs have their own */
+static rsa_ctx_t rsa_ctx_default = { .verbose = FALSE };
+
+__thread rsa_ctx_t *rsa_ctx_current = &rsa_ctx_default;
+
+/* Context with the default values of config.h */
+void rsa_ctx_init(rsa_ctx_t *ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+  single_cfg_init(&ctx->cfg);
+}
+
+/* Attach the current thread to ctx (NULL for the default context) */
+void rsa_ctx_attach(rsa_ctx_t *ctx) {
+  rsa_ctx_current = ctx != NULL ? ctx : &rsa_ctx_default;
+}
+
+/* Context of the current thread, to pass it to the threads it starts */
+rsa_ctx_t *rsa_ctx_get() {
+  return rsa_ctx_current;
+}
+
+/* Stop the attacks running with ctx, can be called from any thread */
+void rsa_ctx_cancel(rsa_ctx_t *ctx) {
+  __atomic_store_n(&ctx->cancelled, TRUE, __ATOMIC_RELAXED);
+}
+
+/* Clear the cancellation of ctx, before running new attacks with it */
+void rsa_ctx_reset(rsa_ctx_t *ctx) {
+  __atomic_store_n(&ctx->cancelled, FALSE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Run the attacks of ctx->cfg on (modulus, e) in the current thread (e can be NULL),
+ * the factors are on the PARI stack of the caller.
+ * Returns TRUE if the modulus is factored, res->timeout is set if it was cancelled.
+ * A cancelled context stops the attacks until `rsa_ctx_reset` is called.
+ */
+int rsa_ctx_factor(rsa_ctx_t *ctx, GEN modulus, GEN e, single_res_t *res) {
+  rsa_ctx_t *prev = rsa_ctx_current;
+  int found;
+
+  rsa_ctx_attach(ctx);
+  found = run_single(&ctx->cfg, modulus, e, NULL, res);
+  rsa_ctx_attach(prev);
+
+  return found;
+}
@@ -0,0 +1,155 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * Sharded scans: static shards (--shard i/N) and the client side of the
+ * coordinator `rsa_coord`, which hands out blocks of a range over a UNIX socket.
+ * The protocol is line based:
+ *   NEXT          -> RANGE <start> <end>, or STOP when the scan is over
+ *   DONE <s> <e>  the block [s, e) is completed (no reply)
+ *   FOUND <text>  the scan succeeded, the coordinator stops all the workers
+ *   WAIT          -> STOP when the scan is over
+ * A worker uses two connections: one for the blocks, and one where a thread
+ * waits for the end of the scan to interrupt the running attack.
+ */
+
+/* Parse "i/N" with 0 <= i < N */
+int shard_parse(const char *s, long *i, long *n) {
+  char *end;
+
+  *i = strtol(s, &end, 10);
+  if (end == s || *end != '/') {
+    return FALSE;
+  }
+  s = end + 1;
+  *n = strtol(s, &end, 10);
+  return end != s && *end == '\0' && *n > 0 && *i >= 0 && *i < *n;
+}
+
+/* Restrict [*start, *end) to the shard i out of n (contiguous, balanced) */
+void shard_range(long i, long n, long *start, long *end) {
+  long len = *end - *start, s = *start;
+
+  *start = s + (long)((double)len*i/n);
+  *end = s + (long)((double)len*(i + 1)/n);
+}
+
+static int send_line(int fd, const char *line) {
+  size_t len = strlen(line);
+  ssize_t w;
+
+  while (len > 0) {
+    w = send(fd, line, len, MSG_NOSIGNAL);
+    if (w <= 0) {
+      return FALSE;
+    }
+    line += w;
+    len -= w;
+  }
+  return TRUE;
+}
+
+/* Read a line (without the newline), FALSE on error or end of connection */
+static int read_line(int fd, char *buf, size_t size) {
+  size_t len = 0;
+  char ch;
+
+  while (read(fd, &ch, 1) == 1) {
+    if (ch == '\n') {
+      buf[len] = '\0';
+      return TRUE;
+    }
+    if (len + 1 < size) {
+      buf[len++] = ch;
+    }
+  }
+  return FALSE;
+}
+
+static int connect_socket(const char *path) {
+  struct sockaddr_un addr;
+  int fd;
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Wait for the end of the scan, then interrupt the attacks of the process */
+static void *watch_main(void *arg) {
+  coord_t *c = arg;
+  char buf[16];
+
+  if (send_line(c->watch_fd, "WAIT\n")) {
+    read_line(c->watch_fd, buf, sizeof(buf));
+  }
+  if (!c->closing) {
+    deadline_interrupt();
+  }
+  return NULL;
+}
+
+int coord_connect(coord_t *c, const char *path) {
+  memset(c, 0, sizeof(*c));
+  c->fd = connect_socket(path);
+  if (c->fd < 0) {
+    return FALSE;
+  }
+  c->watch_fd = connect_socket(path);
+  if (c->watch_fd < 0 || pthread_create(&c->watcher, NULL, watch_main, c)) {
+    if (c->watch_fd >= 0) {
+      close(c->watch_fd);
+    }
+    close(c->fd);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Next block [*start, *end), FALSE when the scan is over */
+int coord_next(coord_t *c, long *start, long *end) {
+  char buf[128];
+
+  if (deadline_expired() || !send_line(c->fd, "NEXT\n") || !read_line(c->fd, buf, sizeof(buf))) {
+    return FALSE;
+  }
+  return sscanf(buf, "RANGE %ld %ld", start, end) == 2;
+}
+
+void coord_done(coord_t *c, long start, long end) {
+  char buf[128];
+
+  snprintf(buf, sizeof(buf), "DONE %ld %ld\n", start, end);
+  send_line(c->fd, buf);
+}
+
+/* Report the success, result is a single line */
+void coord_found(coord_t *c, const char *result) {
+  send_line(c->fd, "FOUND ");
+  send_line(c->fd, result);
+  send_line(c->fd, "\n");
+}
+
+void coord_close(coord_t *c) {
+  c->closing = TRUE;
+  shutdown(c->watch_fd, SHUT_RDWR);
+  pthread_join(c->watcher, NULL);
+  close(c->watch_fd);
+  close(c->fd);
+}
@@ -0,0 +1,98 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <signal.h>
+#include <time.h>
+#include "rsa.h"
+
+/*
+ * Cooperative cancellation of the attacks.
+ * A deadline is set for the current thread before running an attack,
+ * and the hot loops call `deadline_check` next to their garbage cleaning.
+ * An attack which reaches its deadline stops, and records how far it got
+ * with `deadline_progress` so that it can be resumed.
+ * The state is per thread: each worker of the streaming mode has its own.
+ * `deadline_interrupt` stops all the threads (it can be called by a signal handler),
+ * `rsa_ctx_cancel` the threads of a context.
+ */
+
+static volatile sig_atomic_t interrupted = FALSE;
+
+static __thread double deadline = 0;
+static __thread int expired = FALSE;
+static __thread long reached = -1;
+static __thread const char *reached_what = NULL;
+
+/* Monotonic time in seconds */
+double wall_clock() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* CPU time of the process, all threads included */
+double cpu_clock() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* Set the deadline of the current thread (wall_clock time, 0 for none) */
+void deadline_start(double at) {
+  deadline = at;
+  expired = FALSE;
+  reached = -1;
+  reached_what = NULL;
+}
+
+/* Deadline of the current thread, to pass it to the threads it starts */
+double deadline_get() {
+  return deadline;
+}
+
+/* Earliest of two deadlines, 0 meaning none */
+double deadline_min(double a, double b) {
+  if (a <= 0) {
+    return b;
+  }
+  return (b <= 0 || a < b) ? a : b;
+}
+
+/* Cancellation point: TRUE once the deadline is reached */
+int deadline_check() {
+  if (!expired && (interrupted || rsa_ctx_current->cancelled || (deadline > 0 && wall_clock() >= deadline))) {
+    expired = TRUE;
+  }
+  return expired;
+}
+
+/* Reach the deadline of all the threads, async-signal-safe */
+void deadline_interrupt() {
+  interrupted = TRUE;
+}
+
+/* TRUE if the last attack was stopped by its deadline */
+int deadline_expired() {
+  return expired;
+}
+
+/*
+ * Record the progress of a stopped attack:
+ * the first value not tested, and what it is (a static string).
+ */
+void deadline_progress(const char *what, long value) {
+  reached_what = what;
+  reached = value;
+}
+
+/* Progress of the stopped attack, -1 if unknown */
+long deadline_reached(const char **what) {
+  if (what != NULL) {
+    *what = reached_what;
+  }
+  return reached;
+}
@@ -3,23 +3,21 @@
  * Copyright (C) 2022 A. Russon
  */
 
-#include <pari/pari.h>
+#include "rsa.h"
 
-const char *HEX = "0123456789abcdef";
-
-GEN bytes_to_hex(const unsigned char buf[8]) {
+/*
+ * Big-endian bytes to integer.
+ * The GP parser is not used so it can be called from worker threads.
+ */
+GEN bytes_to_int(const unsigned char buf[8]) {
   int i;
-  char seedhex[19];
+  ulong x = 0;
 
-  seedhex[0] = '0';
-  seedhex[1] = 'x';
   for(i = 0; i < 8; i++) {
-    seedhex[2*i + 2] = HEX[(buf[i] >> 4)];
-    seedhex[2*i + 3] = HEX[buf[i] & 15];
+    x = (x << 8) | buf[i];
   }
-  seedhex[18] = '\0';
 
-  return gp_read_str(seedhex);
+  return utoi(x);
 }
 
 GEN getseed() {
@@ -29,9 +27,49 @@ GEN getseed() {
 
   fp = fopen("/dev/urandom", "rb");
   if (fp != NULL && fread(bytes, 8, 1, fp)) {
-    seed = bytes_to_hex(bytes);
+    seed = bytes_to_int(bytes);
     fclose(fp);
   }
   
   return seed;
-}
\ No newline at end of file
+}
+
+/*
+ * Reproducible random streams.
+ * With a seed in the context (--seed), each attack on a key draws from its own
+ * stream, derived from the seed, the modulus and the attack with SplitMix64:
+ * a key gives the same run whatever the number of threads and the order of the keys,
+ * and can be replayed alone with the same seed.
+ */
+
+/* SplitMix64: next value of the sequence of state */
+uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Seed of the stream number `stream` of seed (value of the SplitMix64 sequence at this position) */
+ulong seed_derive(ulong seed, uint64_t stream) {
+  uint64_t state = seed + stream*0x9e3779b97f4a7c15ULL;
+
+  return splitmix64(&state);
+}
+
+/* Random generator of an attack (ATTACK_*) on modulus, unchanged without a seed */
+void seed_attack(GEN modulus, long attack) {
+  ulong seed = rsa_ctx_current->seed;
+
+  if (seed != 0) {
+    setrand(utoi(seed_derive(seed_derive(seed, int_hash(modulus, 0)), attack)));
+  }
+}
+
+/* Random generator of the worker thread number index of a pool */
+void seed_thread(long index) {
+  ulong seed = rsa_ctx_current->seed;
+
+  setrand(seed != 0 ? utoi(seed_derive(seed, ~(uint64_t)index)) : getseed());
+}
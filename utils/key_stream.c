@@ -0,0 +1,232 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <ctype.h>
+#include "rsa.h"
+
+/*
+ * Records of the streaming mode, one per line. Either:
+ *   - a JSON object {"n": ..., "e": ..., "id": ..., "attacks": ...}
+ *     ("modulus" and "exponent" are also accepted, values quoted or not),
+ *     with the attacks to run on this key as comma-separated names (see `attack_set`)
+ *   - decimal values separated by spaces, commas or semicolons: n [e]
+ * Signature records (rsa_fault) also have a message m and a signature s
+ * ("message" and "signature" in JSON), or are given as: n e m s
+ * Empty lines and lines starting with '#' are ignored.
+ */
+
+static char *skip_spaces(char *s) {
+  while (*s && isspace((unsigned char)*s)) {
+    s++;
+  }
+  return s;
+}
+
+static int is_decimal(const char *s) {
+  if (*s == '\0') {
+    return FALSE;
+  }
+  for (; *s; s++) {
+    if (!isdigit((unsigned char)*s)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static char *dup_range(const char *start, const char *end) {
+  char *s = malloc(end - start + 1);
+  memcpy(s, start, end - start);
+  s[end - start] = '\0';
+  return s;
+}
+
+/*
+ * Read a JSON value (string or bare token) starting at *s.
+ * The raw content is returned (escape sequences are kept as is).
+ */
+static char *json_value(char **s) {
+  char *start, *cur = *s;
+
+  if (*cur == '"') {
+    start = ++cur;
+    while (*cur && *cur != '"') {
+      if (*cur == '\\' && cur[1]) {
+        cur++;
+      }
+      cur++;
+    }
+    if (*cur != '"') {
+      return NULL;
+    }
+    *s = cur + 1;
+    return dup_range(start, cur);
+  }
+
+  start = cur;
+  while (*cur && *cur != ',' && *cur != '}' && !isspace((unsigned char)*cur)) {
+    cur++;
+  }
+  *s = cur;
+  return cur > start ? dup_range(start, cur) : NULL;
+}
+
+static int parse_json(char *s, key_rec_t *rec) {
+  char *key, *value;
+
+  s = skip_spaces(s + 1);
+  while (*s && *s != '}') {
+    key = json_value(&s);
+    s = skip_spaces(s);
+    if (key == NULL || *s != ':') {
+      free(key);
+      return FALSE;
+    }
+    s = skip_spaces(s + 1);
+    value = json_value(&s);
+    if (value == NULL) {
+      free(key);
+      return FALSE;
+    }
+
+    if (!strcmp(key, "n") || !strcmp(key, "modulus")) {
+      free(rec->n);
+      rec->n = value;
+    }
+    else if (!strcmp(key, "e") || !strcmp(key, "exponent")) {
+      free(rec->e);
+      rec->e = value;
+    }
+    else if (!strcmp(key, "m") || !strcmp(key, "message")) {
+      free(rec->m);
+      rec->m = value;
+    }
+    else if (!strcmp(key, "s") || !strcmp(key, "signature")) {
+      free(rec->s);
+      rec->s = value;
+    }
+    else if (!strcmp(key, "id")) {
+      free(rec->id);
+      rec->id = value;
+    }
+    else if (!strcmp(key, "attacks")) {
+      free(rec->attacks);
+      rec->attacks = value;
+    }
+    else {
+      free(value);
+    }
+    free(key);
+
+    s = skip_spaces(s);
+    if (*s == ',') {
+      s = skip_spaces(s + 1);
+    }
+  }
+  return *s == '}';
+}
+
+/* At most nfields values: n, e, m and s */
+static int parse_plain(char *s, key_rec_t *rec, int nfields) {
+  char *tok, *save = NULL, **fields[4];
+  const char *sep = " \t\r\n,;";
+  int i;
+
+  fields[0] = &rec->n;
+  fields[1] = &rec->e;
+  fields[2] = &rec->m;
+  fields[3] = &rec->s;
+  tok = strtok_r(s, sep, &save);
+  for (i = 0; i < nfields && tok != NULL; i++) {
+    *fields[i] = strdup(tok);
+    tok = strtok_r(NULL, sep, &save);
+  }
+  return tok == NULL;
+}
+
+static int rec_parse(char *line, long lineno, key_rec_t *rec, int sig) {
+  char *s;
+  int ok;
+
+  memset(rec, 0, sizeof(*rec));
+  rec->line = lineno;
+
+  s = skip_spaces(line);
+  if (*s == '\0' || *s == '#') {
+    return KEY_REC_SKIP;
+  }
+
+  ok = (*s == '{') ? parse_json(s, rec) : parse_plain(s, rec, sig ? 4 : 2);
+  if (!ok) {
+    rec->error = "malformed record";
+  }
+  else if (rec->n == NULL) {
+    rec->error = "modulus missing";
+  }
+  else if (sig && rec->e == NULL) {
+    rec->error = "public exponent missing";
+  }
+  else if (sig && (rec->m == NULL || rec->s == NULL)) {
+    rec->error = "message or signature missing";
+  }
+  else if (!is_decimal(rec->n) || (rec->e != NULL && !is_decimal(rec->e))
+           || (rec->m != NULL && !is_decimal(rec->m)) || (rec->s != NULL && !is_decimal(rec->s))) {
+    rec->error = "values are expected in decimal";
+  }
+  else if (rec->attacks != NULL && attack_set(rec->attacks) < 0) {
+    rec->error = "unknown attack";
+  }
+  return rec->error == NULL ? KEY_REC_OK : KEY_REC_ERROR;
+}
+
+/*
+ * Parse a line of input into rec (the line is modified).
+ * Returns KEY_REC_OK, KEY_REC_SKIP for empty lines and comments,
+ * or KEY_REC_ERROR with rec->error set.
+ */
+int key_rec_parse(char *line, long lineno, key_rec_t *rec) {
+  return rec_parse(line, lineno, rec, FALSE);
+}
+
+/* Same as `key_rec_parse` for a (n, e, m, s) signature record */
+int sig_rec_parse(char *line, long lineno, key_rec_t *rec) {
+  return rec_parse(line, lineno, rec, TRUE);
+}
+
+/* Result of a record of the streaming mode as a JSON object */
+char *stream_result(key_rec_t *rec, GEN modulus, single_res_t *res) {
+  char *id, *out, *factors;
+
+  id = rec->id != NULL ? pari_sprintf("\"id\": \"%s\", ", rec->id) : pari_sprintf("");
+  if (rec->error != NULL || modulus == NULL) {
+    out = pari_sprintf("{%s\"line\": %ld, \"found\": false, \"error\": \"%s\"}",
+                       id, rec->line, rec->error != NULL ? rec->error : "PARI error");
+  }
+  else if (res->found) {
+    factors = res->d != NULL ? pari_sprintf(", \"d\": \"%Ps\"", res->d) : pari_sprintf("");
+    out = pari_sprintf("{%s\"line\": %ld, \"n\": \"%Ps\", \"found\": true, \"attack\": \"%s\", "
+                       "\"p\": \"%Ps\", \"q\": \"%Ps\"%s}",
+                       id, rec->line, modulus, res->attack, res->p, res->q, factors);
+    pari_free(factors);
+  }
+  else {
+    out = pari_sprintf("{%s\"line\": %ld, \"n\": \"%Ps\", \"found\": false%s}", id, rec->line, modulus,
+                       res->timeout ? ", \"timeout\": true" : "");
+  }
+  pari_free(id);
+
+  return out;
+}
+
+void key_rec_free(key_rec_t *rec) {
+  free(rec->id);
+  free(rec->n);
+  free(rec->e);
+  free(rec->m);
+  free(rec->s);
+  free(rec->attacks);
+  free(rec->buf);
+  memset(rec, 0, sizeof(*rec));
+}
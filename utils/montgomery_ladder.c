@@ -3,7 +3,7 @@
  * Copyright (C) 2022 A. Russon
  */
 
-#include <pari/pari.h>
+#include "rsa.h"
 
 /*
  * http://hyperelliptic.org/EFD/g1p/auto-shortw-xz.html#doubling-dbl-2002-it-2
@@ -80,6 +80,10 @@ void ladder(GEN scalar, GEN x0, GEN A, GEN B, GEN *res_x, GEN *res_z) {
       add_xz(xx1, zz1, xx2, zz2, x0, A, B, &xx2, &zz2);
       dbl_xz(xx1, zz1, A, B, &xx1, &zz1);
     }
+    /* Cancellation point: the caller checks `deadline_expired` */
+    if (deadline_check()) {
+      break;
+    }
     if (gc_needed(av, 1)) {
       gerepileall(av, 4, &xx1, &zz1, &xx2, &zz2);
     }
@@ -0,0 +1,187 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <time.h>
+#include "rsa.h"
+
+/*
+ * Parallel search over a range of indices [start, end).
+ * The workers, each with its own PARI stack, claim chunks of PARALLEL_CHUNK
+ * indices and stop at the first index giving a result.
+ * The calling thread waits, and reports the progress every
+ * PARALLEL_PROGRESS_INTERVAL seconds in verbose mode.
+ */
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t over;
+  long next, end, done;
+  int running;
+  volatile int stop;
+  GENbin *result;
+  rsa_ctx_t *ctx;
+  double deadline;
+  stats_t *stats;
+  void *(*init)(void *arg);
+  GEN (*run)(long i, void *state);
+  void *arg;
+} parallel_t;
+
+struct parallel_worker_s {
+  parallel_t *pr;
+  struct pari_thread pth;
+  pthread_t tid;
+};
+
+/* Next chunk [*a, *b), FALSE when the range is exhausted or the search is over */
+static int claim(parallel_t *pr, long *a, long *b) {
+  int ok;
+
+  pthread_mutex_lock(&pr->lock);
+  ok = !pr->stop && pr->next < pr->end;
+  if (ok) {
+    *a = pr->next;
+    *b = pr->end - pr->next > PARALLEL_CHUNK ? pr->next + PARALLEL_CHUNK : pr->end;
+    pr->next = *b;
+  }
+  pthread_mutex_unlock(&pr->lock);
+
+  return ok;
+}
+
+static void *parallel_worker(void *arg) {
+  struct parallel_worker_s *wk = arg;
+  parallel_t *pr = wk->pr;
+  void *state;
+  GEN res;
+  long a, b, i;
+  pari_sp av;
+
+  pari_thread_start(&wk->pth);
+  rsa_ctx_attach(pr->ctx);
+  deadline_start(pr->deadline);
+  stats_attach(pr->stats);
+  trace_thread("worker");
+  state = pr->init != NULL ? pr->init(pr->arg) : pr->arg;
+
+  av = avma;
+  while (claim(pr, &a, &b)) {
+    for (i = a; i < b && !pr->stop; i++) {
+      if (deadline_check()) {
+        pr->stop = TRUE;
+        break;
+      }
+      stats_iter();
+      res = pr->run(i, state);
+      if (res != NULL) {
+        pthread_mutex_lock(&pr->lock);
+        if (pr->result == NULL) {
+          pr->result = copy_bin(res);
+        }
+        pr->stop = TRUE;
+        pthread_mutex_unlock(&pr->lock);
+        break;
+      }
+      avma = av;
+    }
+    avma = av;
+    pthread_mutex_lock(&pr->lock);
+    pr->done += i - a;
+    pthread_mutex_unlock(&pr->lock);
+  }
+
+  pthread_mutex_lock(&pr->lock);
+  pr->running--;
+  pthread_cond_signal(&pr->over);
+  pthread_mutex_unlock(&pr->lock);
+
+  trace_thread_end();
+  pari_thread_close();
+  return NULL;
+}
+
+/*
+ * Run run(i, state) for start <= i < end with nthreads workers, until one of them
+ * returns a result (not NULL). The state of a worker is init(arg) computed on its
+ * own stack, or arg if init is NULL: GEN objects of the caller must be copied by init.
+ * Returns the result on the stack of the caller, or NULL.
+ * `what` names the indices in the progress messages.
+ */
+GEN parallel_range(long start, long end, int nthreads, void *(*init)(void *), GEN (*run)(long, void *),
+                   void *arg, const char *what) {
+  parallel_t pr;
+  struct parallel_worker_s *workers;
+  struct timespec ts;
+  double t0, now, last;
+  GEN res = NULL;
+  long done;
+  int i, n;
+
+  memset(&pr, 0, sizeof(pr));
+  pthread_mutex_init(&pr.lock, NULL);
+  pthread_cond_init(&pr.over, NULL);
+  pr.next = start;
+  pr.end = end;
+  pr.ctx = rsa_ctx_get();
+  pr.deadline = deadline_get();
+  pr.stats = stats_get();
+  pr.init = init;
+  pr.run = run;
+  pr.arg = arg;
+
+  workers = calloc(nthreads, sizeof(struct parallel_worker_s));
+  pthread_mutex_lock(&pr.lock);
+  for (n = 0; n < nthreads; n++) {
+    workers[n].pr = &pr;
+    stack_thread_alloc(&workers[n].pth, WORKER_PARISIZE_LATTICE);
+    if (pthread_create(&workers[n].tid, NULL, parallel_worker, &workers[n])) {
+      pari_thread_free(&workers[n].pth);
+      break;
+    }
+    pr.running++;
+  }
+  if (n == 0) {
+    fprintf(stderr, "[!] Cannot start the worker threads\n");
+  }
+
+  /* Progress report, the condition variable uses the realtime clock */
+  t0 = last = wall_clock();
+  while (pr.running > 0) {
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += PARALLEL_PROGRESS_INTERVAL;
+    pthread_cond_timedwait(&pr.over, &pr.lock, &ts);
+    now = wall_clock();
+    if (verb && pr.running > 0 && now - last >= PARALLEL_PROGRESS_INTERVAL) {
+      done = pr.done;
+      fprintf(stderr, "[x] %ld/%ld %s tested, %.0f/s", done, end - start, what, done/(now - t0));
+      if (done > 0) {
+        fprintf(stderr, ", %.0f s left at most", (end - start - done)*(now - t0)/done);
+      }
+      fprintf(stderr, "\n");
+      last = now;
+    }
+  }
+  pthread_mutex_unlock(&pr.lock);
+
+  for (i = 0; i < n; i++) {
+    pthread_join(workers[i].tid, NULL);
+    pari_thread_free(&workers[i].pth);
+  }
+  if (verb) {
+    fprintf(stderr, "[x] %ld %s tested in %.1f s\n", pr.done, what, wall_clock() - t0);
+  }
+  /* Stopped by the deadline of the workers */
+  deadline_check();
+
+  if (pr.result != NULL) {
+    res = bin_copy(pr.result);
+  }
+
+  free(workers);
+  pthread_cond_destroy(&pr.over);
+  pthread_mutex_destroy(&pr.lock);
+
+  return res;
+}
@@ -28,6 +28,7 @@ int prime_factor_recovery(GEN modulus, GEN e, GEN d, const int n_iter, GEN *p, G
   for(i = 0; i < n_iter; i++) {
     /* Garbage cleaning */
     avma = start_loop;
+    stats_iter();
 
     g = gmodulo(randomi(modulus), modulus);
     y = powgi(g, r);
@@ -56,6 +57,7 @@ int prime_factor_recovery(GEN modulus, GEN e, GEN d, const int n_iter, GEN *p, G
 
 end:
   if (found) {
+    stats_gcd();
     *p = gcdii(lift(gsub(y, gen_1)), modulus);
     if (!gequal(*p, gen_1) && !gequal(*p, modulus)) {
       *q = gdivexact(modulus, *p);
@@ -0,0 +1,471 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * RSA public keys read from a memory-mapped file:
+ *   - DER: SubjectPublicKeyInfo, PKCS#1 RSAPublicKey or RSAPrivateKey, PKCS#8,
+ *     X.509 certificates (possibly concatenated)
+ *   - PEM: the same objects encoded in base64 (several blocks per file)
+ *   - OpenSSH: `authorized_keys` or `.pub` files (lines with ssh-rsa keys)
+ * The modulus and the exponent are kept as spans of big-endian bytes,
+ * pointing into the mapping for DER, or into the decoded buffer for PEM and SSH.
+ * They are converted to t_INT directly, without decimal conversion.
+ */
+
+#define TAG_INTEGER 0x02
+#define TAG_BIT_STRING 0x03
+#define TAG_OCTET_STRING 0x04
+#define TAG_OID 0x06
+#define TAG_SEQUENCE 0x30
+
+/* OID 1.2.840.113549.1.1.1 (rsaEncryption) */
+static const unsigned char RSA_OID[] = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01};
+
+/* t_INT from len big-endian bytes */
+GEN int_from_bytes(const unsigned char *buf, size_t len) {
+  GEN x;
+  long i, nw;
+  size_t b, k;
+  ulong w;
+
+  while (len > 0 && *buf == 0) {
+    buf++;
+    len--;
+  }
+  if (len == 0) {
+    return gen_0;
+  }
+
+  nw = (len + sizeof(ulong) - 1)/sizeof(ulong);
+  x = cgetipos(nw + 2);
+  for (i = 0; i < nw; i++) {
+    w = 0;
+    for (b = 0; b < sizeof(ulong); b++) {
+      k = i*sizeof(ulong) + b;
+      if (k < len) {
+        w |= (ulong)buf[len - 1 - k] << (8*b);
+      }
+    }
+    *int_W(x, i) = w;
+  }
+
+  return int_normalize(x, 0);
+}
+
+/*
+ * DER parsing.
+ * Read the tag and length at *p, *p is moved to the content.
+ */
+static int der_header(const unsigned char **p, const unsigned char *end, int *tag, size_t *len) {
+  const unsigned char *s = *p;
+  size_t l;
+  int nb;
+
+  if (end - s < 2) {
+    return FALSE;
+  }
+  *tag = *s++;
+  l = *s++;
+  if (l & 0x80) {
+    nb = l & 0x7f;
+    if (nb == 0 || nb > 4 || end - s < nb) {
+      return FALSE;
+    }
+    for (l = 0; nb > 0; nb--) {
+      l = (l << 8) | *s++;
+    }
+  }
+  if ((size_t)(end - s) < l) {
+    return FALSE;
+  }
+  *p = s;
+  *len = l;
+  return TRUE;
+}
+
+static int der_integer(const unsigned char **p, const unsigned char *end, const unsigned char **v, size_t *len) {
+  int tag;
+
+  if (!der_header(p, end, &tag, len) || tag != TAG_INTEGER) {
+    return FALSE;
+  }
+  *v = *p;
+  *p += *len;
+  return TRUE;
+}
+
+/* RSAPublicKey ::= SEQUENCE { modulus INTEGER, publicExponent INTEGER } */
+static int der_rsa_public_key(const unsigned char *p, const unsigned char *end, key_rec_t *rec) {
+  int tag;
+  size_t len;
+
+  if (!der_header(&p, end, &tag, &len) || tag != TAG_SEQUENCE) {
+    return FALSE;
+  }
+  end = p + len;
+  if (!der_integer(&p, end, &rec->n_bytes, &rec->n_len)
+      || !der_integer(&p, end, &rec->e_bytes, &rec->e_len)) {
+    return FALSE;
+  }
+  return p == end;
+}
+
+/*
+ * RSAPrivateKey ::= SEQUENCE { version INTEGER (0), modulus INTEGER, publicExponent INTEGER, ... }
+ * Only the public part is used.
+ */
+static int der_rsa_private_key(const unsigned char *p, const unsigned char *end, key_rec_t *rec) {
+  const unsigned char *version;
+  size_t len;
+  int tag;
+
+  if (!der_header(&p, end, &tag, &len) || tag != TAG_SEQUENCE) {
+    return FALSE;
+  }
+  end = p + len;
+  return der_integer(&p, end, &version, &len) && len == 1 && *version == 0
+      && der_integer(&p, end, &rec->n_bytes, &rec->n_len)
+      && der_integer(&p, end, &rec->e_bytes, &rec->e_len);
+}
+
+/* AlgorithmIdentifier ::= SEQUENCE { rsaEncryption, NULL }, *p is moved after it */
+static int der_rsa_algorithm(const unsigned char **p, const unsigned char *end) {
+  const unsigned char *alg;
+  size_t len;
+  int tag;
+
+  if (!der_header(p, end, &tag, &len) || tag != TAG_SEQUENCE) {
+    return FALSE;
+  }
+  alg = *p;
+  *p += len;
+  return der_header(&alg, *p, &tag, &len) && tag == TAG_OID
+      && len == sizeof(RSA_OID) && !memcmp(alg, RSA_OID, len);
+}
+
+/*
+ * PrivateKeyInfo ::= SEQUENCE {
+ *   version INTEGER (0),
+ *   privateKeyAlgorithm AlgorithmIdentifier,
+ *   privateKey OCTET STRING (RSAPrivateKey)
+ * }
+ */
+static int der_pkcs8(const unsigned char *p, const unsigned char *end, key_rec_t *rec) {
+  const unsigned char *version;
+  size_t len;
+  int tag;
+
+  if (!der_header(&p, end, &tag, &len) || tag != TAG_SEQUENCE) {
+    return FALSE;
+  }
+  end = p + len;
+  if (!der_integer(&p, end, &version, &len) || len != 1 || *version != 0
+      || !der_rsa_algorithm(&p, end)
+      || !der_header(&p, end, &tag, &len) || tag != TAG_OCTET_STRING) {
+    return FALSE;
+  }
+  return der_rsa_private_key(p, p + len, rec);
+}
+
+/*
+ * SubjectPublicKeyInfo ::= SEQUENCE {
+ *   algorithm AlgorithmIdentifier (SEQUENCE { rsaEncryption, NULL }),
+ *   subjectPublicKey BIT STRING (RSAPublicKey)
+ * }
+ * p points to the content of the outer SEQUENCE.
+ */
+static int der_spki(const unsigned char *p, const unsigned char *end, key_rec_t *rec) {
+  size_t len;
+  int tag;
+
+  if (!der_rsa_algorithm(&p, end)) {
+    return FALSE;
+  }
+  if (!der_header(&p, end, &tag, &len) || tag != TAG_BIT_STRING || len < 1 || *p != 0) {
+    return FALSE;
+  }
+  return der_rsa_public_key(p + 1, p + len, rec);
+}
+
+/*
+ * Look for a SubjectPublicKeyInfo with an RSA key,
+ * going down the constructed types (certificates, TBSCertificate, ...).
+ */
+static int der_find_spki(const unsigned char *p, const unsigned char *end, int depth, key_rec_t *rec) {
+  size_t len;
+  int tag;
+
+  if (depth > 8) {
+    return FALSE;
+  }
+  while (p < end && der_header(&p, end, &tag, &len)) {
+    if (tag == TAG_SEQUENCE && der_spki(p, p + len, rec)) {
+      return TRUE;
+    }
+    /* SEQUENCE, SET and constructed context-specific tags */
+    if ((tag & 0x20) && der_find_spki(p, p + len, depth + 1, rec)) {
+      return TRUE;
+    }
+    p += len;
+  }
+  return FALSE;
+}
+
+/* One DER object: the kind of object is recognized from its structure */
+static int der_parse(const unsigned char *p, const unsigned char *end, key_rec_t *rec) {
+  return der_rsa_public_key(p, end, rec)
+      || der_rsa_private_key(p, end, rec)
+      || der_pkcs8(p, end, rec)
+      || der_find_spki(p, end, 0, rec);
+}
+
+/* Length of the DER object at p, 0 if invalid */
+static size_t der_length(const unsigned char *p, const unsigned char *end) {
+  const unsigned char *s = p;
+  size_t len;
+  int tag;
+
+  if (!der_header(&s, end, &tag, &len)) {
+    return 0;
+  }
+  return (s - p) + len;
+}
+
+/*
+ * Base64 decoding, whitespaces are ignored.
+ * Stops at the first character which is not base64.
+ */
+static int b64_value(unsigned char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+static unsigned char *b64_decode(const unsigned char *s, const unsigned char *end, size_t *len) {
+  unsigned char *out;
+  ulong acc = 0;
+  int v, bits = 0;
+
+  out = malloc((end - s)/4*3 + 3);
+  *len = 0;
+  for (; s < end; s++) {
+    if (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') {
+      continue;
+    }
+    v = b64_value(*s);
+    if (v < 0) {
+      break;
+    }
+    acc = (acc << 6) | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out[(*len)++] = (acc >> bits) & 0xff;
+    }
+  }
+  return out;
+}
+
+static const unsigned char *find(const unsigned char *s, const unsigned char *end, const char *pattern) {
+  size_t l = strlen(pattern);
+
+  for (; s + l <= end; s++) {
+    if (*s == (unsigned char)*pattern && !memcmp(s, pattern, l)) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static const unsigned char *line_end(const unsigned char *s, const unsigned char *end) {
+  while (s < end && *s != '\n') {
+    s++;
+  }
+  return s;
+}
+
+/* Next PEM block */
+static int pem_next(pubkey_file_t *f, key_rec_t *rec) {
+  const unsigned char *s, *body, *stop, *end = f->data + f->size;
+  size_t len;
+
+  s = find(f->data + f->pos, end, "-----BEGIN ");
+  if (s == NULL) {
+    return FALSE;
+  }
+  body = line_end(s, end);
+  stop = find(body, end, "-----END ");
+  if (stop == NULL) {
+    stop = end;
+  }
+  f->pos = line_end(stop, end) - f->data;
+
+  rec->buf = b64_decode(body, stop, &len);
+  if (!der_parse(rec->buf, rec->buf + len, rec)) {
+    rec->error = "no RSA public key in PEM block";
+  }
+  return TRUE;
+}
+
+/* Next DER object of a file of concatenated DER objects */
+static int der_next(pubkey_file_t *f, key_rec_t *rec) {
+  const unsigned char *s = f->data + f->pos, *end = f->data + f->size;
+  size_t len;
+
+  if (s >= end) {
+    return FALSE;
+  }
+  len = der_length(s, end);
+  if (len == 0) {
+    /* Invalid data: stop here */
+    f->pos = f->size;
+    rec->error = "invalid DER object";
+    return TRUE;
+  }
+  f->pos += len;
+  if (!der_parse(s, s + len, rec)) {
+    rec->error = "no RSA public key in DER object";
+  }
+  return TRUE;
+}
+
+/* SSH wire format: string "ssh-rsa", mpint e, mpint n */
+static int ssh_string(const unsigned char **p, const unsigned char *end, const unsigned char **v, size_t *len) {
+  const unsigned char *s = *p;
+
+  if (end - s < 4) {
+    return FALSE;
+  }
+  *len = ((size_t)s[0] << 24) | ((size_t)s[1] << 16) | ((size_t)s[2] << 8) | s[3];
+  s += 4;
+  if ((size_t)(end - s) < *len) {
+    return FALSE;
+  }
+  *v = s;
+  *p = s + *len;
+  return TRUE;
+}
+
+static int ssh_parse(const unsigned char *p, const unsigned char *end, key_rec_t *rec) {
+  const unsigned char *type;
+  size_t len;
+
+  return ssh_string(&p, end, &type, &len) && len == 7 && !memcmp(type, "ssh-rsa", 7)
+      && ssh_string(&p, end, &rec->e_bytes, &rec->e_len)
+      && ssh_string(&p, end, &rec->n_bytes, &rec->n_len);
+}
+
+/* Next line of an authorized_keys file (options may precede the key type) */
+static int ssh_next(pubkey_file_t *f, key_rec_t *rec) {
+  const unsigned char *s, *eol, *key, *end = f->data + f->size;
+  size_t len;
+
+  while (f->pos < f->size) {
+    s = f->data + f->pos;
+    eol = line_end(s, end);
+    f->pos = (eol < end ? eol + 1 : eol) - f->data;
+    f->line++;
+
+    while (s < eol && (*s == ' ' || *s == '\t')) {
+      s++;
+    }
+    if (s == eol || *s == '#' || *s == '\r') {
+      continue;
+    }
+    rec->line = f->line;
+    key = find(s, eol, "ssh-rsa ");
+    if (key == NULL) {
+      rec->error = "not an ssh-rsa key";
+      return TRUE;
+    }
+    rec->buf = b64_decode(key + 8, eol, &len);
+    if (!ssh_parse(rec->buf, rec->buf + len, rec)) {
+      rec->error = "invalid ssh-rsa key";
+    }
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* Map the file and detect its format */
+int pubkey_open(const char *filename, pubkey_file_t *f) {
+  struct stat st;
+  int fd;
+
+  memset(f, 0, sizeof(*f));
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return FALSE;
+  }
+  if (fstat(fd, &st) || st.st_size == 0) {
+    close(fd);
+    return FALSE;
+  }
+  f->size = st.st_size;
+  f->data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (f->data == MAP_FAILED) {
+    f->data = NULL;
+    return FALSE;
+  }
+  madvise(f->data, f->size, MADV_SEQUENTIAL);
+
+  if (find(f->data, f->data + f->size, "-----BEGIN ") != NULL) {
+    f->format = PUBKEY_PEM;
+  }
+  else if (f->data[0] == TAG_SEQUENCE) {
+    f->format = PUBKEY_DER;
+  }
+  else {
+    f->format = PUBKEY_SSH;
+  }
+  return TRUE;
+}
+
+/*
+ * Next key of the file.
+ * Returns FALSE at the end of the file, otherwise rec is filled
+ * (with rec->error set if the key cannot be read).
+ * The spans of DER keys point into the mapping:
+ * the file must stay open until the keys are used.
+ */
+int pubkey_next(pubkey_file_t *f, key_rec_t *rec) {
+  int ok;
+
+  memset(rec, 0, sizeof(*rec));
+  switch (f->format) {
+    case PUBKEY_PEM:
+      ok = pem_next(f, rec);
+      break;
+    case PUBKEY_DER:
+      ok = der_next(f, rec);
+      break;
+    default:
+      ok = ssh_next(f, rec);
+  }
+  if (ok) {
+    f->count++;
+    if (f->format != PUBKEY_SSH) {
+      rec->line = f->count;
+    }
+  }
+  return ok;
+}
+
+void pubkey_close(pubkey_file_t *f) {
+  if (f->data != NULL) {
+    munmap(f->data, f->size);
+  }
+  memset(f, 0, sizeof(*f));
+}
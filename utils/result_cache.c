@@ -0,0 +1,255 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "rsa.h"
+
+/*
+ * Persistent cache of results, a hash table in a memory-mapped file.
+ * Entries are keyed by a 128-bit fingerprint of the modulus (open addressing,
+ * linear probing). An entry records the factor found, or for the failures,
+ * which attacks ran and with which bounds.
+ * The file can be shared by several processes (flock) and threads (mutex).
+ */
+
+#define CACHE_MAGIC "RSATCACH"
+#define CACHE_VERSION 1
+#define CACHE_MAX_PROBE 64
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t slot_size;
+  uint64_t nslots;
+} cache_header_t;
+
+/* SplitMix64 finalizer */
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/* Hash of the words of x (independent of the PARI kernel) */
+uint64_t int_hash(GEN x, uint64_t h) {
+  long i, nw = lgefint(x) - 2;
+
+  for (i = 0; i < nw; i++) {
+    h = mix64(h ^ *int_W(x, i));
+  }
+  return mix64(h ^ nw);
+}
+
+/* Fingerprint of the modulus */
+static void fingerprint(GEN modulus, uint64_t key[2]) {
+  key[0] = int_hash(modulus, 0x9e3779b97f4a7c15ULL);
+  key[1] = int_hash(modulus, 0xc2b2ae3d27d4eb4fULL);
+  if (key[0] == 0 && key[1] == 0) {
+    key[0] = 1;
+  }
+}
+
+/* Big-endian bytes of x, returns the number of bytes (0 if more than max) */
+static size_t int_to_bytes(GEN x, unsigned char *buf, size_t max) {
+  long i, nw = lgefint(x) - 2;
+  size_t b, len = nw*sizeof(ulong);
+  ulong w;
+
+  if (len > max) {
+    return 0;
+  }
+  for (i = 0; i < nw; i++) {
+    w = *int_W(x, i);
+    for (b = 0; b < sizeof(ulong); b++) {
+      buf[len - 1 - (i*sizeof(ulong) + b)] = (w >> (8*b)) & 0xff;
+    }
+  }
+  return len;
+}
+
+int cache_open(const char *filename, result_cache_t *c) {
+  struct stat st;
+  cache_header_t *hdr;
+  size_t size = sizeof(cache_header_t) + RESULT_CACHE_SLOTS*sizeof(cache_slot_t);
+
+  memset(c, 0, sizeof(*c));
+  c->fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if (c->fd < 0) {
+    return FALSE;
+  }
+
+  flock(c->fd, LOCK_EX);
+  if (fstat(c->fd, &st)) {
+    goto error;
+  }
+  if (st.st_size == 0) {
+    /* New cache: the file is sparse, slots are filled with zeros */
+    if (ftruncate(c->fd, size)) {
+      goto error;
+    }
+  }
+  else {
+    size = st.st_size;
+  }
+
+  c->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+  if (c->map == MAP_FAILED) {
+    c->map = NULL;
+    goto error;
+  }
+  c->size = size;
+  hdr = (cache_header_t *)c->map;
+  if (st.st_size == 0) {
+    memcpy(hdr->magic, CACHE_MAGIC, 8);
+    hdr->version = CACHE_VERSION;
+    hdr->slot_size = sizeof(cache_slot_t);
+    hdr->nslots = RESULT_CACHE_SLOTS;
+  }
+  else if (memcmp(hdr->magic, CACHE_MAGIC, 8) || hdr->version != CACHE_VERSION
+           || hdr->slot_size != sizeof(cache_slot_t)
+           || sizeof(cache_header_t) + hdr->nslots*sizeof(cache_slot_t) > size) {
+    fprintf(stderr, "[!] %s is not a valid cache file\n", filename);
+    goto error;
+  }
+  c->nslots = hdr->nslots;
+  c->slots = (cache_slot_t *)(c->map + sizeof(cache_header_t));
+  flock(c->fd, LOCK_UN);
+  pthread_mutex_init(&c->lock, NULL);
+  return TRUE;
+
+error:
+  if (c->map != NULL) {
+    munmap(c->map, c->size);
+  }
+  flock(c->fd, LOCK_UN);
+  close(c->fd);
+  c->map = NULL;
+  return FALSE;
+}
+
+void cache_close(result_cache_t *c) {
+  if (c->map == NULL) {
+    return;
+  }
+  msync(c->map, c->size, MS_SYNC);
+  munmap(c->map, c->size);
+  close(c->fd);
+  pthread_mutex_destroy(&c->lock);
+  c->map = NULL;
+}
+
+static void cache_lock(result_cache_t *c) {
+  pthread_mutex_lock(&c->lock);
+  flock(c->fd, LOCK_EX);
+}
+
+static void cache_unlock(result_cache_t *c) {
+  flock(c->fd, LOCK_UN);
+  pthread_mutex_unlock(&c->lock);
+}
+
+/* Slot of the fingerprint, or the empty slot where it can be inserted, or NULL */
+static cache_slot_t *find_slot(result_cache_t *c, const uint64_t key[2]) {
+  cache_slot_t *slot;
+  uint64_t i, idx = key[0] % c->nslots;
+
+  for (i = 0; i < CACHE_MAX_PROBE && i < c->nslots; i++) {
+    slot = &c->slots[(idx + i) % c->nslots];
+    if ((slot->key[0] == key[0] && slot->key[1] == key[1])
+        || (slot->key[0] == 0 && slot->key[1] == 0)) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Copy the entry of the modulus into entry.
+ * Returns FALSE if the modulus is not in the cache (entry is then empty).
+ */
+int cache_lookup(result_cache_t *c, GEN modulus, cache_slot_t *entry) {
+  cache_slot_t *slot;
+  uint64_t key[2];
+  int found = FALSE;
+
+  fingerprint(modulus, key);
+  memset(entry, 0, sizeof(*entry));
+  entry->key[0] = key[0];
+  entry->key[1] = key[1];
+
+  cache_lock(c);
+  slot = find_slot(c, key);
+  if (slot != NULL && slot->key[0] == key[0] && slot->key[1] == key[1]) {
+    memcpy(entry, slot, sizeof(*entry));
+    found = TRUE;
+  }
+  cache_unlock(c);
+
+  return found;
+}
+
+/*
+ * Merge the entry into the cache: flags are added,
+ * the highest bounds are kept, and the factor is stored if known.
+ */
+void cache_store(result_cache_t *c, const cache_slot_t *entry) {
+  cache_slot_t *slot;
+
+  cache_lock(c);
+  slot = find_slot(c, entry->key);
+  if (slot == NULL) {
+    if (verb) {
+      fprintf(stderr, "[!] Result cache is full, entry not stored\n");
+    }
+  }
+  else {
+    if (slot->key[0] == 0 && slot->key[1] == 0) {
+      memset(slot, 0, sizeof(*slot));
+      slot->key[0] = entry->key[0];
+      slot->key[1] = entry->key[1];
+    }
+    if ((entry->flags & (CACHE_SMALL_D | CACHE_WIENER)) && slot->e_key != entry->e_key) {
+      /* Attacks depending on the public exponent must be run again */
+      slot->flags &= ~(CACHE_SMALL_D | CACHE_WIENER);
+      slot->e_key = entry->e_key;
+    }
+    slot->flags |= entry->flags;
+    if (entry->fermat_bound > slot->fermat_bound) {
+      slot->fermat_bound = entry->fermat_bound;
+    }
+    /* Only bounds including the previous ones replace them */
+    if (entry->p1_prime_bound >= slot->p1_prime_bound && entry->p1_nbits_bound >= slot->p1_nbits_bound) {
+      slot->p1_prime_bound = entry->p1_prime_bound;
+      slot->p1_nbits_bound = entry->p1_nbits_bound;
+    }
+    if (entry->cm_disc_bound > slot->cm_disc_bound) {
+      slot->cm_disc_bound = entry->cm_disc_bound;
+    }
+    if (entry->p_len > 0 && slot->p_len == 0) {
+      slot->p_len = entry->p_len;
+      memcpy(slot->p, entry->p, entry->p_len);
+      memcpy(slot->attack, entry->attack, sizeof(slot->attack));
+    }
+  }
+  cache_unlock(c);
+}
+
+/* Fingerprint of the public exponent, 0 if not provided */
+uint64_t cache_exponent_key(GEN e) {
+  return e != NULL ? int_hash(e, 0x165667b19e3779f9ULL) | 1 : 0;
+}
+
+/* Record a factor of the modulus in the entry */
+void cache_set_factor(cache_slot_t *entry, GEN p, const char *attack) {
+  entry->p_len = int_to_bytes(p, entry->p, sizeof(entry->p));
+  strncpy(entry->attack, attack, sizeof(entry->attack) - 1);
+}
@@ -1,38 +1,122 @@
-/* 
+/*
  * rsatools, a set of cryptanalysis tools against RSA
  * Copyright (C) 2022 A. Russon
  */
 
 #include "rsa.h"
 
+/*
+ * Lift an inverse square root y of a from mod 2^v to mod 2^u.
+ * We need v >= 3 and a*y^2 = 1 mod 2^v.
+ *
+ * Newton iteration on f(y) = 1/y^2 - a:
+ *     y' = y*(3 - a*y^2)/2.
+ * If a*y^2 = 1 + eps with eps = 0 mod 2^v,
+ * then a*y'^2 = 1 - 3/4*eps^2 + 1/4*eps^3 = 1 mod 2^(2v - 2),
+ * so the precision almost doubles at each step (O(log u) steps).
+ */
+static GEN invsqrt_mod2_lift(GEN a, GEN y, long v, long u) {
+  GEN t;
+  long w;
+  pari_sp av = avma;
+
+  while (v < u) {
+    w = 2*v - 2;
+    if (w > u) {
+      w = u;
+    }
+    /* t = (3 - a*y^2)/2 mod 2^w */
+    t = remi2n(mulii(remi2n(a, w + 1), sqri(y)), w + 1);
+    t = subsi(3, t);
+    if (signe(t) < 0) {
+      t = addii(t, int2n(w + 1));
+    }
+    t = shifti(t, -1);
+    y = remi2n(mulii(y, t), w);
+    v = w;
+    if (gc_needed(av, 1)) {
+      y = gerepileuptoint(av, y);
+    }
+  }
+
+  return gerepileuptoint(av, y);
+}
+
+/*
+ * The four square roots of a mod 2^u from the inverse square root y mod 2^u.
+ * The first root is the one equal to 1 mod 4 and less than 2^(u - 1).
+ */
+static GEN sqrt_mod2_roots(GEN a, GEN y, long u) {
+  GEN pow2, root1, root2, root3, root4;
+  pari_sp av = avma;
+
+  root1 = remi2n(mulii(remi2n(a, u), y), u);
+  if (Mod4(root1) == 3) {
+    root1 = subii(int2n(u), root1);
+  }
+  root1 = remi2n(root1, u - 1);
+
+  pow2 = int2n(u - 1);
+  root2 = gneg(root1);
+  root3 = gadd(root1, pow2);
+  root4 = gadd(root2, pow2);
+  pow2 = shifti(pow2, 1);
+  root2 = gmod(root2, pow2);
+  root3 = gmod(root3, pow2);
+  root4 = gmod(root4, pow2);
+
+  return gerepilecopy(av, mkvecn(4, root1, root2, root3, root4));
+}
+
 /*
  * Compute square root of a mod 2^u.
  * Only if u >= 3 and a mod 8 = 1.
  */
 GEN sqrt_mod2(GEN a, long u) {
-  GEN pow2, root1, root2, root3, root4, roots = NULL;
-  long i;
+  GEN y, roots = NULL;
   pari_sp av = avma;
 
   /* Solutions only if a mod 8 = 1 */
   if (Mod8(a) == 1) {
-    root1 = gen_1;
-    pow2 = gen_2;
-    for(i = 3; i < u; i++) {
-      pow2 = shifti(pow2, 1);
-      if (bittest(gsub(gsqr(root1), a), i)) {
-        root1 = gadd(root1, pow2);
-      }
+    /* 1 is an inverse square root of a mod 8 */
+    y = invsqrt_mod2_lift(a, gen_1, 3, u);
+    roots = sqrt_mod2_roots(a, y, u);
+  }
+
+  /* Garbage cleaning */
+  if (roots != NULL) {
+    roots = gerepilecopy(av, roots);
+  }
+  else {
+    avma = av;
+  }
+  return roots;
+}
+
+/*
+ * Incremental variant of `sqrt_mod2` when the same a is used
+ * with several precisions u.
+ * The inverse square root of a is kept in *y (a clone, or NULL at first call),
+ * known mod 2^(*v). It is lifted only when u > *v, otherwise it is reduced.
+ * The caller must call gunclone(*y) when done.
+ */
+GEN sqrt_mod2_incr(GEN a, long u, GEN *y, long *v) {
+  GEN z, roots = NULL;
+  pari_sp av = avma;
+
+  if (Mod8(a) == 1) {
+    if (*y == NULL) {
+      *y = gclone(gen_1);
+      *v = 3;
+    }
+    if (u > *v) {
+      z = invsqrt_mod2_lift(a, *y, *v, u);
+      gunclone(*y);
+      *y = gclone(z);
+      *v = u;
+      avma = av;
     }
-    pow2 = shifti(pow2, 1);
-    root2 = gneg(root1);
-    root3 = gadd(root1, pow2);
-    root4 = gadd(root2, pow2);
-    pow2 = shifti(pow2, 1);
-    root2 = gmod(root2, pow2);
-    root3 = gmod(root3, pow2);
-    root4 = gmod(root4, pow2);
-    roots = mkvecn(4, root1, root2, root3, root4);
+    roots = sqrt_mod2_roots(a, remi2n(*y, u), u);
   }
 
   /* Garbage cleaning */
@@ -43,4 +127,4 @@ GEN sqrt_mod2(GEN a, long u) {
     avma = av;
   }
   return roots;
-}
\ No newline at end of file
+}
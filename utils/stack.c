@@ -0,0 +1,95 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * PARI stacks: the main stack starts small and grows on demand
+ * up to a ceiling (parisizemax), so only the memory really used is committed.
+ * The worker threads get an initial stack sized for their attack,
+ * with the same ceiling.
+ */
+
+static size_t stack_max = PARISIZEMAX;
+
+/* Size in bytes with an optional suffix k, M or G, 0 if invalid */
+static size_t parse_size(const char *s) {
+  char *end;
+  double v = strtod(s, &end);
+
+  switch (*end) {
+    case 'k': case 'K':
+      v *= 1e3;
+      end++;
+      break;
+    case 'm': case 'M':
+      v *= 1e6;
+      end++;
+      break;
+    case 'g': case 'G':
+      v *= 1e9;
+      end++;
+      break;
+  }
+  if (*end != '\0' || v < 1) {
+    return 0;
+  }
+  return (size_t)v;
+}
+
+/* Size of a --stack-size or --stack-max option, the default if absent or invalid */
+static size_t stack_size(const char *s, size_t def) {
+  size_t sz;
+
+  if (s == NULL) {
+    return def;
+  }
+  sz = parse_size(s);
+  if (sz == 0) {
+    fprintf(stderr, "[!] Invalid stack size %s, the default is used\n", s);
+    return def;
+  }
+  return sz;
+}
+
+/*
+ * Initialization of PARI with --stack-size and --stack-max.
+ * These options are read before the other ones (getopt ignores them with OPT_STACK):
+ * the values parsed by PARI are on the stack, which cannot be resized later.
+ * The arguments are scanned with the option table of the program, so that the
+ * abbreviations accepted by getopt_long are understood here as well.
+ */
+void stack_init(int argc, char *argv[], const char *options, const struct option *long_options) {
+  const char *s_size = NULL, *s_max = NULL;
+  size_t size;
+  int opt, i, err = opterr;
+
+  opterr = 0;
+  while ((opt = getopt_long(argc, argv, options, long_options, &i)) != -1) {
+    if (opt == OPT_STACK && !strcmp(long_options[i].name, "stack-size")) {
+      s_size = optarg;
+    }
+    else if (opt == OPT_STACK) {
+      s_max = optarg;
+    }
+  }
+  /* New scan of the arguments by the program */
+  opterr = err;
+  optind = 0;
+
+  size = stack_size(s_size, PARISIZE);
+  stack_max = stack_size(s_max, stack_max);
+  if (stack_max < size) {
+    stack_max = size;
+  }
+
+  pari_init_opts(size, MAXPRIME, INIT_JMPm | INIT_SIGm | INIT_DFTm);
+  paristack_setsize(size, stack_max);
+}
+
+/* Stack of a worker thread, starting at size bytes (see WORKER_PARISIZE) */
+void stack_thread_alloc(struct pari_thread *t, size_t size) {
+  pari_thread_valloc(t, size, stack_max > size ? stack_max : size, NULL);
+}
@@ -0,0 +1,136 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Runtime statistics of the attacks (--stats).
+ * An attack is surrounded by `stats_begin` and `stats_end`, which writes one
+ * JSON object per line to the statistics file.
+ * The counters are updated by the hot loops with `stats_iter`, `stats_gcd`,
+ * `stats_coppersmith` and `stats_skip`: they do nothing unless statistics are
+ * enabled and an attack is running on the current thread.
+ * The threads started by an attack attach to its record with `stats_attach`:
+ * the counters are atomic, and the peak stack usage is the maximum over the threads.
+ * Each counter call samples avma to track the high-water mark of the stack.
+ */
+
+const char *SKIP_NAMES[SKIP_COUNT] = {
+  "no_root_mod_e", "parity", "shared_lsb", "not_square", "small_modulus", "not_invertible", "bound",
+  "checkpoint"
+};
+
+static FILE *stats_out = NULL;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread stats_t *current = NULL;
+static __thread pari_sp base = 0;
+
+/* Statistics written to filename (- for stderr), FALSE if it cannot be opened */
+int stats_open(const char *filename) {
+  stats_out = strcmp(filename, "-") ? fopen(filename, "a") : stderr;
+  return stats_out != NULL;
+}
+
+void stats_close() {
+  if (stats_out != NULL && stats_out != stderr) {
+    fclose(stats_out);
+  }
+  stats_out = NULL;
+}
+
+/* Record of the attack running on the current thread, to pass it to the threads it starts */
+stats_t *stats_get() {
+  return current;
+}
+
+/* Count the work of the current thread in st (NULL to stop) */
+void stats_attach(stats_t *st) {
+  current = st;
+  base = avma;
+}
+
+void stats_begin(stats_t *st, const char *attack, GEN modulus) {
+  if (stats_out == NULL) {
+    current = NULL;
+    return;
+  }
+  memset(st, 0, sizeof(*st));
+  st->attack = attack;
+  st->n_bits = modulus != NULL ? expi(modulus) + 1 : 0;
+  st->n_hash = modulus != NULL ? int_hash(modulus, 0) : 0;
+  st->start = wall_clock();
+  stats_attach(st);
+}
+
+/* Write the record of the attack as a JSON object */
+void stats_end(stats_t *st, int found) {
+  int i, first = TRUE;
+
+  if (current != st || st == NULL) {
+    return;
+  }
+  current = NULL;
+
+  pthread_mutex_lock(&stats_lock);
+  fprintf(stats_out, "{\"attack\": \"%s\", \"n_bits\": %ld, \"n_hash\": \"%016llx\", \"found\": %s, "
+                     "\"stopped\": %s, \"wall_time\": %.6f, \"iterations\": %ld, \"gcds\": %ld, "
+                     "\"coppersmith\": %ld, \"skipped\": {",
+          st->attack, st->n_bits, (unsigned long long)st->n_hash, found ? "true" : "false",
+          deadline_expired() ? "true" : "false", wall_clock() - st->start, st->iterations, st->gcds,
+          st->coppersmith);
+  for (i = 0; i < SKIP_COUNT; i++) {
+    if (st->skipped[i] > 0) {
+      fprintf(stats_out, "%s\"%s\": %ld", first ? "" : ", ", SKIP_NAMES[i], st->skipped[i]);
+      first = FALSE;
+    }
+  }
+  fprintf(stats_out, "}, \"peak_stack_bytes\": %ld}\n", st->peak_stack);
+  fflush(stats_out);
+  pthread_mutex_unlock(&stats_lock);
+}
+
+/* High-water mark of the stack of the current thread */
+static void stats_stack(stats_t *st) {
+  long used = base - avma, peak = __atomic_load_n(&st->peak_stack, __ATOMIC_RELAXED);
+
+  /* peak is reloaded when the exchange fails */
+  while (used > peak) {
+    if (__atomic_compare_exchange_n(&st->peak_stack, &peak, used, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+}
+
+/* One more iteration: Fermat offset, prime, convergent, value of k... */
+void stats_iter() {
+  if (current != NULL) {
+    __atomic_fetch_add(&current->iterations, 1, __ATOMIC_RELAXED);
+    stats_stack(current);
+  }
+}
+
+void stats_gcd() {
+  if (current != NULL) {
+    __atomic_fetch_add(&current->gcds, 1, __ATOMIC_RELAXED);
+    stats_stack(current);
+  }
+}
+
+/* Lattice reduction of Coppersmith method */
+void stats_coppersmith() {
+  if (current != NULL) {
+    __atomic_fetch_add(&current->coppersmith, 1, __ATOMIC_RELAXED);
+    stats_stack(current);
+  }
+}
+
+/* Count candidates skipped for the reason SKIP_* */
+void stats_skip(int reason, long count) {
+  if (current != NULL) {
+    __atomic_fetch_add(&current->skipped[reason], count, __ATOMIC_RELAXED);
+    stats_stack(current);
+  }
+}
@@ -0,0 +1,117 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Timeline of the phases of the attacks (--trace), as trace-event JSON
+ * readable by chrome://tracing or Perfetto.
+ * A phase is surrounded by `trace_begin` and `trace_end`, which do nothing
+ * unless a trace file is open.
+ * Each thread has its own track: the events are kept in a buffer of the thread
+ * and written under the lock when it is full, or by `trace_thread_end` when the
+ * thread stops.
+ */
+
+static FILE *trace_out = NULL;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static double trace_t0;
+static long trace_tracks = 0;
+
+static __thread long track = 0;
+static __thread char buf[TRACE_BUFFER];
+static __thread size_t len = 0;
+
+static void trace_flush() {
+  if (len > 0) {
+    pthread_mutex_lock(&trace_lock);
+    if (trace_out != NULL) {
+      fwrite(buf, 1, len, trace_out);
+    }
+    pthread_mutex_unlock(&trace_lock);
+    len = 0;
+  }
+}
+
+/* Append an event, the name must not need escaping */
+static void trace_event(char ph, const char *name) {
+  int l;
+
+  if (track == 0) {
+    track = __atomic_add_fetch(&trace_tracks, 1, __ATOMIC_RELAXED);
+  }
+  if (len > TRACE_BUFFER - TRACE_EVENT_MAX) {
+    trace_flush();
+  }
+  l = snprintf(buf + len, TRACE_EVENT_MAX, ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, \"tid\": %ld, \"ts\": %.3f}",
+               name != NULL ? name : "", ph, track, 1e6*(wall_clock() - trace_t0));
+  if (l > 0 && l < TRACE_EVENT_MAX) {
+    len += l;
+  }
+}
+
+/* Trace written to filename, FALSE if it cannot be opened */
+int trace_open(const char *filename) {
+  trace_out = fopen(filename, "w");
+  if (trace_out == NULL) {
+    return FALSE;
+  }
+  trace_t0 = wall_clock();
+  fprintf(trace_out, "{\"traceEvents\": [\n"
+                     "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"rsatools\"}}");
+  trace_thread("main");
+  return TRUE;
+}
+
+void trace_close() {
+  if (trace_out == NULL) {
+    return;
+  }
+  trace_flush();
+  fprintf(trace_out, "\n]}\n");
+  fclose(trace_out);
+  trace_out = NULL;
+}
+
+/* Name of the track of the current thread */
+void trace_thread(const char *name) {
+  int l;
+
+  if (trace_out == NULL) {
+    return;
+  }
+  if (track == 0) {
+    track = __atomic_add_fetch(&trace_tracks, 1, __ATOMIC_RELAXED);
+  }
+  if (len > TRACE_BUFFER - TRACE_EVENT_MAX) {
+    trace_flush();
+  }
+  l = snprintf(buf + len, TRACE_EVENT_MAX, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %ld, "
+                                           "\"args\": {\"name\": \"%s %ld\"}}", track, name, track);
+  if (l > 0 && l < TRACE_EVENT_MAX) {
+    len += l;
+  }
+}
+
+/* Write the events of the current thread before it stops */
+void trace_thread_end() {
+  if (trace_out != NULL) {
+    trace_flush();
+  }
+}
+
+/* Start of a phase on the track of the current thread, spans can be nested */
+void trace_begin(const char *name) {
+  if (trace_out != NULL) {
+    trace_event('B', name);
+  }
+}
+
+/* End of the last phase started */
+void trace_end() {
+  if (trace_out != NULL) {
+    trace_event('E', NULL);
+  }
+}
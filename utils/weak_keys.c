@@ -0,0 +1,177 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * Weak keys for each class of attack, for rsa_gen and rsa_bench.
+ * Only the random generator of PARI is used, so the keys are
+ * reproducible from the seed given to `setrand`.
+ * The parameter of a class is:
+ *   - close: |p - q| < 2^param
+ *   - shared_lsb: p = q mod 2^param
+ *   - p_pm_1: p - 1 is param-smooth
+ *   - cm: 4p - 1 = D*s^2 with D = param
+ *   - small_d: d has param bits
+ *   - partial_p: the param highest bits of p are leaked
+ *   - partial_d: the param lowest bits of d are leaked (with e = 3)
+ */
+
+const char *WEAK_NAMES[WEAK_COUNT] = {
+  "close", "shared_lsb", "p_pm_1", "cm", "small_d", "partial_p", "partial_d"
+};
+
+/* Index of a class from its name, -1 if unknown */
+int weak_class_index(const char *name) {
+  int i;
+
+  for (i = 0; i < WEAK_COUNT; i++) {
+    if (!strcmp(WEAK_NAMES[i], name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Parameter within reach of the attacks with their default bounds */
+long weak_default_param(int cls, long nbits) {
+  switch (cls) {
+    case WEAK_CLOSE:
+    case WEAK_SHARED_LSB:
+    case WEAK_PARTIAL_D:
+      return nbits/4 + 8;
+    case WEAK_P_PM_1:
+      return P_PM_1_PRIME_BOUND;
+    case WEAK_CM:
+      return 11;
+    case WEAK_SMALL_D:
+      return nbits/4 - 8;
+    case WEAK_PARTIAL_P:
+      return nbits/4 + 8;
+  }
+  return 0;
+}
+
+/* Integer of exactly nbits bits, given the lowest bits low mod 2^l */
+static GEN random_nbits(long nbits, GEN low, long l) {
+  GEN x = addii(int2n(nbits - 1), randomi(int2n(nbits - 1)));
+
+  return l > 0 ? addii(shifti(shifti(x, -l), l), low) : x;
+}
+
+static GEN random_prime(long nbits) {
+  GEN p;
+
+  do {
+    p = nextprime(random_nbits(nbits, NULL, 0));
+  } while (expi(p) != nbits - 1);
+  return p;
+}
+
+/* p - 1 is B1-smooth, p has at least nbits bits */
+static GEN smooth_prime(long nbits, long B1) {
+  GEN primes = primes_upto_zv(B1), x;
+  long l = lg(primes) - 1;
+
+  for (;;) {
+    x = gen_2;
+    while (expi(x) < nbits - 1) {
+      x = mului(primes[1 + random_Fl(l)], x);
+    }
+    if (isprime(addiu(x, 1))) {
+      return addiu(x, 1);
+    }
+  }
+}
+
+/* 4p - 1 = D*s^2 with s odd, D = 3 mod 4 */
+static GEN cm_prime(long nbits, long D) {
+  GEN s, p;
+  long sbits = (nbits + 2 - expu(D))/2;
+
+  for (;;) {
+    s = random_nbits(sbits, gen_1, 1);
+    p = shifti(addiu(mulsi(D, sqri(s)), 1), -2);
+    if (isprime(p)) {
+      return p;
+    }
+  }
+}
+
+/* Private exponent, FALSE if e is not invertible mod phi(n) */
+static int weak_key_finish(weak_key_t *k) {
+  GEN phi = mulii(subiu(k->p, 1), subiu(k->q, 1));
+
+  if (!equali1(gcdii(k->e, phi)) || equalii(k->p, k->q)) {
+    return FALSE;
+  }
+  k->n = mulii(k->p, k->q);
+  k->d = Fp_inv(k->e, phi);
+  return TRUE;
+}
+
+/*
+ * Weak key of the class cls with a modulus of about nbits bits.
+ * The objects are left on the stack.
+ * Returns FALSE if the parameter is out of range for the class.
+ */
+int weak_key_gen(int cls, long nbits, long param, weak_key_t *k) {
+  GEN phi;
+  long h = nbits/2;
+
+  if (param < 1 || (cls == WEAK_P_PM_1 && param < 3) || (cls == WEAK_CM && param % 4 != 3)
+      || ((cls == WEAK_SHARED_LSB || cls == WEAK_SMALL_D || cls == WEAK_PARTIAL_P) && param >= h - 1)) {
+    return FALSE;
+  }
+
+  k->e = utoi(cls == WEAK_PARTIAL_D ? WEAK_PARTIAL_D_EXPONENT : WEAK_EXPONENT);
+  k->leak = NULL;
+  k->ell = 0;
+  do {
+    switch (cls) {
+      case WEAK_CLOSE:
+        k->p = random_prime(h);
+        k->q = nextprime(addii(k->p, randomi(int2n(param))));
+        break;
+      case WEAK_SHARED_LSB:
+        k->p = random_prime(h);
+        do {
+          k->q = random_nbits(h, remi2n(k->p, param), param);
+        } while (!isprime(k->q));
+        break;
+      case WEAK_P_PM_1:
+        k->p = smooth_prime(h, param);
+        k->q = random_prime(h);
+        break;
+      case WEAK_CM:
+        k->p = cm_prime(h, param);
+        k->q = random_prime(h);
+        break;
+      case WEAK_SMALL_D:
+        k->p = random_prime(h);
+        k->q = random_prime(h);
+        /* e is the inverse of d */
+        phi = mulii(subiu(k->p, 1), subiu(k->q, 1));
+        do {
+          k->d = random_nbits(param, gen_1, 1);
+        } while (!equali1(gcdii(k->d, phi)));
+        k->e = Fp_inv(k->d, phi);
+        break;
+      default:
+        k->p = random_prime(h);
+        k->q = random_prime(h);
+    }
+  } while (!weak_key_finish(k));
+
+  if (cls == WEAK_PARTIAL_P) {
+    k->ell = expi(k->p) + 1 - param;
+    k->leak = shifti(k->p, -k->ell);
+  }
+  else if (cls == WEAK_PARTIAL_D) {
+    k->ell = param;
+    k->leak = remi2n(k->d, param);
+  }
+  return TRUE;
+}
@@ -0,0 +1,237 @@
+/*
+ * rsatools, a set of cryptanalysis tools against RSA
+ * Copyright (C) 2022 A. Russon
+ */
+
+#include "rsa.h"
+
+/*
+ * A fixed pool of PARI worker threads.
+ * Jobs are submitted by the main thread and run by the workers,
+ * each worker having its own PARI stack.
+ * Each job returns one line of output, written by the worker which completes it.
+ * If `ordered` is set, lines are written in the order of submission,
+ * using a ring buffer of size `capacity` (the maximal number of jobs in flight).
+ * Otherwise, jobs can be given a priority with `workers_submit_priority`.
+ */
+
+typedef struct job_s {
+  long index;
+  long priority;
+  void *data;
+  char *out;
+  struct job_s *next;
+} job_t;
+
+struct worker_s {
+  workers_t *pool;
+  struct pari_thread pth;
+  pthread_t tid;
+};
+
+static job_t *pop_job(workers_t *w) {
+  job_t *job;
+
+  pthread_mutex_lock(&w->lock);
+  while (w->head == NULL && !w->closed) {
+    pthread_cond_wait(&w->not_empty, &w->lock);
+  }
+  job = w->head;
+  if (job != NULL) {
+    w->head = job->next;
+    if (w->head == NULL) {
+      w->tail = NULL;
+    }
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return job;
+}
+
+static void write_job(workers_t *w, job_t *job) {
+  if (job->out != NULL) {
+    fprintf(w->out, "%s\n", job->out);
+    pari_free(job->out);
+  }
+  if (w->release != NULL) {
+    w->release(job->data);
+  }
+  free(job);
+  w->inflight--;
+}
+
+static void complete_job(workers_t *w, job_t *job) {
+  long slot;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->ordered) {
+    w->ring[job->index % w->capacity] = job;
+    slot = w->next_out % w->capacity;
+    while (w->ring[slot] != NULL) {
+      job = w->ring[slot];
+      w->ring[slot] = NULL;
+      write_job(w, job);
+      w->next_out++;
+      slot = w->next_out % w->capacity;
+    }
+  }
+  else {
+    write_job(w, job);
+  }
+  fflush(w->out);
+  pthread_cond_signal(&w->not_full);
+  pthread_mutex_unlock(&w->lock);
+}
+
+static void *worker_main(void *arg) {
+  struct worker_s *wk = arg;
+  workers_t *w = wk->pool;
+  job_t *job;
+  pari_sp av;
+
+  pari_thread_start(&wk->pth);
+  rsa_ctx_attach(w->ctx);
+  seed_thread(wk - w->workers);
+  trace_thread("worker");
+
+  av = avma;
+  while ((job = pop_job(w)) != NULL) {
+    job->out = w->run(job->data, w->arg);
+    avma = av;
+    complete_job(w, job);
+  }
+
+  trace_thread_end();
+  pari_thread_close();
+  return NULL;
+}
+
+/*
+ * Start nthreads workers with an initial PARI stack of stacksize bytes each.
+ * The function run is called by a worker for each job and returns
+ * the output line (allocated with pari_malloc, or NULL for no output).
+ * The function release (can be NULL) frees the job data.
+ * Returns the number of workers started, nothing is left to free if none.
+ */
+int workers_start(workers_t *w, int nthreads, size_t stacksize, int ordered, long capacity,
+                  FILE *out, char *(*run)(void *, void *), void (*release)(void *), void *arg) {
+  int i;
+
+  memset(w, 0, sizeof(*w));
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->not_empty, NULL);
+  pthread_cond_init(&w->not_full, NULL);
+  w->ordered = ordered;
+  w->capacity = capacity < nthreads ? nthreads : capacity;
+  w->out = out;
+  w->run = run;
+  w->release = release;
+  w->arg = arg;
+  w->ctx = rsa_ctx_get();
+  if (ordered) {
+    w->ring = calloc(w->capacity, sizeof(job_t *));
+  }
+
+  w->nthreads = nthreads;
+  w->workers = calloc(nthreads, sizeof(struct worker_s));
+  for (i = 0; i < nthreads; i++) {
+    w->workers[i].pool = w;
+    stack_thread_alloc(&w->workers[i].pth, stacksize);
+    if (pthread_create(&w->workers[i].tid, NULL, worker_main, &w->workers[i])) {
+      pari_thread_free(&w->workers[i].pth);
+      break;
+    }
+  }
+  w->nthreads = i;
+
+  /* No worker: the callers do not call workers_finish */
+  if (i == 0) {
+    free(w->ring);
+    free(w->workers);
+    w->ring = NULL;
+    w->workers = NULL;
+    pthread_cond_destroy(&w->not_full);
+    pthread_cond_destroy(&w->not_empty);
+    pthread_mutex_destroy(&w->lock);
+  }
+
+  return i;
+}
+
+/* Submit a job, waiting if there are already too many jobs in flight */
+void workers_submit(workers_t *w, void *data) {
+  job_t *job = malloc(sizeof(job_t));
+
+  job->data = data;
+  job->priority = 0;
+  job->out = NULL;
+  job->next = NULL;
+
+  pthread_mutex_lock(&w->lock);
+  while (w->inflight >= w->capacity) {
+    pthread_cond_wait(&w->not_full, &w->lock);
+  }
+  job->index = w->submitted++;
+  w->inflight++;
+  if (w->tail != NULL) {
+    w->tail->next = job;
+  }
+  else {
+    w->head = job;
+  }
+  w->tail = job;
+  pthread_cond_signal(&w->not_empty);
+  pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * Submit a job ahead of the queued jobs of lower priority (FIFO for the same priority),
+ * for an unordered pool. Does not wait: returns FALSE if there are too many jobs in flight.
+ */
+int workers_submit_priority(workers_t *w, void *data, long priority) {
+  job_t *job, **pos;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->inflight >= w->capacity) {
+    pthread_mutex_unlock(&w->lock);
+    return FALSE;
+  }
+  job = malloc(sizeof(job_t));
+  job->data = data;
+  job->priority = priority;
+  job->out = NULL;
+  job->index = w->submitted++;
+  w->inflight++;
+
+  for (pos = &w->head; *pos != NULL && (*pos)->priority >= priority; pos = &(*pos)->next);
+  job->next = *pos;
+  *pos = job;
+  if (job->next == NULL) {
+    w->tail = job;
+  }
+  pthread_cond_signal(&w->not_empty);
+  pthread_mutex_unlock(&w->lock);
+
+  return TRUE;
+}
+
+/* Wait for the completion of all the jobs and stop the workers */
+void workers_finish(workers_t *w) {
+  int i;
+
+  pthread_mutex_lock(&w->lock);
+  w->closed = TRUE;
+  pthread_cond_broadcast(&w->not_empty);
+  pthread_mutex_unlock(&w->lock);
+
+  for (i = 0; i < w->nthreads; i++) {
+    pthread_join(w->workers[i].tid, NULL);
+    pari_thread_free(&w->workers[i].pth);
+  }
+
+  free(w->workers);
+  free(w->ring);
+  pthread_cond_destroy(&w->not_full);
+  pthread_cond_destroy(&w->not_empty);
+  pthread_mutex_destroy(&w->lock);
+}